@@ -0,0 +1,423 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "accel.hpp"
+#include "world2d_kernels.hpp"
+#include <chrono>
+
+// calibration runs at least this many timed steps and stops after the time budget
+#define ACCEL_CALIBRATION_MIN_STEPS 3
+#define ACCEL_CALIBRATION_MAX_STEPS 16
+#define ACCEL_CALIBRATION_BUDGET_MS 50.0
+
+namespace {
+
+// both cpu backends step the world in place
+struct CpuAccel {
+	enkiTaskSchedulerHandle scheduler;
+	World2D_Kernels const* kernels;
+	World2D* world;
+};
+
+void* CpuCreate(enkiTaskSchedulerHandle scheduler, World2D_Kernels const* kernels) {
+	CpuAccel* cpu = (CpuAccel*) MEMORY_CALLOC(1, sizeof(CpuAccel));
+	if (!cpu) return nullptr;
+	cpu->scheduler = scheduler;
+	cpu->kernels = kernels;
+	return cpu;
+}
+
+void* ScalarCreate(enkiTaskSchedulerHandle scheduler) {
+	return CpuCreate(nullptr, World2D_KernelsScalar());
+}
+
+void* SimdCreate(enkiTaskSchedulerHandle scheduler) {
+	return CpuCreate(scheduler, World2D_KernelsBest());
+}
+
+void CpuDestroy(void* instance) {
+	if (instance) MEMORY_FREE(instance);
+}
+
+bool CpuAllocateChannels(void* instance, World2D* world) {
+	((CpuAccel*) instance)->world = world;
+	return true;
+}
+
+void CpuReleaseChannels(void* instance) {
+	((CpuAccel*) instance)->world = nullptr;
+}
+
+bool CpuRegion(void* instance, uint32_t channel, World2D_Rect const& rect) {
+	return true;
+}
+
+bool CpuRunKernel(void* instance, World2D_StepParams const* params) {
+	CpuAccel* cpu = (CpuAccel*) instance;
+	ASSERT(cpu->world);
+	World2D_StepParams cpuParams = *params;
+	cpuParams.kernels = cpu->kernels;
+	World2D_Step(cpu->world, cpu->scheduler, &cpuParams);
+	return true;
+}
+
+bool CpuFence(void* instance) {
+	return true;
+}
+
+Accel_Backend const ScalarBackend = {
+		"Scalar CPU",
+		&ScalarCreate,
+		&CpuDestroy,
+		&CpuAllocateChannels,
+		&CpuReleaseChannels,
+		&CpuRegion,
+		&CpuRegion,
+		&CpuRunKernel,
+		&CpuFence,
+		&CpuRunKernel,
+};
+
+Accel_Backend const SimdBackend = {
+		"SIMD CPU",
+		&SimdCreate,
+		&CpuDestroy,
+		&CpuAllocateChannels,
+		&CpuReleaseChannels,
+		&CpuRegion,
+		&CpuRegion,
+		&CpuRunKernel,
+		&CpuFence,
+		&CpuRunKernel,
+};
+
+// copies what it can of src so the calibration steps see representative data
+void CopyFrontPlanes(World2D* dst, World2D const* src) {
+	for (uint32_t i = 0; i < dst->channelCount && i < src->channelCount; ++i) {
+		World2DChannel const& from = src->channels[i];
+		World2DChannel& to = dst->channels[i];
+		if (from.layout == to.layout && from.sizeInBytes == to.sizeInBytes) {
+			memcpy(to.data, from.data, to.sizeInBytes);
+		}
+	}
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Unbind(Accel* accel) {
+	if (!accel->world) return;
+	Accel_BackendInstance& bi = accel->backends[accel->active];
+	bi.backend->releaseChannels(bi.instance);
+	accel->world = nullptr;
+}
+
+bool BindActive(Accel* accel, World2D* world) {
+	Accel_BackendInstance& bi = accel->backends[accel->active];
+	if (!bi.backend->allocateChannels(bi.instance, world)) {
+		LOGERROR("Accel %s failed to allocate channels, using %s", bi.backend->name, accel->backends[0].backend->name);
+		bi.msPerStep = 0.0;
+		accel->active = 0;
+		if (!accel->backends[0].backend->allocateChannels(accel->backends[0].instance, world)) return false;
+	}
+	accel->world = world;
+	return true;
+}
+
+double TimeBackend(Accel_Backend const* backend, void* instance, World2D* scratch, World2D_StepParams const* params) {
+	if (!backend->allocateChannels(instance, scratch)) return 0.0;
+
+	// the first step pays for uploads and any lazy device setup
+	double ms = 0.0;
+	if (backend->step(instance, params)) {
+		uint32_t steps = 0;
+		auto const start = std::chrono::steady_clock::now();
+		bool ok = true;
+		do {
+			ok = backend->step(instance, params);
+			steps++;
+			ms = MsSince(start);
+		} while (ok && steps < ACCEL_CALIBRATION_MAX_STEPS &&
+				(steps < ACCEL_CALIBRATION_MIN_STEPS || ms < ACCEL_CALIBRATION_BUDGET_MS));
+		ms = ok ? ms / steps : 0.0;
+	}
+
+	backend->releaseChannels(instance);
+	return ms;
+}
+
+} // end anon namespace
+
+struct Accel_Init {
+	enkiTaskSchedulerHandle scheduler;
+	enkiTaskSetHandle task;
+
+	// a private copy, the bound world keeps stepping while this runs
+	World2D* scratch;
+	World2D_StepParams params;
+
+	// every candidate gets a fresh instance so nothing bound is touched,
+	// instances of backends Accel doesn't have yet are kept for the attach
+	Accel_Backend const* attached[ACCEL_MAX_BACKENDS];
+	uint32_t attachedCount;
+	Accel_BackendInstance results[ACCEL_MAX_BACKENDS];
+	uint32_t resultCount;
+
+	double totalMs;
+};
+
+namespace {
+
+bool IsAttached(Accel_Init const* init, Accel_Backend const* backend) {
+	for (uint32_t i = 0; i < init->attachedCount; ++i) {
+		if (init->attached[i] == backend) return true;
+	}
+	return false;
+}
+
+void InitTask(uint32_t start, uint32_t end, uint32_t threadnum, void* args) {
+	Accel_Init* init = (Accel_Init*) args;
+	auto const initStart = std::chrono::steady_clock::now();
+
+	LOGINFO("Accel calibrating for a %ux%u world", init->scratch->width, init->scratch->height);
+	World2D* const original = World2D_Create(init->scratch->type, init->scratch->width, init->scratch->height);
+	if (original) CopyFrontPlanes(original, init->scratch);
+
+	// scalar first, it always exists and is the fallback
+	Accel_Backend const* candidates[ACCEL_MAX_BACKENDS] = {
+			Accel_BackendScalar(),
+			Accel_BackendSimd(),
+			AccelSycl_Backend(),
+			AccelCUDA_Backend(),
+	};
+	for (Accel_Backend const* backend : candidates) {
+		if (!backend) continue;
+		Accel_BackendInstance& result = init->results[init->resultCount++];
+		result.backend = backend;
+
+		auto const createStart = std::chrono::steady_clock::now();
+		result.instance = backend->create(init->scheduler);
+		if (!result.instance) {
+			LOGINFO("  %s not available (%.1f ms)", backend->name, MsSince(createStart));
+			continue;
+		}
+		double const createMs = MsSince(createStart);
+
+		// every backend starts from the same data
+		if (original) CopyFrontPlanes(init->scratch, original);
+		result.msPerStep = TimeBackend(backend, result.instance, init->scratch, &init->params);
+		LOGINFO("  %s created in %.1f ms, %.3f ms/step", backend->name, createMs, result.msPerStep);
+
+		if (IsAttached(init, backend)) {
+			backend->destroy(result.instance);
+			result.instance = nullptr;
+		}
+	}
+
+	if (original) World2D_Destroy(original);
+	init->totalMs = MsSince(initStart);
+}
+
+// moves a finished init's results into accel and rebinds to the fastest
+void Attach(Accel* accel) {
+	Accel_Init* init = accel->init;
+	accel->init = nullptr;
+	if (init->task) enkiDeleteTaskSet(init->task);
+
+	for (uint32_t r = 0; r < init->resultCount; ++r) {
+		Accel_BackendInstance const& result = init->results[r];
+		uint32_t i = 0;
+		while (i < accel->backendCount && accel->backends[i].backend != result.backend) ++i;
+		if (i == accel->backendCount) {
+			if (!result.instance) continue;
+			accel->backends[accel->backendCount++] = result;
+		} else {
+			accel->backends[i].msPerStep = result.msPerStep;
+		}
+	}
+
+	uint32_t best = 0;
+	for (uint32_t i = 1; i < accel->backendCount; ++i) {
+		double const ms = accel->backends[i].msPerStep;
+		if (ms > 0.0 && (accel->backends[best].msPerStep <= 0.0 || ms < accel->backends[best].msPerStep)) {
+			best = i;
+		}
+	}
+	LOGINFO("Accel init took %.1f ms, using %s", init->totalMs, accel->backends[best].backend->name);
+
+	World2D_Destroy(init->scratch);
+	MEMORY_FREE(init);
+
+	if (best == accel->active) return;
+	World2D* world = accel->world;
+	Unbind(accel);
+	accel->active = best;
+	if (world) BindActive(accel, world);
+}
+
+void FinishInit(Accel* accel) {
+	if (!accel->init) return;
+	if (accel->init->task) enkiWaitForTaskSet(accel->scheduler, accel->init->task);
+	Attach(accel);
+}
+
+bool StartInit(Accel* accel, World2D const* world, World2D_StepParams const* params) {
+	Accel_Init* init = (Accel_Init*) MEMORY_CALLOC(1, sizeof(Accel_Init));
+	if (!init) return false;
+	init->scheduler = accel->scheduler;
+	init->params = *params;
+	init->scratch = World2D_Create(world->type, world->width, world->height);
+	if (!init->scratch) {
+		MEMORY_FREE(init);
+		return false;
+	}
+	CopyFrontPlanes(init->scratch, world);
+	for (uint32_t i = 0; i < accel->backendCount; ++i) {
+		init->attached[init->attachedCount++] = accel->backends[i].backend;
+	}
+	accel->init = init;
+
+	if (!accel->scheduler) {
+		InitTask(0, 1, 0, init);
+		Attach(accel);
+		return true;
+	}
+	init->task = enkiCreateTaskSet(accel->scheduler, &InitTask);
+	enkiAddTaskSetToPipe(accel->scheduler, init->task, init, 1);
+	return true;
+}
+
+} // end anon namespace
+
+Accel_Backend const* Accel_BackendScalar() {
+	return &ScalarBackend;
+}
+
+Accel_Backend const* Accel_BackendSimd() {
+	return &SimdBackend;
+}
+
+#if !defined(ALIFE_CUDA)
+// accel_cuda.cu is only built with the alife_cuda option, without it there is no CUDA backend
+Accel_Backend const* AccelCUDA_Backend() {
+	return nullptr;
+}
+#endif
+
+Accel* Accel_Create(enkiTaskSchedulerHandle scheduler) {
+	Accel* accel = (Accel*) MEMORY_CALLOC(1, sizeof(Accel));
+	if (!accel) return nullptr;
+	accel->scheduler = scheduler;
+
+	// the cpu backends are just a table of kernels, the device ones wait for the init task
+	Accel_Backend const* cpuBackends[] = {Accel_BackendScalar(), Accel_BackendSimd()};
+	for (Accel_Backend const* backend : cpuBackends) {
+		void* instance = backend->create(scheduler);
+		if (instance) accel->backends[accel->backendCount++] = {backend, instance, 0.0};
+	}
+
+	if (accel->backendCount == 0) {
+		Accel_Destroy(accel);
+		return nullptr;
+	}
+	return accel;
+}
+
+void Accel_Destroy(Accel* accel) {
+	if (!accel) return;
+	FinishInit(accel);
+	Unbind(accel);
+	for (uint32_t i = 0; i < accel->backendCount; ++i) {
+		accel->backends[i].backend->destroy(accel->backends[i].instance);
+	}
+	MEMORY_FREE(accel);
+}
+
+bool Accel_Bind(Accel* accel, World2D* world, World2D_StepParams const* params) {
+	ASSERT(accel);
+	ASSERT(world);
+	FinishInit(accel);
+	Unbind(accel);
+
+	if (world->type != accel->calibratedType ||
+			world->width != accel->calibratedWidth ||
+			world->height != accel->calibratedHeight) {
+		// simd until the calibration says otherwise
+		accel->active = (accel->backendCount > 1 && accel->backends[1].backend == Accel_BackendSimd()) ? 1 : 0;
+		accel->calibratedType = world->type;
+		accel->calibratedWidth = world->width;
+		accel->calibratedHeight = world->height;
+		if (!BindActive(accel, world)) return false;
+		if (!StartInit(accel, world, params)) {
+			LOGERROR("Accel calibration out of memory, using %s", Accel_ActiveName(accel));
+		}
+		return accel->world != nullptr;
+	}
+
+	return BindActive(accel, world);
+}
+
+bool Accel_Step(Accel* accel, World2D* world, World2D_StepParams const* params) {
+	ASSERT(accel);
+	ASSERT(world);
+	Accel_IsReady(accel);
+
+	if (world != accel->world ||
+			world->width != accel->calibratedWidth ||
+			world->height != accel->calibratedHeight) {
+		if (!Accel_Bind(accel, world, params)) return false;
+	}
+
+	Accel_BackendInstance& bi = accel->backends[accel->active];
+	if (bi.backend->step(bi.instance, params)) return true;
+
+	// drop to the scalar path for good rather than fail every tick
+	LOGERROR("Accel %s step failed, using %s", bi.backend->name, accel->backends[0].backend->name);
+	Unbind(accel);
+	bi.msPerStep = 0.0;
+	accel->active = 0;
+	if (!Accel_Bind(accel, world, params)) return false;
+	return accel->backends[0].backend->step(accel->backends[0].instance, params);
+}
+
+bool Accel_StepSliced(Accel* accel, World2D* world, World2D_StepParams const* params,
+											World2D_StepSlice* slice, double budgetMS) {
+	ASSERT(accel);
+	ASSERT(world);
+	ASSERT(slice);
+	Accel_IsReady(accel);
+
+	if (world != accel->world ||
+			world->width != accel->calibratedWidth ||
+			world->height != accel->calibratedHeight) {
+		World2D_StepSliceAbort(slice);
+		if (!Accel_Bind(accel, world, params)) return false;
+	}
+
+	Accel_BackendInstance const& bi = accel->backends[accel->active];
+	if (bi.backend == &ScalarBackend || bi.backend == &SimdBackend) {
+		CpuAccel const* cpu = (CpuAccel const*) bi.instance;
+		World2D_StepParams cpuParams = *params;
+		cpuParams.kernels = cpu->kernels;
+		return World2D_StepSliced(slice, world, cpu->scheduler, &cpuParams, budgetMS);
+	}
+
+	// a device backend was attached mid tick, its ticks start from the front planes
+	World2D_StepSliceAbort(slice);
+	return Accel_Step(accel, world, params);
+}
+
+bool Accel_IsReady(Accel* accel) {
+	ASSERT(accel);
+	if (accel->init && accel->init->task && enkiIsTaskSetComplete(accel->scheduler, accel->init->task)) {
+		Attach(accel);
+	}
+	return accel->init == nullptr;
+}
+
+char const* Accel_ActiveName(Accel const* accel) {
+	ASSERT(accel);
+	return accel->backends[accel->active].backend->name;
+}
@@ -0,0 +1,101 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_enki/TaskScheduler_c.h"
+#include "world2d.hpp"
+#include "world2d_step.hpp"
+
+#define ACCEL_MAX_BACKENDS 4
+
+// What a compute path has to provide to step a World2D. CPU backends work on
+// the world's own planes so their channel and transfer ops do nothing, device
+// backends keep their own copies of the stepped channels. Every op returns
+// false on failure, instance is whatever create returned.
+struct Accel_Backend {
+	char const* name;
+
+	// nullptr if the backend isn't available on this machine
+	void* (*create)(enkiTaskSchedulerHandle scheduler);
+	void (*destroy)(void* instance);
+
+	// binds to world, allocating whatever copies of its stepped channels the backend needs
+	bool (*allocateChannels)(void* instance, World2D* world);
+	void (*releaseChannels)(void* instance);
+
+	// front plane rect host -> backend and backend -> host
+	bool (*uploadRegion)(void* instance, uint32_t channel, World2D_Rect const& rect);
+	bool (*downloadRegion)(void* instance, uint32_t channel, World2D_Rect const& rect);
+
+	// queues the step kernels, fence waits for them
+	bool (*runKernel)(void* instance, World2D_StepParams const* params);
+	bool (*fence)(void* instance);
+
+	// a whole tick, the host world is current and its changed tiles dirty on return
+	bool (*step)(void* instance, World2D_StepParams const* params);
+};
+
+Accel_Backend const* Accel_BackendScalar();
+// the best SIMD kernels, tiles spread over the enki scheduler
+Accel_Backend const* Accel_BackendSimd();
+// device backends, create returns nullptr when there is no usable device
+Accel_Backend const* AccelSycl_Backend();
+// nullptr unless built with the alife_cuda option
+Accel_Backend const* AccelCUDA_Backend();
+
+struct Accel_BackendInstance {
+	Accel_Backend const* backend;
+	void* instance;
+	// from the last calibration, 0 if it failed
+	double msPerStep;
+};
+
+// device creation and calibration in flight on an enki task
+struct Accel_Init;
+
+// Owns every backend available and steps a world with whichever was fastest
+// at a short calibration run on a scratch copy of the world. Device backends
+// are slow to bring up (enumeration, benchmarks, kernel compiles) so they are
+// created and every backend calibrated on an enki task, the world steps on the
+// CPU meanwhile and the winner is attached once the task is done.
+struct Accel {
+	enkiTaskSchedulerHandle scheduler;
+
+	uint32_t backendCount;
+	Accel_BackendInstance backends[ACCEL_MAX_BACKENDS];
+	uint32_t active;
+
+	World2D* world;
+	WorldType calibratedType;
+	uint32_t calibratedWidth;
+	uint32_t calibratedHeight;
+
+	Accel_Init* init;
+};
+
+// only creates the CPU backends so returns straight away
+Accel* Accel_Create(enkiTaskSchedulerHandle scheduler);
+// waits for any init task still running
+void Accel_Destroy(Accel* accel);
+
+// binds world to a backend. If world's type or size differ from the last
+// calibration it starts with the SIMD CPU backend and kicks off calibration,
+// without a scheduler that is done before returning
+bool Accel_Bind(Accel* accel, World2D* world, World2D_StepParams const* params);
+
+// steps the bound world, a world that has changed size since it was bound
+// (or a different world) is rebound and so recalibrated
+bool Accel_Step(Accel* accel, World2D* world, World2D_StepParams const* params);
+
+// steps part of a tick within budgetMS, see World2D_StepSlice. Only the CPU
+// backends can slice a tick, device backends step whole ticks as Accel_Step.
+// True when a tick completed and the world's front planes moved on. Rebinding
+// aborts the tick in progress
+bool Accel_StepSliced(Accel* accel, World2D* world, World2D_StepParams const* params,
+											World2D_StepSlice* slice, double budgetMS);
+
+// true once device creation and calibration are done and the fastest backend
+// attached, polling is cheap and attaches a finished init
+bool Accel_IsReady(Accel* accel);
+
+char const* Accel_ActiveName(Accel const* accel);
@@ -1,93 +1,13 @@
 #include "al2o3_platform/platform.h"
 #include "al2o3_memory/memory.h"
 #include "accel_cuda.hpp"
+#include "accel.hpp"
+#include "accel_devicecache.hpp"
+#include "world2d_kernels.hpp"
+#include "world2d_rng.hpp"
 #include <cuda.h>
-
-inline int _ConvertSMVer2Cores(int major, int minor) {
-	// Defines for GPU Architecture types (using the SM version to determine
-	// the # of cores per SM
-	typedef struct {
-		int SM;  // 0xMm (hexidecimal notation), M = SM Major version,
-		// and m = SM minor version
-		int Cores;
-	} sSMtoCores;
-
-	sSMtoCores nGpuArchCoresPerSM[] = {
-			{0x30, 192},
-			{0x32, 192},
-			{0x35, 192},
-			{0x37, 192},
-			{0x50, 128},
-			{0x52, 128},
-			{0x53, 128},
-			{0x60, 64},
-			{0x61, 128},
-			{0x62, 128},
-			{0x70, 64},
-			{0x72, 64},
-			{0x75, 64},
-			{-1, -1}};
-
-	int index = 0;
-
-	while (nGpuArchCoresPerSM[index].SM != -1) {
-		if (nGpuArchCoresPerSM[index].SM == ((major << 4) + minor)) {
-			return nGpuArchCoresPerSM[index].Cores;
-		}
-
-		index++;
-	}
-
-	// If we don't find the values, we default use the previous one
-	// to run properly
-	LOGINFO("MapSMtoCores for SM %d.%d is undefined. Default to use %d Cores/SM\n",
-					major, minor, nGpuArchCoresPerSM[index - 1].Cores);
-	return nGpuArchCoresPerSM[index - 1].Cores;
-}
-
-inline const char *_ConvertSMVer2ArchName(int major, int minor) {
-	// Defines for GPU Architecture types (using the SM version to determine
-	// the GPU Arch name)
-	typedef struct {
-		int SM;  // 0xMm (hexidecimal notation), M = SM Major version,
-		// and m = SM minor version
-		const char *name;
-	} sSMtoArchName;
-
-	sSMtoArchName nGpuArchNameSM[] = {
-			{0x30, "Kepler"},
-			{0x32, "Kepler"},
-			{0x35, "Kepler"},
-			{0x37, "Kepler"},
-			{0x50, "Maxwell"},
-			{0x52, "Maxwell"},
-			{0x53, "Maxwell"},
-			{0x60, "Pascal"},
-			{0x61, "Pascal"},
-			{0x62, "Pascal"},
-			{0x70, "Volta"},
-			{0x72, "Xavier"},
-			{0x75, "Turing"},
-			{-1, "Graphics Device"}};
-
-	int index = 0;
-
-	while (nGpuArchNameSM[index].SM != -1) {
-		if (nGpuArchNameSM[index].SM == ((major << 4) + minor)) {
-			return nGpuArchNameSM[index].name;
-		}
-
-		index++;
-	}
-
-	// If we don't find the values, we default use the previous one
-	// to run properly
-	LOGINFO("MapSMtoArchName for SM %d.%d is undefined. Default to use %s\n",
-					major,
-					minor,
-					nGpuArchNameSM[index - 1].name);
-	return nGpuArchNameSM[index - 1].name;
-}
+#include <cmath>
+#include <cstdio>
 
 template<typename T>
 void check(T result, char const *const func, const char *const file,
@@ -102,42 +22,139 @@ void check(T result, char const *const func, const char *const file,
 // that a CUDA host call returns an error
 #define checkCudaErrors(val) check((val), #val, __FILE__, __LINE__)
 
+// microbenchmark sizes, a few ms each on a current GPU
+#define CUDA_BENCH_BANDWIDTH_FLOATS (16u << 20)
+#define CUDA_BENCH_COMPUTE_BLOCKS 1024
+#define CUDA_BENCH_COMPUTE_THREADS 256
+#define CUDA_BENCH_COMPUTE_LOOPS 1024
+#define CUDA_BENCH_REPEATS 3
+
+namespace {
+
+bool CudaOk(cudaError_t result, char const *what) {
+	if (result == cudaSuccess) return true;
+	LOGERROR("CUDA %s failed code=%d(%s)", what, (int) result, cudaGetErrorName(result));
+	return false;
+}
+
+__global__ void BenchCopyKernel(float const *in, float *out, uint32_t count) {
+	for (uint32_t i = blockIdx.x * blockDim.x + threadIdx.x; i < count; i += gridDim.x * blockDim.x) {
+		out[i] = in[i];
+	}
+}
+
+// four independent multiply add chains per thread so the alus stay busy
+__global__ void BenchComputeKernel(float *out) {
+	uint32_t const index = blockIdx.x * blockDim.x + threadIdx.x;
+	float const seed = (float) index;
+	float a = seed, b = seed + 1.0f, c = seed + 2.0f, d = seed + 3.0f;
+	for (int i = 0; i < CUDA_BENCH_COMPUTE_LOOPS; ++i) {
+		a = a * 0.999f + 0.5f;
+		b = b * 0.999f + 0.5f;
+		c = c * 0.999f + 0.5f;
+		d = d * 0.999f + 0.5f;
+	}
+	out[index] = a + b + c + d;
+}
+
+// best of CUDA_BENCH_REPEATS after a warm up launch, 0 on failure
+template<typename F>
+float BenchBestMs(F const &launch) {
+	cudaEvent_t start = nullptr;
+	cudaEvent_t stop = nullptr;
+	float best = 0.0f;
+	bool ok = CudaOk(cudaEventCreate(&start), "event create") &&
+			CudaOk(cudaEventCreate(&stop), "event create");
+	if (ok) {
+		launch();
+		ok = CudaOk(cudaDeviceSynchronize(), "bench warm up");
+	}
+	for (uint32_t i = 0; ok && i < CUDA_BENCH_REPEATS; ++i) {
+		float ms = 0.0f;
+		cudaEventRecord(start);
+		launch();
+		cudaEventRecord(stop);
+		ok = CudaOk(cudaEventSynchronize(stop), "bench") &&
+				CudaOk(cudaEventElapsedTime(&ms, start, stop), "bench timing");
+		if (ok && (i == 0 || ms < best)) best = ms;
+	}
+	if (start) cudaEventDestroy(start);
+	if (stop) cudaEventDestroy(stop);
+	return ok ? best : 0.0f;
+}
+
+// a device that fails to benchmark scores zero and so is never picked
+Accel_DeviceScore BenchDevice(int deviceIndex, cudaDeviceProp const &prop) {
+	Accel_DeviceScore score{};
+	if (!CudaOk(cudaSetDevice(deviceIndex), "set device")) return score;
+
+	float *in = nullptr;
+	float *out = nullptr;
+	size_t const bytes = CUDA_BENCH_BANDWIDTH_FLOATS * sizeof(float);
+	if (CudaOk(cudaMalloc(&in, bytes), "bench alloc") && CudaOk(cudaMalloc(&out, bytes), "bench alloc")) {
+		uint32_t const blocks = (uint32_t) prop.multiProcessorCount * 8;
+		float const copyMs = BenchBestMs([&]() {
+			BenchCopyKernel<<<blocks, 256>>>(in, out, CUDA_BENCH_BANDWIDTH_FLOATS);
+		});
+		float const computeMs = BenchBestMs([&]() {
+			BenchComputeKernel<<<CUDA_BENCH_COMPUTE_BLOCKS, CUDA_BENCH_COMPUTE_THREADS>>>(out);
+		});
+
+		double const flops = 2.0 * 4.0 * CUDA_BENCH_COMPUTE_LOOPS * CUDA_BENCH_COMPUTE_BLOCKS * CUDA_BENCH_COMPUTE_THREADS;
+		score.bandwidthGBs = copyMs > 0.0f ? 2.0 * bytes / (copyMs * 1e6) : 0.0;
+		score.gflops = computeMs > 0.0f ? flops / (computeMs * 1e6) : 0.0;
+	}
+	if (in) cudaFree(in);
+	if (out) cudaFree(out);
+	return score;
+}
+
+} // end anon namespace
+
 struct Cuda {
 	int deviceIndex;
 };
 
+// every usable device is benchmarked (or looked up in the device cache, see
+// accel_devicecache.hpp) and the lowest estimated step cost wins
 Cuda *AccelCUDA_Create() {
+	int deviceCount = 0;
+	if (!CudaOk(cudaGetDeviceCount(&deviceCount), "device count")) return nullptr;
+
+	int driverVersion = 0;
+	checkCudaErrors(cudaDriverGetVersion(&driverVersion));
+	char driver[32];
+	snprintf(driver, sizeof(driver), "%d", driverVersion);
 
-	int deviceCount;
 	int pickedDeviceIndex = -1;
-	int pickedTotalCores = -1;
-	cudaDeviceProp pickedDevice{};
-	checkCudaErrors(cudaGetDeviceCount(&deviceCount));
+	double pickedCost = INFINITY;
 	LOGINFO("--- CUDA Devices ---");
 
-	for (int i = 0u; i < deviceCount; ++i) {
+	for (int i = 0; i < deviceCount; ++i) {
 		cudaDeviceProp deviceProp;
 		int computeMode = -1;
 		checkCudaErrors(cudaDeviceGetAttribute(&computeMode, cudaDevAttrComputeMode, i));
 
-		if(computeMode == cudaComputeModeProhibited) continue;
-
-		checkCudaErrors(cudaGetDeviceProperties(&deviceProp, i));
+		if (computeMode == cudaComputeModeProhibited) continue;
 
-		int const coresPerSM = _ConvertSMVer2Cores(deviceProp.major, deviceProp.minor);
-		int const totalCores = coresPerSM * deviceProp.multiProcessorCount;
-		int const computePerf = totalCores * (deviceProp.clockRate/1024);
+		if (!CudaOk(cudaGetDeviceProperties(&deviceProp, i), "device properties")) continue;
 
-		LOGINFO("%d: %s %s (%d.%d)", i,
-				deviceProp.name, _ConvertSMVer2ArchName(deviceProp.major, deviceProp.minor), deviceProp.major, deviceProp.minor);
-		LOGINFO("%d: SMs %d, Cores %d, Total Cores %d Clock %d ~GFLOPs %f", i,
-				deviceProp.multiProcessorCount, coresPerSM, totalCores, deviceProp.clockRate/1024, ((float)2 * computePerf)/1024.0f);
+		Accel_DeviceScore score{};
+		bool const cached = Accel_DeviceCacheLookup("CUDA", deviceProp.name, driver, &score);
+		if (!cached) {
+			score = BenchDevice(i, deviceProp);
+			if (score.bandwidthGBs > 0.0 && score.gflops > 0.0) {
+				Accel_DeviceCacheStore("CUDA", deviceProp.name, driver, &score);
+			}
+		}
+		LOGINFO("%d: %s (%d.%d) SMs %d, %.1f GB/s %.1f GFLOPs%s", i,
+						deviceProp.name, deviceProp.major, deviceProp.minor, deviceProp.multiProcessorCount,
+						score.bandwidthGBs, score.gflops, cached ? " (cached)" : "");
 
-		// for now just pick the biggest new enough device
-		if (totalCores > pickedTotalCores) {
-			memcpy(&pickedDevice, &deviceProp, sizeof(cudaDeviceProp));
+		double const cost = Accel_DeviceStepCost(&score);
+		if (cost < pickedCost) {
 			pickedDeviceIndex = i;
-			pickedTotalCores = totalCores;
+			pickedCost = cost;
 		}
 	}
 
@@ -160,4 +177,405 @@ void AccelCUDA_Destroy(Cuda *cuda) {
 	if(!cuda) return;
 
 	MEMORY_FREE(cuda);
-}
\ No newline at end of file
+}
+
+#define CUDA_STEP_GROUP 16
+#define CUDA_STEP_TILE_STRIDE (CUDA_STEP_GROUP + 2)
+
+struct CudaChannel {
+	uint32_t worldChannel;
+	int16_t *front;
+	int16_t *back;
+	size_t pitchBytes;
+};
+
+struct CudaWorld {
+	Cuda *cuda;
+	World2D *world;
+	uint32_t consumer;
+	cudaStream_t stream;
+
+	uint32_t channelCount;
+	CudaChannel channels[WORLD2D_MAX_CHANNELS];
+
+	// per dirty tile, set by the step kernels when any cell changes
+	uint32_t *changed;
+	uint32_t *changedHost;
+
+	// keys the stochastic rules, taken from the world each full step and
+	// advanced by every kernel run so back to back runs draw like ticks would
+	uint64_t tick;
+};
+
+namespace {
+
+enum StepPostOp {
+	SPO_NONE,
+	SPO_GROW,
+	SPO_DECAY,
+};
+
+struct ChannelStep {
+	uint32_t shift;
+	bool nine;
+	StepPostOp postOp;
+	int16_t a;	// growth or decay
+	int16_t b;	// capacity
+	// food sprouting, keyed the same as the cpu step so the draws match
+	uint16_t sproutChance;
+	int16_t sprout;
+	uint64_t seed;
+	uint64_t tick;
+};
+
+ChannelStep ChannelStepFor(uint32_t channel, World2D_StepParams const *params, uint64_t tick) {
+	ChannelStep step{};
+	switch (channel) {
+		case WMC_FOOD: step = {params->foodDiffuseShift, false, SPO_GROW, params->foodGrowth, params->foodCapacity,
+													 params->foodSproutChance, params->foodSprout};
+			break;
+		case WMC_MOISTURE: step = {params->moistureDiffuseShift, true, SPO_NONE, 0, 0};
+			break;
+		case WMC_PHEROMONE: step = {params->pheromoneDiffuseShift, false, SPO_DECAY, params->pheromoneDecay, 0};
+			break;
+		default: ASSERT(false);
+			break;
+	}
+	step.seed = params->seed;
+	step.tick = tick;
+	return step;
+}
+
+// each block loads its cells plus a one cell clamped border into shared
+// memory, then every thread runs the same per cell ops as the cpu step so
+// the results are bit identical
+__global__ void StepChannelKernel(int16_t const *src, size_t srcPitch, int16_t *dst, size_t dstPitch,
+																	int width, int height, ChannelStep step, uint32_t *changed, int tilesX) {
+	__shared__ int16_t tile[CUDA_STEP_TILE_STRIDE * CUDA_STEP_TILE_STRIDE];
+
+	int const lx = threadIdx.x;
+	int const ly = threadIdx.y;
+	int const gx0 = blockIdx.x * CUDA_STEP_GROUP;
+	int const gy0 = blockIdx.y * CUDA_STEP_GROUP;
+
+	for (int i = ly * CUDA_STEP_GROUP + lx; i < CUDA_STEP_TILE_STRIDE * CUDA_STEP_TILE_STRIDE;
+			 i += CUDA_STEP_GROUP * CUDA_STEP_GROUP) {
+		int const sx = min(max(gx0 + (i % CUDA_STEP_TILE_STRIDE) - 1, 0), width - 1);
+		int const sy = min(max(gy0 + (i / CUDA_STEP_TILE_STRIDE) - 1, 0), height - 1);
+		tile[i] = ((int16_t const *) ((uint8_t const *) src + sy * srcPitch))[sx];
+	}
+	__syncthreads();
+
+	int const x = gx0 + lx;
+	int const y = gy0 + ly;
+	if (x >= width || y >= height) return;
+
+	int const t = (ly + 1) * CUDA_STEP_TILE_STRIDE + lx + 1;
+	int16_t const c = tile[t];
+	int16_t const n = tile[t - CUDA_STEP_TILE_STRIDE];
+	int16_t const s = tile[t + CUDA_STEP_TILE_STRIDE];
+	int16_t const e = tile[t + 1];
+	int16_t const w = tile[t - 1];
+	int16_t v;
+	if (step.nine) {
+		v = World2D_Diffuse9Cell(c, n, s, e, w,
+														 tile[t - CUDA_STEP_TILE_STRIDE - 1], tile[t - CUDA_STEP_TILE_STRIDE + 1],
+														 tile[t + CUDA_STEP_TILE_STRIDE - 1], tile[t + CUDA_STEP_TILE_STRIDE + 1],
+														 step.shift);
+	} else {
+		v = World2D_Diffuse5Cell(c, n, s, e, w, step.shift);
+	}
+	if (step.postOp == SPO_GROW) {
+		v = World2D_GrowCell(v, step.a, step.b);
+		if (step.sproutChance) {
+			uint32_t const random = World2D_Random(step.seed, step.tick, WORLD2D_RNG_STREAM_FOOD_SPROUT, (uint32_t) y * (uint32_t) width + (uint32_t) x);
+			v = World2D_SproutCell(v, random, step.sproutChance, step.sprout, step.b);
+		}
+	} else if (step.postOp == SPO_DECAY) {
+		v = World2D_DecayCell(v, step.a);
+	}
+
+	((int16_t *) ((uint8_t *) dst + y * dstPitch))[x] = v;
+	if (v != c) {
+		changed[(y >> WORLD2D_DIRTY_TILE_SHIFT) * tilesX + (x >> WORLD2D_DIRTY_TILE_SHIFT)] = 1u;
+	}
+}
+
+bool ClipRect(World2D const *world, World2D_Rect const &rect, World2D_Rect &clipped) {
+	if (rect.x >= world->width || rect.y >= world->height) return false;
+	clipped.x = rect.x;
+	clipped.y = rect.y;
+	clipped.width = (rect.width < world->width - rect.x) ? rect.width : world->width - rect.x;
+	clipped.height = (rect.height < world->height - rect.y) ? rect.height : world->height - rect.y;
+	return clipped.width > 0 && clipped.height > 0;
+}
+
+CudaChannel *FindChannel(CudaWorld *cworld, uint32_t worldChannel) {
+	for (uint32_t i = 0; i < cworld->channelCount; ++i) {
+		if (cworld->channels[i].worldChannel == worldChannel) return &cworld->channels[i];
+	}
+	return nullptr;
+}
+
+// Accel_Backend glue, the instance is the Cuda and the world bound to it
+struct CudaAccel {
+	Cuda *cuda;
+	CudaWorld *world;
+};
+
+void *BackendCreate(enkiTaskSchedulerHandle scheduler) {
+	Cuda *cuda = AccelCUDA_Create();
+	if (!cuda) return nullptr;
+	CudaAccel *accel = (CudaAccel *) MEMORY_CALLOC(1, sizeof(CudaAccel));
+	if (!accel) {
+		AccelCUDA_Destroy(cuda);
+		return nullptr;
+	}
+	accel->cuda = cuda;
+	return accel;
+}
+
+void BackendDestroy(void *instance) {
+	CudaAccel *accel = (CudaAccel *) instance;
+	AccelCUDA_WorldDestroy(accel->world);
+	AccelCUDA_Destroy(accel->cuda);
+	MEMORY_FREE(accel);
+}
+
+bool BackendAllocateChannels(void *instance, World2D *world) {
+	CudaAccel *accel = (CudaAccel *) instance;
+	AccelCUDA_WorldDestroy(accel->world);
+	accel->world = AccelCUDA_WorldCreate(accel->cuda, world);
+	return accel->world != nullptr;
+}
+
+void BackendReleaseChannels(void *instance) {
+	CudaAccel *accel = (CudaAccel *) instance;
+	AccelCUDA_WorldDestroy(accel->world);
+	accel->world = nullptr;
+}
+
+bool BackendUploadRegion(void *instance, uint32_t channel, World2D_Rect const &rect) {
+	return AccelCUDA_WorldUploadRect(((CudaAccel *) instance)->world, channel, rect);
+}
+
+bool BackendDownloadRegion(void *instance, uint32_t channel, World2D_Rect const &rect) {
+	return AccelCUDA_WorldDownloadRect(((CudaAccel *) instance)->world, channel, rect);
+}
+
+bool BackendRunKernel(void *instance, World2D_StepParams const *params) {
+	return AccelCUDA_WorldRunStep(((CudaAccel *) instance)->world, params);
+}
+
+bool BackendFence(void *instance) {
+	return AccelCUDA_WorldFence(((CudaAccel *) instance)->world);
+}
+
+bool BackendStep(void *instance, World2D_StepParams const *params) {
+	return AccelCUDA_WorldStep(((CudaAccel *) instance)->world, params);
+}
+
+Accel_Backend const CudaBackend = {
+		"CUDA",
+		&BackendCreate,
+		&BackendDestroy,
+		&BackendAllocateChannels,
+		&BackendReleaseChannels,
+		&BackendUploadRegion,
+		&BackendDownloadRegion,
+		&BackendRunKernel,
+		&BackendFence,
+		&BackendStep,
+};
+
+} // end anon namespace
+
+Accel_Backend const *AccelCUDA_Backend() {
+	return &CudaBackend;
+}
+
+CudaWorld *AccelCUDA_WorldCreate(Cuda *cuda, World2D *world) {
+	ASSERT(cuda);
+	ASSERT(world);
+	if (world->type != WT_MOE) {
+		LOGERROR("CUDA world step only supports WT_MOE worlds");
+		return nullptr;
+	}
+
+	CudaWorld *cworld = (CudaWorld *) MEMORY_CALLOC(1, sizeof(CudaWorld));
+	if (!cworld) return nullptr;
+	cworld->cuda = cuda;
+	cworld->world = world;
+	cworld->consumer = WORLD2D_INVALID_DIRTY_CONSUMER;
+	cworld->tick = world->tick;
+
+	size_t const tileCount = (size_t) world->dirtyTilesX * world->dirtyTilesY;
+	if (!CudaOk(cudaSetDevice(cuda->deviceIndex), "set device")) goto Fail;
+	if (!CudaOk(cudaStreamCreate(&cworld->stream), "stream create")) goto Fail;
+	if (!CudaOk(cudaMalloc(&cworld->changed, tileCount * sizeof(uint32_t)), "changed alloc")) goto Fail;
+	if (!CudaOk(cudaMallocHost(&cworld->changedHost, tileCount * sizeof(uint32_t)), "changed host alloc")) goto Fail;
+
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		World2DChannel const &channel = world->channels[i];
+		if (!channel.doubleBuffered) continue;
+		if (channel.elementSize != sizeof(int16_t) || channel.layout != WL_ROW_MAJOR) {
+			LOGERROR("CUDA world step only supports row major 16 bit channels (%s)", channel.name);
+			goto Fail;
+		}
+
+		CudaChannel &dst = cworld->channels[cworld->channelCount++];
+		dst.worldChannel = i;
+		size_t backPitch;
+		if (!CudaOk(cudaMallocPitch(&dst.front, &dst.pitchBytes, world->width * sizeof(int16_t), world->height), "plane alloc")) goto Fail;
+		if (!CudaOk(cudaMallocPitch(&dst.back, &backPitch, world->width * sizeof(int16_t), world->height), "plane alloc")) goto Fail;
+		ASSERT(backPitch == dst.pitchBytes);
+	}
+
+	// new consumers start all dirty, so the first step uploads everything
+	cworld->consumer = World2D_DirtyConsumerRegister(world);
+	if (cworld->consumer == WORLD2D_INVALID_DIRTY_CONSUMER) goto Fail;
+
+	return cworld;
+Fail:
+	AccelCUDA_WorldDestroy(cworld);
+	return nullptr;
+}
+
+void AccelCUDA_WorldDestroy(CudaWorld *cworld) {
+	if (!cworld) return;
+	cudaSetDevice(cworld->cuda->deviceIndex);
+	if (cworld->consumer != WORLD2D_INVALID_DIRTY_CONSUMER) {
+		World2D_DirtyConsumerUnregister(cworld->world, cworld->consumer);
+	}
+	if (cworld->stream) cudaStreamSynchronize(cworld->stream);
+	for (uint32_t i = 0; i < cworld->channelCount; ++i) {
+		if (cworld->channels[i].front) cudaFree(cworld->channels[i].front);
+		if (cworld->channels[i].back) cudaFree(cworld->channels[i].back);
+	}
+	if (cworld->changed) cudaFree(cworld->changed);
+	if (cworld->changedHost) cudaFreeHost(cworld->changedHost);
+	if (cworld->stream) cudaStreamDestroy(cworld->stream);
+	MEMORY_FREE(cworld);
+}
+
+bool AccelCUDA_WorldUploadRect(CudaWorld *cworld, uint32_t worldChannel, World2D_Rect const &rect) {
+	ASSERT(cworld);
+	// the calling thread may have another device current, every entry point binds ours
+	if (!CudaOk(cudaSetDevice(cworld->cuda->deviceIndex), "set device")) return false;
+	CudaChannel *channel = FindChannel(cworld, worldChannel);
+	World2D_Rect r;
+	if (!channel || !ClipRect(cworld->world, rect, r)) return true;
+
+	auto const view = World2D_ElementsAs<int16_t>(cworld->world, worldChannel);
+	int16_t const *src = view.row(r.y) + r.x;
+	uint8_t *dst = (uint8_t *) channel->front + r.y * channel->pitchBytes + r.x * sizeof(int16_t);
+	// pageable host memory, so the copy has finished with src when this returns
+	return CudaOk(cudaMemcpy2DAsync(dst, channel->pitchBytes, src, view.pitch * sizeof(int16_t),
+																	r.width * sizeof(int16_t), r.height, cudaMemcpyHostToDevice, cworld->stream), "upload");
+}
+
+bool AccelCUDA_WorldDownloadRect(CudaWorld *cworld, uint32_t worldChannel, World2D_Rect const &rect) {
+	ASSERT(cworld);
+	if (!CudaOk(cudaSetDevice(cworld->cuda->deviceIndex), "set device")) return false;
+	CudaChannel *channel = FindChannel(cworld, worldChannel);
+	World2D_Rect r;
+	if (!channel || !ClipRect(cworld->world, rect, r)) return true;
+
+	auto const view = World2D_MutableElementsAs<int16_t>(cworld->world, worldChannel);
+	int16_t *dst = view.row(r.y) + r.x;
+	uint8_t const *src = (uint8_t const *) channel->front + r.y * channel->pitchBytes + r.x * sizeof(int16_t);
+	return CudaOk(cudaMemcpy2DAsync(dst, view.pitch * sizeof(int16_t), src, channel->pitchBytes,
+																	r.width * sizeof(int16_t), r.height, cudaMemcpyDeviceToHost, cworld->stream), "download") &&
+			CudaOk(cudaStreamSynchronize(cworld->stream), "download sync");
+}
+
+bool AccelCUDA_WorldRunStep(CudaWorld *cworld, World2D_StepParams const *params) {
+	ASSERT(cworld);
+	ASSERT(params);
+	if (!CudaOk(cudaSetDevice(cworld->cuda->deviceIndex), "set device")) return false;
+	World2D const *world = cworld->world;
+
+	size_t const tileCount = (size_t) world->dirtyTilesX * world->dirtyTilesY;
+	if (!CudaOk(cudaMemsetAsync(cworld->changed, 0, tileCount * sizeof(uint32_t), cworld->stream), "changed clear")) return false;
+
+	dim3 const block(CUDA_STEP_GROUP, CUDA_STEP_GROUP);
+	dim3 const grid((world->width + CUDA_STEP_GROUP - 1) / CUDA_STEP_GROUP, (world->height + CUDA_STEP_GROUP - 1) / CUDA_STEP_GROUP);
+	for (uint32_t i = 0; i < cworld->channelCount; ++i) {
+		CudaChannel &channel = cworld->channels[i];
+		StepChannelKernel<<<grid, block, 0, cworld->stream>>>(
+				channel.front, channel.pitchBytes, channel.back, channel.pitchBytes,
+				(int) world->width, (int) world->height,
+				ChannelStepFor(channel.worldChannel, params, cworld->tick),
+				cworld->changed, (int) world->dirtyTilesX);
+		if (!CudaOk(cudaGetLastError(), "step launch")) return false;
+
+		// later work on the stream is ordered after the kernel
+		int16_t *tmp = channel.front;
+		channel.front = channel.back;
+		channel.back = tmp;
+	}
+	cworld->tick++;
+	return true;
+}
+
+bool AccelCUDA_WorldFence(CudaWorld *cworld) {
+	ASSERT(cworld);
+	return CudaOk(cudaSetDevice(cworld->cuda->deviceIndex), "set device") &&
+			CudaOk(cudaStreamSynchronize(cworld->stream), "fence");
+}
+
+bool AccelCUDA_WorldStep(CudaWorld *cworld, World2D_StepParams const *params) {
+	ASSERT(cworld);
+	if (!CudaOk(cudaSetDevice(cworld->cuda->deviceIndex), "set device")) return false;
+	World2D *world = cworld->world;
+
+	// host writes since the last step
+	if (World2D_IsAnyDirty(world, cworld->consumer)) {
+		World2D_Rect rects[64];
+		uint32_t const rectCount = World2D_GetDirtyRects(world, cworld->consumer, rects, 64);
+		for (uint32_t i = 0; i < rectCount; ++i) {
+			for (uint32_t c = 0; c < cworld->channelCount; ++c) {
+				if (!AccelCUDA_WorldUploadRect(cworld, cworld->channels[c].worldChannel, rects[i])) return false;
+			}
+		}
+		World2D_ClearDirty(world, cworld->consumer);
+	}
+
+	cworld->tick = world->tick;
+	if (!AccelCUDA_WorldRunStep(cworld, params)) return false;
+
+	size_t const tileCount = (size_t) world->dirtyTilesX * world->dirtyTilesY;
+	if (!CudaOk(cudaMemcpyAsync(cworld->changedHost, cworld->changed, tileCount * sizeof(uint32_t),
+															cudaMemcpyDeviceToHost, cworld->stream), "changed read")) return false;
+	if (!AccelCUDA_WorldFence(cworld)) return false;
+
+	// only bring back runs of tiles the step changed
+	for (uint32_t ty = 0; ty < world->dirtyTilesY; ++ty) {
+		uint32_t tx = 0;
+		while (tx < world->dirtyTilesX) {
+			if (!cworld->changedHost[ty * world->dirtyTilesX + tx]) {
+				++tx;
+				continue;
+			}
+			uint32_t const runStart = tx;
+			while (tx < world->dirtyTilesX && cworld->changedHost[ty * world->dirtyTilesX + tx]) ++tx;
+
+			World2D_Rect const rect{
+					runStart << WORLD2D_DIRTY_TILE_SHIFT,
+					ty << WORLD2D_DIRTY_TILE_SHIFT,
+					(tx - runStart) << WORLD2D_DIRTY_TILE_SHIFT,
+					WORLD2D_DIRTY_TILE_SIZE};
+			for (uint32_t c = 0; c < cworld->channelCount; ++c) {
+				if (!AccelCUDA_WorldDownloadRect(cworld, cworld->channels[c].worldChannel, rect)) return false;
+			}
+			World2D_MarkDirtyRect(world, rect.x, rect.y, rect.width, rect.height);
+			// the device already has these, don't send them straight back
+			for (uint32_t x = runStart; x < tx; ++x) {
+				World2D_ClearDirtyTile(world, cworld->consumer, x, ty);
+			}
+		}
+	}
+
+	world->tick++;
+	return true;
+}
@@ -1,7 +1,22 @@
 // License Summary: MIT see LICENSE file
 #pragma once
 
+#include "world2d.hpp"
+#include "world2d_step.hpp"
+
 struct Cuda;
+struct CudaWorld;
 
 Cuda* AccelCUDA_Create();
-void AccelCUDA_Destroy(Cuda* cuda);
\ No newline at end of file
+void AccelCUDA_Destroy(Cuda* cuda);
+
+// the CUDA twin of SyclWorld, the stepped channels stay resident in pitched
+// device memory and only host dirty / device changed tiles cross the bus
+CudaWorld* AccelCUDA_WorldCreate(Cuda* cuda, World2D* world);
+void AccelCUDA_WorldDestroy(CudaWorld* cworld);
+
+bool AccelCUDA_WorldUploadRect(CudaWorld* cworld, uint32_t channel, World2D_Rect const& rect);
+bool AccelCUDA_WorldDownloadRect(CudaWorld* cworld, uint32_t channel, World2D_Rect const& rect);
+bool AccelCUDA_WorldRunStep(CudaWorld* cworld, World2D_StepParams const* params);
+bool AccelCUDA_WorldFence(CudaWorld* cworld);
+bool AccelCUDA_WorldStep(CudaWorld* cworld, World2D_StepParams const* params);
@@ -0,0 +1,97 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "accel_devicecache.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// api \t name \t driver, with any tabs or newlines in the parts flattened so
+// the line format can't be broken by an odd device name
+void MakeKey(char const* api, char const* name, char const* driver, char* key) {
+	char const* parts[3] = {api, name, driver};
+	size_t size = 0;
+	for (uint32_t i = 0; i < 3; ++i) {
+		if (i > 0 && size < ACCEL_DEVICE_CACHE_KEY_SIZE - 1) key[size++] = '\t';
+		for (char const* c = parts[i]; *c && size < ACCEL_DEVICE_CACHE_KEY_SIZE - 1; ++c) {
+			key[size++] = (*c == '\t' || *c == '\n' || *c == '\r') ? ' ' : *c;
+		}
+	}
+	key[size] = 0;
+}
+
+// splits a cache line into its key and score, false if it's malformed
+bool ParseLine(char const* line, std::string& key, Accel_DeviceScore& score) {
+	char const* tab = line;
+	for (uint32_t i = 0; i < 3; ++i) {
+		tab = strchr(tab, '\t');
+		if (!tab) return false;
+		if (i < 2) ++tab;
+	}
+	key.assign(line, tab - line);
+	return sscanf(tab + 1, "%lf %lf", &score.bandwidthGBs, &score.gflops) == 2;
+}
+
+} // end anon namespace
+
+bool Accel_DeviceCacheLookup(char const* api, char const* name, char const* driver, Accel_DeviceScore* score) {
+	ASSERT(score);
+	char key[ACCEL_DEVICE_CACHE_KEY_SIZE];
+	MakeKey(api, name, driver, key);
+
+	FILE* file = fopen(ACCEL_DEVICE_CACHE_FILE, "r");
+	if (!file) return false;
+
+	bool found = false;
+	char line[ACCEL_DEVICE_CACHE_KEY_SIZE + 64];
+	std::string lineKey;
+	Accel_DeviceScore lineScore;
+	while (!found && fgets(line, sizeof(line), file)) {
+		if (ParseLine(line, lineKey, lineScore) && lineKey == key) {
+			*score = lineScore;
+			found = true;
+		}
+	}
+	fclose(file);
+	return found;
+}
+
+void Accel_DeviceCacheStore(char const* api, char const* name, char const* driver, Accel_DeviceScore const* score) {
+	ASSERT(score);
+	char key[ACCEL_DEVICE_CACHE_KEY_SIZE];
+	MakeKey(api, name, driver, key);
+
+	// keep every other device's line
+	std::vector<std::string> lines;
+	if (FILE* file = fopen(ACCEL_DEVICE_CACHE_FILE, "r")) {
+		char line[ACCEL_DEVICE_CACHE_KEY_SIZE + 64];
+		std::string lineKey;
+		Accel_DeviceScore lineScore;
+		while (fgets(line, sizeof(line), file)) {
+			if (ParseLine(line, lineKey, lineScore) && lineKey != key) lines.emplace_back(line);
+		}
+		fclose(file);
+	}
+
+	FILE* file = fopen(ACCEL_DEVICE_CACHE_FILE, "w");
+	if (!file) {
+		LOGINFO("Unable to write the device cache %s", ACCEL_DEVICE_CACHE_FILE);
+		return;
+	}
+	for (std::string const& line : lines) fputs(line.c_str(), file);
+	fprintf(file, "%s\t%f %f\n", key, score->bandwidthGBs, score->gflops);
+	if (fclose(file) != 0) {
+		LOGINFO("Failed writing the device cache %s", ACCEL_DEVICE_CACHE_FILE);
+	}
+}
+
+double Accel_DeviceStepCost(Accel_DeviceScore const* score) {
+	ASSERT(score);
+	if (score->bandwidthGBs <= 0.0 || score->gflops <= 0.0) return INFINITY;
+	// GB/s and GFLOP/s are both per ns
+	return ACCEL_DEVICE_STEP_BYTES / score->bandwidthGBs + ACCEL_DEVICE_STEP_FLOPS / score->gflops;
+}
@@ -0,0 +1,28 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+
+// Measured device numbers shared by the SYCL and CUDA device pickers. A
+// benchmark result is cached in a small text file, one device per line keyed
+// by api, device name and driver version, so a driver update or a new card is
+// re-measured but a normal startup isn't.
+#define ACCEL_DEVICE_CACHE_FILE "accel_devices.cache"
+#define ACCEL_DEVICE_CACHE_KEY_SIZE 256
+
+struct Accel_DeviceScore {
+	double bandwidthGBs;
+	double gflops;
+};
+
+// true and score filled in if api/name/driver has been measured before
+bool Accel_DeviceCacheLookup(char const* api, char const* name, char const* driver, Accel_DeviceScore* score);
+// adds or replaces the entry, failing to write the cache isn't fatal so only logs
+void Accel_DeviceCacheStore(char const* api, char const* name, char const* driver, Accel_DeviceScore const* score);
+
+// estimated ns per cell of a world step, a memory bound stencil moving about
+// ACCEL_DEVICE_STEP_BYTES per cell with ACCEL_DEVICE_STEP_FLOPS of ALU work.
+// Lower is better, a device that failed to measure scores infinity
+#define ACCEL_DEVICE_STEP_BYTES 4.0
+#define ACCEL_DEVICE_STEP_FLOPS 12.0
+double Accel_DeviceStepCost(Accel_DeviceScore const* score);
@@ -6,62 +6,236 @@
 
 #include "al2o3_platform/platform.h"
 #include "accel_sycl.hpp"
+#include "accel.hpp"
+#include "accel_devicecache.hpp"
+#include "world2d_kernels.hpp"
+#include "world2d_rng.hpp"
 #include <CL/sycl.hpp>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
 
 struct Sycl {
 	Sycl(cl::sycl::device &dev) :
 			device(dev),
-			queue(dev) {
+			queue(dev, [](cl::sycl::exception_list exceptions) {
+				for (std::exception_ptr const &e : exceptions) {
+					try {
+						std::rethrow_exception(e);
+					} catch (cl::sycl::exception const &se) {
+						LOGERROR("Sycl async exception %s", se.what());
+					}
+				}
+			}) {
 	}
 
 	cl::sycl::device device;
 	cl::sycl::queue queue;
 };
 
-class selftestTag;
+// a device copy of one double buffered 16 bit channel
+struct SyclChannel {
+	uint32_t worldChannel;
+	cl::sycl::buffer<int16_t, 2> front;
+	cl::sycl::buffer<int16_t, 2> back;
+};
 
-/* Classes can inherit from the device_selector class to allow users
- * to dictate the criteria for choosing a device from those that might be
- * present on a system. This example looks for a device with SPIR support
- * and prefers GPUs over CPUs. */
-class custom_selector : public cl::sycl::device_selector {
-public:
-	custom_selector() : device_selector() {}
-
-	/* The selection is performed via the () operator in the base
-	 * selector class.This method will be called once per device in each
-	 * platform. Note that all platforms are evaluated whenever there is
-	 * a device selection. */
-	int operator()(const cl::sycl::device &device) const override {
-		using namespace cl::sycl;
-		bool const isGPU = device.get_info<info::device::device_type>() == info::device_type::gpu;
-		/*
-		LOGINFO("-----");
-		LOGINFO("%s - %s", device.get_info<info::device::vendor>().c_str(),
-						device.get_info<info::device::name>().c_str());
-		LOGINFO("CUs - %d, gpu - %d",
-					 device.get_info<info::device::max_compute_units>(),
-					 isGPU);*/
-		return device.get_info<info::device::max_compute_units>() + (isGPU * 1024);
+struct SyclWorld {
+	SyclWorld(Sycl *sycl_, World2D *world_) :
+			sycl(sycl_),
+			world(world_),
+			changed(cl::sycl::range<1>(world_->dirtyTilesX * world_->dirtyTilesY)),
+			tick(world_->tick) {
 	}
 
+	Sycl *sycl;
+	World2D *world;
+	uint32_t consumer;
+	uint32_t groupSize;
+
+	std::vector<SyclChannel> channels;
+	// per dirty tile, set by the step kernels when any cell changes
+	cl::sycl::buffer<uint32_t, 1> changed;
+	std::vector<int16_t> staging;
+
+	// keys the stochastic rules, taken from the world each full step and
+	// advanced by every kernel run so back to back runs draw like ticks would
+	uint64_t tick;
+};
+
+class selftestTag;
+class stepTag;
+class benchBandwidthTag;
+class benchComputeTag;
+
+namespace {
+
+enum StepPostOp {
+	SPO_NONE,
+	SPO_GROW,
+	SPO_DECAY,
+};
+
+struct ChannelStep {
+	uint32_t shift;
+	bool nine;
+	StepPostOp postOp;
+	int16_t a;	// growth or decay
+	int16_t b;	// capacity
+	// food sprouting, keyed the same as the cpu step so the draws match
+	uint16_t sproutChance;
+	int16_t sprout;
+	uint64_t seed;
+	uint64_t tick;
 };
 
-Sycl *AccelSycl_Create() {
+// microbenchmark sizes, small enough that the host device finishes quickly
+#define SYCL_BENCH_BANDWIDTH_FLOATS (4u << 20)
+#define SYCL_BENCH_COMPUTE_ITEMS (1u << 16)
+#define SYCL_BENCH_COMPUTE_LOOPS 64
+#define SYCL_BENCH_REPEATS 3
+
+// best of SYCL_BENCH_REPEATS after a warm up run, which pays for the jit and
+// the first touch of the buffers
+template<typename F>
+double BenchBestMs(cl::sycl::queue &queue, F const &submit) {
+	submit();
+	queue.wait_and_throw();
+	double best = 0.0;
+	for (uint32_t i = 0; i < SYCL_BENCH_REPEATS; ++i) {
+		auto const start = std::chrono::steady_clock::now();
+		submit();
+		queue.wait_and_throw();
+		double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || ms < best) best = ms;
+	}
+	return best;
+}
+
+// a straight copy kernel, reads and writes SYCL_BENCH_BANDWIDTH_FLOATS each
+double BenchBandwidth(cl::sycl::queue &queue) {
 	using namespace cl::sycl;
+	range<1> const size(SYCL_BENCH_BANDWIDTH_FLOATS);
+	buffer<float, 1> src(size);
+	buffer<float, 1> dst(size);
+	double const ms = BenchBestMs(queue, [&]() {
+		queue.submit([&](handler &cgh) {
+			auto in = src.get_access<access::mode::read>(cgh);
+			auto out = dst.get_access<access::mode::discard_write>(cgh);
+			cgh.parallel_for<benchBandwidthTag>(size, [=](item<1> item) {
+				out[item.get_linear_id()] = in[item.get_linear_id()];
+			});
+		});
+	});
+	double const bytes = 2.0 * SYCL_BENCH_BANDWIDTH_FLOATS * sizeof(float);
+	return ms > 0.0 ? bytes / (ms * 1e6) : 0.0;
+}
 
-	custom_selector selector;
-	device dev = selector.select_device();
-	LOGINFO("-----\nSelected device %s %s has %d CUs @ %dMhz with %dKB local memory",
-					dev.get_info<info::device::vendor>().c_str(),
-					dev.get_info<info::device::name>().c_str(),
-					dev.get_info<info::device::max_compute_units>(),
-					dev.get_info<info::device::max_clock_frequency>(),
+// four independent multiply add chains per item so the alus stay busy
+double BenchCompute(cl::sycl::queue &queue) {
+	using namespace cl::sycl;
+	range<1> const size(SYCL_BENCH_COMPUTE_ITEMS);
+	buffer<float, 1> dst(size);
+	double const ms = BenchBestMs(queue, [&]() {
+		queue.submit([&](handler &cgh) {
+			auto out = dst.get_access<access::mode::discard_write>(cgh);
+			cgh.parallel_for<benchComputeTag>(size, [=](item<1> item) {
+				float const seed = (float) item.get_linear_id();
+				float a = seed, b = seed + 1.0f, c = seed + 2.0f, d = seed + 3.0f;
+				for (int i = 0; i < SYCL_BENCH_COMPUTE_LOOPS; ++i) {
+					a = a * 0.999f + 0.5f;
+					b = b * 0.999f + 0.5f;
+					c = c * 0.999f + 0.5f;
+					d = d * 0.999f + 0.5f;
+				}
+				out[item.get_linear_id()] = a + b + c + d;
+			});
+		});
+	});
+	double const flops = 2.0 * 4.0 * SYCL_BENCH_COMPUTE_LOOPS * SYCL_BENCH_COMPUTE_ITEMS;
+	return ms > 0.0 ? flops / (ms * 1e6) : 0.0;
+}
 
-					(int) dev.get_info<info::device::local_mem_size>() / 1024);
+// from the cache if this device and driver have been seen before, a device
+// that fails to benchmark scores zero and so is never picked
+Accel_DeviceScore MeasureDevice(cl::sycl::device const &dev) {
+	using namespace cl::sycl;
+	std::string const vendor = dev.get_info<info::device::vendor>();
+	std::string const name = vendor + " " + std::string(dev.get_info<info::device::name>());
+	std::string const driver = dev.get_info<info::device::driver_version>();
 
-	auto sycl = new Sycl{dev};
+	Accel_DeviceScore score{};
+	if (Accel_DeviceCacheLookup("SYCL", name.c_str(), driver.c_str(), &score)) {
+		LOGINFO("%s %.1f GB/s %.1f GFLOPs (cached)", name.c_str(), score.bandwidthGBs, score.gflops);
+		return score;
+	}
+
+	try {
+		queue queue(dev);
+		score.bandwidthGBs = BenchBandwidth(queue);
+		score.gflops = BenchCompute(queue);
+	} catch (cl::sycl::exception const &e) {
+		LOGINFO("%s benchmark failed %s", name.c_str(), e.what());
+		return Accel_DeviceScore{};
+	}
+	LOGINFO("%s %.1f GB/s %.1f GFLOPs", name.c_str(), score.bandwidthGBs, score.gflops);
+	Accel_DeviceCacheStore("SYCL", name.c_str(), driver.c_str(), &score);
+	return score;
+}
+
+bool MatchesPreference(cl::sycl::device const &dev, AccelSycl_DevicePreference preference) {
+	using namespace cl::sycl;
+	switch (preference) {
+		case ASDP_FASTEST: return true;
+		case ASDP_CPU: return !dev.is_host() && dev.get_info<info::device::device_type>() == info::device_type::cpu;
+		case ASDP_HOST: return dev.is_host();
+		default: return false;
+	}
+}
+
+// every device of the preferred kind is benchmarked and the one with the
+// lowest estimated step cost wins
+cl::sycl::device SelectDevice(AccelSycl_DevicePreference preference) {
+	using namespace cl::sycl;
+	device const host = host_selector().select_device();
+	if (preference == ASDP_HOST) return host;
 
+	std::vector<device> candidates;
+	bool hostListed = false;
+	try {
+		for (platform const &plat : platform::get_platforms()) {
+			for (device const &dev : plat.get_devices(info::device_type::all)) {
+				hostListed = hostListed || dev.is_host();
+				if (MatchesPreference(dev, preference)) candidates.push_back(dev);
+			}
+		}
+	} catch (cl::sycl::exception const &e) {
+		LOGINFO("Sycl device enumeration failed %s", e.what());
+	}
+	if (preference == ASDP_FASTEST && !hostListed) candidates.push_back(host);
+
+	LOGINFO("--- Sycl Devices ---");
+	device picked = host;
+	double pickedCost = INFINITY;
+	for (device const &dev : candidates) {
+		Accel_DeviceScore const score = MeasureDevice(dev);
+		double const cost = Accel_DeviceStepCost(&score);
+		if (cost < pickedCost) {
+			picked = dev;
+			pickedCost = cost;
+		}
+	}
+	LOGINFO("---");
+
+	if (pickedCost == INFINITY) {
+		LOGINFO("No matching Sycl device, using the host device");
+	}
+	return picked;
+}
+
+bool SelfTest(Sycl *sycl) {
+	using namespace cl::sycl;
 	const int dataSize = 2048;
 	float data[dataSize] = {0.f};
 
@@ -82,15 +256,419 @@ Sycl *AccelSycl_Create() {
 	accessor<float, 1, access::mode::read_write, access::target::host_buffer>
 			hostPtr(buf);
 
-	if (hostPtr[2013] != 2013.0f) {
+	return hostPtr[2013] == 2013.0f;
+}
+
+ChannelStep ChannelStepFor(World2D const *world, uint32_t channel, World2D_StepParams const *params, uint64_t tick) {
+	ChannelStep step{};
+	switch (channel) {
+		case WMC_FOOD: step = {params->foodDiffuseShift, false, SPO_GROW, params->foodGrowth, params->foodCapacity,
+													 params->foodSproutChance, params->foodSprout};
+			break;
+		case WMC_MOISTURE: step = {params->moistureDiffuseShift, true, SPO_NONE, 0, 0};
+			break;
+		case WMC_PHEROMONE: step = {params->pheromoneDiffuseShift, false, SPO_DECAY, params->pheromoneDecay, 0};
+			break;
+		default: ASSERT(false);
+			break;
+	}
+	step.seed = params->seed;
+	step.tick = tick;
+	return step;
+}
+
+// each work group loads its cells plus a one cell clamped border into local
+// memory, then every work item runs the same per cell ops as the cpu step so
+// the results are bit identical
+void EnqueueChannelStep(SyclWorld *sworld, SyclChannel &channel, ChannelStep const &step) {
+	using namespace cl::sycl;
+	int const width = (int) sworld->world->width;
+	int const height = (int) sworld->world->height;
+	int const group = (int) sworld->groupSize;
+	int const tileStride = group + 2;
+	int const tilesX = (int) sworld->world->dirtyTilesX;
+	size_t const globalX = ((size_t) width + group - 1) / group * group;
+	size_t const globalY = ((size_t) height + group - 1) / group * group;
+
+	sworld->sycl->queue.submit([&](handler &cgh) {
+		auto src = channel.front.get_access<access::mode::read>(cgh);
+		auto dst = channel.back.get_access<access::mode::discard_write>(cgh);
+		auto changed = sworld->changed.get_access<access::mode::atomic>(cgh);
+		accessor<int16_t, 1, access::mode::read_write, access::target::local>
+				tile(range<1>((size_t) tileStride * tileStride), cgh);
+
+		cgh.parallel_for<stepTag>(
+				nd_range<2>(range<2>(globalY, globalX), range<2>((size_t) group, (size_t) group)),
+				[=](nd_item<2> item) {
+					int const lx = (int) item.get_local_id(1);
+					int const ly = (int) item.get_local_id(0);
+					int const gx0 = (int) item.get_group(1) * group;
+					int const gy0 = (int) item.get_group(0) * group;
+
+					for (int i = ly * group + lx; i < tileStride * tileStride; i += group * group) {
+						int const sx = cl::sycl::clamp(gx0 + (i % tileStride) - 1, 0, width - 1);
+						int const sy = cl::sycl::clamp(gy0 + (i / tileStride) - 1, 0, height - 1);
+						tile[i] = src[id<2>((size_t) sy, (size_t) sx)];
+					}
+					item.barrier(access::fence_space::local_space);
+
+					int const x = gx0 + lx;
+					int const y = gy0 + ly;
+					if (x >= width || y >= height) return;
+
+					int const t = (ly + 1) * tileStride + lx + 1;
+					int16_t const c = tile[t];
+					int16_t const n = tile[t - tileStride];
+					int16_t const s = tile[t + tileStride];
+					int16_t const e = tile[t + 1];
+					int16_t const w = tile[t - 1];
+					int16_t v;
+					if (step.nine) {
+						v = World2D_Diffuse9Cell(c, n, s, e, w,
+																		 tile[t - tileStride - 1], tile[t - tileStride + 1],
+																		 tile[t + tileStride - 1], tile[t + tileStride + 1],
+																		 step.shift);
+					} else {
+						v = World2D_Diffuse5Cell(c, n, s, e, w, step.shift);
+					}
+					if (step.postOp == SPO_GROW) {
+						v = World2D_GrowCell(v, step.a, step.b);
+						if (step.sproutChance) {
+							uint32_t const random = World2D_Random(step.seed, step.tick, WORLD2D_RNG_STREAM_FOOD_SPROUT, (uint32_t) y * (uint32_t) width + (uint32_t) x);
+							v = World2D_SproutCell(v, random, step.sproutChance, step.sprout, step.b);
+						}
+					} else if (step.postOp == SPO_DECAY) {
+						v = World2D_DecayCell(v, step.a);
+					}
+
+					dst[id<2>((size_t) y, (size_t) x)] = v;
+					if (v != c) {
+						changed[(size_t) ((y >> WORLD2D_DIRTY_TILE_SHIFT) * tilesX + (x >> WORLD2D_DIRTY_TILE_SHIFT))].store(1u);
+					}
+				});
+	});
+}
+
+// makes sure a rect is inside the world and not empty
+bool ClipRect(World2D const *world, World2D_Rect const &rect, World2D_Rect &clipped) {
+	if (rect.x >= world->width || rect.y >= world->height) return false;
+	clipped.x = rect.x;
+	clipped.y = rect.y;
+	clipped.width = (rect.width < world->width - rect.x) ? rect.width : world->width - rect.x;
+	clipped.height = (rect.height < world->height - rect.y) ? rect.height : world->height - rect.y;
+	return clipped.width > 0 && clipped.height > 0;
+}
+
+SyclChannel *FindChannel(SyclWorld *sworld, uint32_t worldChannel) {
+	for (SyclChannel &channel : sworld->channels) {
+		if (channel.worldChannel == worldChannel) return &channel;
+	}
+	return nullptr;
+}
+
+// Accel_Backend glue, the instance is the Sycl and the world bound to it
+struct SyclAccel {
+	Sycl *sycl;
+	SyclWorld *world;
+};
+
+void *BackendCreate(enkiTaskSchedulerHandle scheduler) {
+	Sycl *sycl = AccelSycl_Create();
+	if (!sycl) return nullptr;
+	return new SyclAccel{sycl, nullptr};
+}
+
+void BackendDestroy(void *instance) {
+	SyclAccel *accel = (SyclAccel *) instance;
+	AccelSycl_WorldDestroy(accel->world);
+	AccelSycl_Destroy(accel->sycl);
+	delete accel;
+}
+
+bool BackendAllocateChannels(void *instance, World2D *world) {
+	SyclAccel *accel = (SyclAccel *) instance;
+	AccelSycl_WorldDestroy(accel->world);
+	accel->world = AccelSycl_WorldCreate(accel->sycl, world);
+	return accel->world != nullptr;
+}
+
+void BackendReleaseChannels(void *instance) {
+	SyclAccel *accel = (SyclAccel *) instance;
+	AccelSycl_WorldDestroy(accel->world);
+	accel->world = nullptr;
+}
+
+bool BackendUploadRegion(void *instance, uint32_t channel, World2D_Rect const &rect) {
+	return AccelSycl_WorldUploadRect(((SyclAccel *) instance)->world, channel, rect);
+}
+
+bool BackendDownloadRegion(void *instance, uint32_t channel, World2D_Rect const &rect) {
+	return AccelSycl_WorldDownloadRect(((SyclAccel *) instance)->world, channel, rect);
+}
+
+bool BackendRunKernel(void *instance, World2D_StepParams const *params) {
+	return AccelSycl_WorldRunStep(((SyclAccel *) instance)->world, params);
+}
+
+bool BackendFence(void *instance) {
+	return AccelSycl_WorldFence(((SyclAccel *) instance)->world);
+}
+
+bool BackendStep(void *instance, World2D_StepParams const *params) {
+	return AccelSycl_WorldStep(((SyclAccel *) instance)->world, params);
+}
+
+Accel_Backend const SyclBackend = {
+		"SYCL",
+		&BackendCreate,
+		&BackendDestroy,
+		&BackendAllocateChannels,
+		&BackendReleaseChannels,
+		&BackendUploadRegion,
+		&BackendDownloadRegion,
+		&BackendRunKernel,
+		&BackendFence,
+		&BackendStep,
+};
+
+} // end anon namespace
+
+Sycl *AccelSycl_Create(AccelSycl_DevicePreference preference) {
+	using namespace cl::sycl;
+
+	auto const selectStart = std::chrono::steady_clock::now();
+	device dev = SelectDevice(preference);
+	double const selectMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - selectStart).count();
+	LOGINFO("-----\nSelected device %s %s has %d CUs @ %dMhz with %dKB local memory",
+					dev.get_info<info::device::vendor>().c_str(),
+					dev.get_info<info::device::name>().c_str(),
+					dev.get_info<info::device::max_compute_units>(),
+					dev.get_info<info::device::max_clock_frequency>(),
+
+					(int) dev.get_info<info::device::local_mem_size>() / 1024);
+
+	auto const testStart = std::chrono::steady_clock::now();
+	auto sycl = new Sycl{dev};
+
+	if (!SelfTest(sycl)) {
 		LOGINFO("Sycl self test Failed");
 		AccelSycl_Destroy(sycl);
 		return nullptr;
 	}
+	LOGINFO("Sycl device selection %.1f ms, queue and self test %.1f ms", selectMs,
+					std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - testStart).count());
 
 	return sycl;
 }
 
 void AccelSycl_Destroy(Sycl *sycl) {
 	delete sycl;
-}
\ No newline at end of file
+}
+
+Accel_Backend const *AccelSycl_Backend() {
+	return &SyclBackend;
+}
+
+SyclWorld *AccelSycl_WorldCreate(Sycl *sycl, World2D *world) {
+	using namespace cl::sycl;
+	ASSERT(sycl);
+	ASSERT(world);
+
+	if (world->type != WT_MOE) {
+		LOGERROR("Sycl world step only supports WT_MOE worlds");
+		return nullptr;
+	}
+
+	SyclWorld *sworld = nullptr;
+	try {
+		sworld = new SyclWorld(sycl, world);
+		sworld->consumer = WORLD2D_INVALID_DIRTY_CONSUMER;
+
+		// 16x16 groups where the device allows, the host device always does
+		size_t const maxGroup = sycl->device.get_info<info::device::max_work_group_size>();
+		sworld->groupSize = (maxGroup >= 256) ? 16 : 8;
+
+		range<2> const planeRange(world->height, world->width);
+		for (uint32_t i = 0; i < world->channelCount; ++i) {
+			World2DChannel const &channel = world->channels[i];
+			if (!channel.doubleBuffered) continue;
+			if (channel.elementSize != sizeof(int16_t) || channel.layout != WL_ROW_MAJOR) {
+				LOGERROR("Sycl world step only supports row major 16 bit channels (%s)", channel.name);
+				AccelSycl_WorldDestroy(sworld);
+				return nullptr;
+			}
+			sworld->channels.push_back(SyclChannel{i, buffer<int16_t, 2>(planeRange), buffer<int16_t, 2>(planeRange)});
+		}
+
+		// new consumers start all dirty, so the first step uploads everything
+		sworld->consumer = World2D_DirtyConsumerRegister(world);
+		if (sworld->consumer == WORLD2D_INVALID_DIRTY_CONSUMER) {
+			AccelSycl_WorldDestroy(sworld);
+			return nullptr;
+		}
+	} catch (cl::sycl::exception const &e) {
+		LOGERROR("Sycl world create failed %s", e.what());
+		AccelSycl_WorldDestroy(sworld);
+		return nullptr;
+	}
+	return sworld;
+}
+
+void AccelSycl_WorldDestroy(SyclWorld *sworld) {
+	if (!sworld) return;
+	if (sworld->consumer != WORLD2D_INVALID_DIRTY_CONSUMER) {
+		World2D_DirtyConsumerUnregister(sworld->world, sworld->consumer);
+	}
+	delete sworld;
+}
+
+bool AccelSycl_WorldUploadRect(SyclWorld *sworld, uint32_t worldChannel, World2D_Rect const &rect) {
+	using namespace cl::sycl;
+	ASSERT(sworld);
+	SyclChannel *channel = FindChannel(sworld, worldChannel);
+	World2D_Rect r;
+	if (!channel || !ClipRect(sworld->world, rect, r)) return true;
+
+	// host rows are pitched, the device copy wants them packed
+	auto const view = World2D_ElementsAs<int16_t>(sworld->world, worldChannel);
+	sworld->staging.resize((size_t) r.width * r.height);
+	for (uint32_t y = 0; y < r.height; ++y) {
+		memcpy(&sworld->staging[(size_t) y * r.width], view.row(r.y + y) + r.x, r.width * sizeof(int16_t));
+	}
+
+	try {
+		int16_t const *src = sworld->staging.data();
+		sworld->sycl->queue.submit([&](handler &cgh) {
+			auto dst = channel->front.get_access<access::mode::write>(cgh, range<2>(r.height, r.width), id<2>(r.y, r.x));
+			cgh.copy(src, dst);
+		});
+		// staging is reused straight away
+		sworld->sycl->queue.wait_and_throw();
+	} catch (cl::sycl::exception const &e) {
+		LOGERROR("Sycl upload failed %s", e.what());
+		return false;
+	}
+	return true;
+}
+
+bool AccelSycl_WorldDownloadRect(SyclWorld *sworld, uint32_t worldChannel, World2D_Rect const &rect) {
+	using namespace cl::sycl;
+	ASSERT(sworld);
+	SyclChannel *channel = FindChannel(sworld, worldChannel);
+	World2D_Rect r;
+	if (!channel || !ClipRect(sworld->world, rect, r)) return true;
+
+	sworld->staging.resize((size_t) r.width * r.height);
+	try {
+		int16_t *dst = sworld->staging.data();
+		sworld->sycl->queue.submit([&](handler &cgh) {
+			auto src = channel->front.get_access<access::mode::read>(cgh, range<2>(r.height, r.width), id<2>(r.y, r.x));
+			cgh.copy(src, dst);
+		});
+		sworld->sycl->queue.wait_and_throw();
+	} catch (cl::sycl::exception const &e) {
+		LOGERROR("Sycl download failed %s", e.what());
+		return false;
+	}
+
+	auto view = World2D_MutableElementsAs<int16_t>(sworld->world, worldChannel);
+	for (uint32_t y = 0; y < r.height; ++y) {
+		memcpy(view.row(r.y + y) + r.x, &sworld->staging[(size_t) y * r.width], r.width * sizeof(int16_t));
+	}
+	return true;
+}
+
+bool AccelSycl_WorldRunStep(SyclWorld *sworld, World2D_StepParams const *params) {
+	using namespace cl::sycl;
+	ASSERT(sworld);
+	ASSERT(params);
+
+	try {
+		sworld->sycl->queue.submit([&](handler &cgh) {
+			auto changed = sworld->changed.get_access<access::mode::discard_write>(cgh);
+			cgh.fill(changed, 0u);
+		});
+		for (SyclChannel &channel : sworld->channels) {
+			EnqueueChannelStep(sworld, channel, ChannelStepFor(sworld->world, channel.worldChannel, params, sworld->tick));
+			// buffer dependencies order later work after the kernel, so the swap is safe now
+			std::swap(channel.front, channel.back);
+		}
+	} catch (cl::sycl::exception const &e) {
+		LOGERROR("Sycl step failed %s", e.what());
+		return false;
+	}
+	sworld->tick++;
+	return true;
+}
+
+bool AccelSycl_WorldFence(SyclWorld *sworld) {
+	ASSERT(sworld);
+	try {
+		sworld->sycl->queue.wait_and_throw();
+	} catch (cl::sycl::exception const &e) {
+		LOGERROR("Sycl fence failed %s", e.what());
+		return false;
+	}
+	return true;
+}
+
+bool AccelSycl_WorldStep(SyclWorld *sworld, World2D_StepParams const *params) {
+	using namespace cl::sycl;
+	ASSERT(sworld);
+	World2D *world = sworld->world;
+
+	// host writes since the last step
+	if (World2D_IsAnyDirty(world, sworld->consumer)) {
+		World2D_Rect rects[64];
+		uint32_t const rectCount = World2D_GetDirtyRects(world, sworld->consumer, rects, 64);
+		for (uint32_t i = 0; i < rectCount; ++i) {
+			for (SyclChannel const &channel : sworld->channels) {
+				if (!AccelSycl_WorldUploadRect(sworld, channel.worldChannel, rects[i])) return false;
+			}
+		}
+		World2D_ClearDirty(world, sworld->consumer);
+	}
+
+	sworld->tick = world->tick;
+	if (!AccelSycl_WorldRunStep(sworld, params)) return false;
+	if (!AccelSycl_WorldFence(sworld)) return false;
+
+	// only bring back runs of tiles the step changed
+	std::vector<uint32_t> changed(world->dirtyTilesX * world->dirtyTilesY);
+	try {
+		auto flags = sworld->changed.get_access<access::mode::read>();
+		for (size_t i = 0; i < changed.size(); ++i) changed[i] = flags[i];
+	} catch (cl::sycl::exception const &e) {
+		LOGERROR("Sycl changed tile read failed %s", e.what());
+		return false;
+	}
+
+	for (uint32_t ty = 0; ty < world->dirtyTilesY; ++ty) {
+		uint32_t tx = 0;
+		while (tx < world->dirtyTilesX) {
+			if (!changed[ty * world->dirtyTilesX + tx]) {
+				++tx;
+				continue;
+			}
+			uint32_t const runStart = tx;
+			while (tx < world->dirtyTilesX && changed[ty * world->dirtyTilesX + tx]) ++tx;
+
+			World2D_Rect const rect{
+					runStart << WORLD2D_DIRTY_TILE_SHIFT,
+					ty << WORLD2D_DIRTY_TILE_SHIFT,
+					(tx - runStart) << WORLD2D_DIRTY_TILE_SHIFT,
+					WORLD2D_DIRTY_TILE_SIZE};
+			for (SyclChannel const &channel : sworld->channels) {
+				if (!AccelSycl_WorldDownloadRect(sworld, channel.worldChannel, rect)) return false;
+			}
+			World2D_MarkDirtyRect(world, rect.x, rect.y, rect.width, rect.height);
+			// the device already has these, don't send them straight back
+			for (uint32_t x = runStart; x < tx; ++x) {
+				World2D_ClearDirtyTile(world, sworld->consumer, x, ty);
+			}
+		}
+	}
+
+	world->tick++;
+	return true;
+}
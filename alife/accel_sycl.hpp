@@ -5,7 +5,40 @@
 // License Summary: MIT see LICENSE file
 #pragma once
 
+#include "world2d.hpp"
+#include "world2d_step.hpp"
+
 struct Sycl;
+struct SyclWorld;
+
+enum AccelSycl_DevicePreference {
+	ASDP_FASTEST,		// any device, picked on measured bandwidth and compute
+	ASDP_CPU,				// the fastest OpenCL CPU device
+	ASDP_HOST,			// the SYCL host device, always available
+};
+
+// candidate devices are benchmarked (or looked up in the device cache, see
+// accel_devicecache.hpp), falls back to the host device if nothing matching
+// the preference is found
+Sycl* AccelSycl_Create(AccelSycl_DevicePreference preference = ASDP_FASTEST);
+void AccelSycl_Destroy(Sycl* sycl);
+
+// Keeps the stepped channels of world resident on the device in long lived
+// buffers. world must outlive the SyclWorld, it registers a dirty consumer so
+// host side writes (agents eating etc.) are uploaded before the next step.
+SyclWorld* AccelSycl_WorldCreate(Sycl* sycl, World2D* world);
+void AccelSycl_WorldDestroy(SyclWorld* sworld);
+
+// copies a rect of a channels front plane host -> device or device -> host,
+// channels that don't live on the device are ignored
+bool AccelSycl_WorldUploadRect(SyclWorld* sworld, uint32_t channel, World2D_Rect const& rect);
+bool AccelSycl_WorldDownloadRect(SyclWorld* sworld, uint32_t channel, World2D_Rect const& rect);
+
+// enqueues the step kernels, device front and back swap once they are queued
+bool AccelSycl_WorldRunStep(SyclWorld* sworld, World2D_StepParams const* params);
+// waits for all queued device work
+bool AccelSycl_WorldFence(SyclWorld* sworld);
 
-Sycl* AccelSycl_Create();
-void AccelSycl_Destroy(Sycl* sycl);
\ No newline at end of file
+// a whole tick: uploads host dirty tiles, steps on the device and downloads
+// only the tiles the step changed, which are marked dirty on the host world
+bool AccelSycl_WorldStep(SyclWorld* sworld, World2D_StepParams const* params);
@@ -0,0 +1,552 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "agents.hpp"
+#include "world2d_rng.hpp"
+#include "world2d_schema.hpp"
+#include <math.h>
+
+// agents per update task range entry
+#define AGENTS_UPDATE_BLOCK_SIZE 4096
+// the hash sort splits the agents into up to one block per worker, every block
+// clears and scans a counter per cell so each needs this many agents per cell
+// to be worth it. A stable sort has only one answer so the result doesn't
+// depend on how many blocks there are
+#define AGENTS_HASH_MAX_BLOCKS 64
+#define AGENTS_HASH_MIN_BLOCK_AGENTS 4096
+#define AGENTS_HASH_CELL_RANGES 64
+
+namespace {
+
+template<typename T> bool GrowArray(T *&array, uint32_t oldCount, uint32_t newCapacity) {
+	T *newArray = (T *) MEMORY_AALLOC(sizeof(T) * newCapacity, WORLD2D_CACHE_LINE_SIZE);
+	if (!newArray) return false;
+	if (array) {
+		memcpy(newArray, array, sizeof(T) * oldCount);
+		MEMORY_FREE(array);
+	}
+	array = newArray;
+	return true;
+}
+
+template<typename T> void FreeArray(T *&array) {
+	if (array) MEMORY_FREE(array);
+	array = nullptr;
+}
+
+bool Reserve(Agents *agents, uint32_t capacity) {
+	if (capacity <= agents->capacity) return true;
+	if (!GrowArray(agents->posX, agents->count, capacity)) return false;
+	if (!GrowArray(agents->posY, agents->count, capacity)) return false;
+	if (!GrowArray(agents->energy, agents->count, capacity)) return false;
+	if (!GrowArray(agents->genome, agents->count, capacity)) return false;
+	if (!GrowArray(agents->id, agents->count, capacity)) return false;
+	agents->capacity = capacity;
+	return true;
+}
+
+// runs func over [0, count) ranges on the scheduler, or inline without one
+void ParallelFor(enkiTaskSchedulerHandle scheduler, enkiTaskExecuteRange func, void *args, uint32_t count) {
+	if (count == 0) return;
+	if (!scheduler || count == 1) {
+		func(0, count, 0, args);
+		return;
+	}
+	enkiTaskSetHandle taskSet = enkiCreateTaskSet(scheduler, func);
+	enkiAddTaskSetToPipeMinRange(scheduler, taskSet, args, count, 1);
+	enkiWaitForTaskSet(scheduler, taskSet);
+	enkiDeleteTaskSet(taskSet);
+}
+
+uint32_t HashCellOf(Agents_SpatialHash const *hash, float x, float y) {
+	uint32_t cx = (x > 0.0f) ? ((uint32_t) x >> hash->cellShift) : 0;
+	uint32_t cy = (y > 0.0f) ? ((uint32_t) y >> hash->cellShift) : 0;
+	cx = (cx < hash->gridWidth) ? cx : hash->gridWidth - 1;
+	cy = (cy < hash->gridHeight) ? cy : hash->gridHeight - 1;
+	return cy * hash->gridWidth + cx;
+}
+
+// 16 unit directions for wandering, avoids a sin/cos per agent
+float const WanderX[16] = {
+		1.0f, 0.9238795f, 0.7071068f, 0.3826834f, 0.0f, -0.3826834f, -0.7071068f, -0.9238795f,
+		-1.0f, -0.9238795f, -0.7071068f, -0.3826834f, 0.0f, 0.3826834f, 0.7071068f, 0.9238795f,
+};
+float const WanderY[16] = {
+		0.0f, 0.3826834f, 0.7071068f, 0.9238795f, 1.0f, 0.9238795f, 0.7071068f, 0.3826834f,
+		0.0f, -0.3826834f, -0.7071068f, -0.9238795f, -1.0f, -0.9238795f, -0.7071068f, -0.3826834f,
+};
+
+struct MoveArgs {
+	Agents *agents;
+	World2D const *world;
+	Agents_UpdateParams const *params;
+};
+
+void MoveTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	MoveArgs const *args = (MoveArgs const *) pArgs;
+	Agents *agents = args->agents;
+	World2D const *world = args->world;
+	auto const food = World2D_Elements<WT_MOE, WMC_FOOD>(world);
+	float const maxX = (float) world->width - 0.001f;
+	float const maxY = (float) world->height - 0.001f;
+	uint32_t const lastX = world->width - 1;
+	uint32_t const lastY = world->height - 1;
+
+	uint32_t const first = start * AGENTS_UPDATE_BLOCK_SIZE;
+	uint32_t const last = (end * AGENTS_UPDATE_BLOCK_SIZE < agents->count) ? end * AGENTS_UPDATE_BLOCK_SIZE : agents->count;
+
+	for (uint32_t i = first; i < last; ++i) {
+		uint32_t const x = (uint32_t) agents->posX[i];
+		uint32_t const y = (uint32_t) agents->posY[i];
+
+		// sense the food gradient
+		float dx = (float) food.at((x < lastX) ? x + 1 : x, y) - (float) food.at((x > 0) ? x - 1 : x, y);
+		float dy = (float) food.at(x, (y < lastY) ? y + 1 : y) - (float) food.at(x, (y > 0) ? y - 1 : y);
+		float const len = sqrtf(dx * dx + dy * dy);
+		if (len > 0.0f) {
+			dx /= len;
+			dy /= len;
+		} else {
+			// nothing to smell, wander in a direction fixed by seed, id and tick
+			uint32_t const h = World2D_Random(args->params->seed, world->tick, WORLD2D_RNG_STREAM_AGENT_WANDER, agents->id[i]);
+			dx = WanderX[h & 15];
+			dy = WanderY[h & 15];
+		}
+
+		float nx = agents->posX[i] + dx * args->params->speed;
+		float ny = agents->posY[i] + dy * args->params->speed;
+		agents->posX[i] = (nx < 0.0f) ? 0.0f : ((nx > maxX) ? maxX : nx);
+		agents->posY[i] = (ny < 0.0f) ? 0.0f : ((ny > maxY) ? maxY : ny);
+		agents->energy[i] -= args->params->metabolism;
+	}
+}
+
+struct HashArgs {
+	Agents_SpatialHash *hash;
+	Agents const *agents;
+	uint32_t rangeTotals[AGENTS_HASH_CELL_RANGES];
+	uint32_t rangeBase[AGENTS_HASH_CELL_RANGES];
+};
+
+void BlockRange(uint32_t count, uint32_t block, uint32_t blockCount, uint32_t &first, uint32_t &last) {
+	first = (uint32_t) (((uint64_t) count * block) / blockCount);
+	last = (uint32_t) (((uint64_t) count * (block + 1)) / blockCount);
+}
+
+// phase 1, each block histograms its agents
+void HashCountTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	HashArgs *args = (HashArgs *) pArgs;
+	Agents_SpatialHash *hash = args->hash;
+	Agents const *agents = args->agents;
+	uint32_t const cellCount = hash->gridWidth * hash->gridHeight;
+
+	for (uint32_t b = start; b < end; ++b) {
+		uint32_t *counts = hash->blockCounts + (size_t) b * cellCount;
+		memset(counts, 0, cellCount * sizeof(uint32_t));
+
+		uint32_t first, last;
+		BlockRange(agents->count, b, hash->blockCount, first, last);
+		for (uint32_t i = first; i < last; ++i) {
+			uint32_t const cell = HashCellOf(hash, agents->posX[i], agents->posY[i]);
+			hash->agentCell[i] = cell;
+			counts[cell]++;
+		}
+	}
+}
+
+// phase 2a, totals per cell and per range of cells
+void HashTotalTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	HashArgs *args = (HashArgs *) pArgs;
+	Agents_SpatialHash *hash = args->hash;
+	uint32_t const cellCount = hash->gridWidth * hash->gridHeight;
+
+	for (uint32_t r = start; r < end; ++r) {
+		uint32_t first, last;
+		BlockRange(cellCount, r, AGENTS_HASH_CELL_RANGES, first, last);
+		uint32_t rangeTotal = 0;
+		for (uint32_t c = first; c < last; ++c) {
+			uint32_t total = 0;
+			for (uint32_t b = 0; b < hash->blockCount; ++b) {
+				total += hash->blockCounts[(size_t) b * cellCount + c];
+			}
+			hash->cellStart[c] = total;
+			rangeTotal += total;
+		}
+		args->rangeTotals[r] = rangeTotal;
+	}
+}
+
+// phase 2b, turns cell totals into cell starts and block counts into block write cursors
+void HashOffsetTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	HashArgs *args = (HashArgs *) pArgs;
+	Agents_SpatialHash *hash = args->hash;
+	uint32_t const cellCount = hash->gridWidth * hash->gridHeight;
+
+	for (uint32_t r = start; r < end; ++r) {
+		uint32_t first, last;
+		BlockRange(cellCount, r, AGENTS_HASH_CELL_RANGES, first, last);
+		uint32_t running = args->rangeBase[r];
+		for (uint32_t c = first; c < last; ++c) {
+			uint32_t const total = hash->cellStart[c];
+			hash->cellStart[c] = running;
+			uint32_t cursor = running;
+			for (uint32_t b = 0; b < hash->blockCount; ++b) {
+				uint32_t &count = hash->blockCounts[(size_t) b * cellCount + c];
+				uint32_t const blockCount = count;
+				count = cursor;
+				cursor += blockCount;
+			}
+			running += total;
+		}
+	}
+}
+
+// phase 3, each block scatters its agents, blocks are in agent order so the sort is stable
+void HashScatterTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	HashArgs *args = (HashArgs *) pArgs;
+	Agents_SpatialHash *hash = args->hash;
+	Agents const *agents = args->agents;
+	uint32_t const cellCount = hash->gridWidth * hash->gridHeight;
+
+	for (uint32_t b = start; b < end; ++b) {
+		uint32_t *cursors = hash->blockCounts + (size_t) b * cellCount;
+		uint32_t first, last;
+		BlockRange(agents->count, b, hash->blockCount, first, last);
+		for (uint32_t i = first; i < last; ++i) {
+			uint32_t const dst = cursors[hash->agentCell[i]]++;
+			hash->sortedIndex[dst] = i;
+			hash->sortedX[dst] = agents->posX[i];
+			hash->sortedY[dst] = agents->posY[i];
+		}
+	}
+}
+
+// k is expected to be small, keeps the results sorted by insertion
+void InsertNearest(uint32_t k, uint32_t &found, uint32_t *results, float *distances, uint32_t index, float d2) {
+	if (found == k && d2 >= distances[k - 1]) return;
+	uint32_t pos = (found < k) ? found++ : k - 1;
+	while (pos > 0 && distances[pos - 1] > d2) {
+		distances[pos] = distances[pos - 1];
+		results[pos] = results[pos - 1];
+		--pos;
+	}
+	distances[pos] = d2;
+	results[pos] = index;
+}
+
+void ScanCellNearest(Agents_SpatialHash const *hash, uint32_t cell, float x, float y,
+										 uint32_t k, uint32_t &found, uint32_t *results, float *distances) {
+	for (uint32_t s = hash->cellStart[cell]; s < hash->cellStart[cell + 1]; ++s) {
+		float const dx = hash->sortedX[s] - x;
+		float const dy = hash->sortedY[s] - y;
+		InsertNearest(k, found, results, distances, hash->sortedIndex[s], dx * dx + dy * dy);
+	}
+}
+
+} // end anon namespace
+
+Agents *Agents_Create(uint32_t initialCapacity) {
+	Agents *agents = (Agents *) MEMORY_CALLOC(1, sizeof(Agents));
+	if (!agents) return nullptr;
+
+	if (!Reserve(agents, initialCapacity ? initialCapacity : 1024)) {
+		Agents_Destroy(agents);
+		return nullptr;
+	}
+	return agents;
+}
+
+void Agents_Destroy(Agents *agents) {
+	if (!agents) return;
+	FreeArray(agents->posX);
+	FreeArray(agents->posY);
+	FreeArray(agents->energy);
+	FreeArray(agents->genome);
+	FreeArray(agents->id);
+	MEMORY_FREE(agents);
+}
+
+uint32_t Agents_Add(Agents *agents, float x, float y, float energy, uint32_t genome) {
+	ASSERT(agents);
+	if (agents->count == agents->capacity) {
+		if (!Reserve(agents, agents->capacity * 2)) return UINT32_MAX;
+	}
+	uint32_t const index = agents->count++;
+	agents->posX[index] = x;
+	agents->posY[index] = y;
+	agents->energy[index] = energy;
+	agents->genome[index] = genome;
+	agents->id[index] = agents->nextId++;
+	return index;
+}
+
+void Agents_Remove(Agents *agents, uint32_t index) {
+	ASSERT(agents);
+	ASSERT(index < agents->count);
+	uint32_t const last = --agents->count;
+	if (index == last) return;
+
+	agents->posX[index] = agents->posX[last];
+	agents->posY[index] = agents->posY[last];
+	agents->energy[index] = agents->energy[last];
+	agents->genome[index] = agents->genome[last];
+	agents->id[index] = agents->id[last];
+}
+
+uint32_t Agents_RemoveDead(Agents *agents) {
+	ASSERT(agents);
+	uint32_t removed = 0;
+	uint32_t i = 0;
+	while (i < agents->count) {
+		if (agents->energy[i] <= 0.0f) {
+			// the swapped in agent gets checked on the next pass around
+			Agents_Remove(agents, i);
+			removed++;
+		} else {
+			++i;
+		}
+	}
+	return removed;
+}
+
+void Agents_UpdateParamsDefaults(Agents_UpdateParams *params) {
+	ASSERT(params);
+	params->speed = 0.25f;
+	params->metabolism = 0.5f;
+	params->bite = 16;
+	params->seed = 0xA6E175u;
+	params->foodToEnergy = 0.1f;
+}
+
+void Agents_Update(Agents *agents, World2D *world, enkiTaskSchedulerHandle scheduler, Agents_UpdateParams const *params) {
+	ASSERT(agents);
+	ASSERT(world);
+	ASSERT(params);
+
+	MoveArgs moveArgs{agents, world, params};
+	uint32_t const blocks = (agents->count + AGENTS_UPDATE_BLOCK_SIZE - 1) / AGENTS_UPDATE_BLOCK_SIZE;
+	ParallelFor(scheduler, &MoveTaskFunc, &moveArgs, blocks);
+
+	// eating writes the world so runs in agent order, which keeps who gets to
+	// a contested cell first deterministic
+	auto food = World2D_MutableElements<WT_MOE, WMC_FOOD>(world);
+	for (uint32_t i = 0; i < agents->count; ++i) {
+		uint32_t const x = (uint32_t) agents->posX[i];
+		uint32_t const y = (uint32_t) agents->posY[i];
+		int16_t &cell = food.at(x, y);
+		int16_t const eaten = (cell < params->bite) ? cell : params->bite;
+		if (eaten <= 0) continue;
+
+		cell = (int16_t) (cell - eaten);
+		agents->energy[i] += (float) eaten * params->foodToEnergy;
+		World2D_MarkDirtyTile(world, x >> WORLD2D_DIRTY_TILE_SHIFT, y >> WORLD2D_DIRTY_TILE_SHIFT);
+	}
+
+	Agents_RemoveDead(agents);
+}
+
+bool Agents_SortByHash(Agents *agents, Agents_SpatialHash *hash) {
+	ASSERT(agents);
+	ASSERT(hash);
+	ASSERT(hash->count == agents->count);
+
+	Agents sorted{};
+	if (!Reserve(&sorted, agents->capacity)) {
+		FreeArray(sorted.posX);
+		FreeArray(sorted.posY);
+		FreeArray(sorted.energy);
+		FreeArray(sorted.genome);
+		FreeArray(sorted.id);
+		return false;
+	}
+
+	for (uint32_t s = 0; s < hash->count; ++s) {
+		uint32_t const i = hash->sortedIndex[s];
+		sorted.posX[s] = hash->sortedX[s];
+		sorted.posY[s] = hash->sortedY[s];
+		sorted.energy[s] = agents->energy[i];
+		sorted.genome[s] = agents->genome[i];
+		sorted.id[s] = agents->id[i];
+		hash->sortedIndex[s] = s;
+	}
+	// agents are in cell order now, so each cell's run is its agents
+	uint32_t const cellCount = hash->gridWidth * hash->gridHeight;
+	for (uint32_t c = 0; c < cellCount; ++c) {
+		for (uint32_t s = hash->cellStart[c]; s < hash->cellStart[c + 1]; ++s) {
+			hash->agentCell[s] = c;
+		}
+	}
+
+	FreeArray(agents->posX);
+	FreeArray(agents->posY);
+	FreeArray(agents->energy);
+	FreeArray(agents->genome);
+	FreeArray(agents->id);
+	agents->posX = sorted.posX;
+	agents->posY = sorted.posY;
+	agents->energy = sorted.energy;
+	agents->genome = sorted.genome;
+	agents->id = sorted.id;
+	return true;
+}
+
+bool Agents_SpatialHashCreate(Agents_SpatialHash *hash, World2D const *world, uint32_t cellShift) {
+	ASSERT(hash);
+	ASSERT(world);
+	memset(hash, 0, sizeof(Agents_SpatialHash));
+
+	hash->cellShift = cellShift;
+	hash->gridWidth = (world->width + (1u << cellShift) - 1) >> cellShift;
+	hash->gridHeight = (world->height + (1u << cellShift) - 1) >> cellShift;
+	hash->worldWidth = (float) world->width;
+	hash->worldHeight = (float) world->height;
+
+	// starts with one block, rebuild grows it when there are agents enough for more
+	size_t const cellCount = (size_t) hash->gridWidth * hash->gridHeight;
+	hash->cellStart = (uint32_t *) MEMORY_CALLOC(cellCount + 1, sizeof(uint32_t));
+	hash->blockCounts = (uint32_t *) MEMORY_CALLOC(cellCount, sizeof(uint32_t));
+	hash->blockCapacity = 1;
+	hash->blockCount = 1;
+	if (!hash->cellStart || !hash->blockCounts) {
+		Agents_SpatialHashDestroy(hash);
+		return false;
+	}
+	return true;
+}
+
+void Agents_SpatialHashDestroy(Agents_SpatialHash *hash) {
+	if (!hash) return;
+	FreeArray(hash->cellStart);
+	FreeArray(hash->blockCounts);
+	FreeArray(hash->agentCell);
+	FreeArray(hash->sortedIndex);
+	FreeArray(hash->sortedX);
+	FreeArray(hash->sortedY);
+	hash->capacity = 0;
+	hash->count = 0;
+	hash->blockCapacity = 0;
+	hash->blockCount = 0;
+}
+
+void Agents_SpatialHashRebuild(Agents_SpatialHash *hash, Agents const *agents, enkiTaskSchedulerHandle scheduler) {
+	ASSERT(hash);
+	ASSERT(agents);
+
+	if (agents->count > hash->capacity) {
+		uint32_t const capacity = agents->capacity;
+		FreeArray(hash->agentCell);
+		FreeArray(hash->sortedIndex);
+		FreeArray(hash->sortedX);
+		FreeArray(hash->sortedY);
+		hash->capacity = 0;
+		if (!GrowArray(hash->agentCell, 0, capacity) ||
+				!GrowArray(hash->sortedIndex, 0, capacity) ||
+				!GrowArray(hash->sortedX, 0, capacity) ||
+				!GrowArray(hash->sortedY, 0, capacity)) {
+			LOGERROR("Agents spatial hash out of memory for %u agents", capacity);
+			hash->count = 0;
+			memset(hash->cellStart, 0, ((size_t) hash->gridWidth * hash->gridHeight + 1) * sizeof(uint32_t));
+			return;
+		}
+		hash->capacity = capacity;
+	}
+	hash->count = agents->count;
+
+	// one block unless there are workers to share it and agents enough per
+	// cell to pay for the extra counters
+	uint32_t const cellCount = hash->gridWidth * hash->gridHeight;
+	uint32_t const workers = scheduler ? enkiGetNumTaskThreads(scheduler) : 1;
+	uint32_t const perCell = agents->count / cellCount;
+	uint32_t const bySize = agents->count / AGENTS_HASH_MIN_BLOCK_AGENTS;
+	uint32_t blockCount = (workers < perCell) ? workers : perCell;
+	blockCount = (blockCount < bySize) ? blockCount : bySize;
+	blockCount = (blockCount < AGENTS_HASH_MAX_BLOCKS) ? blockCount : AGENTS_HASH_MAX_BLOCKS;
+	blockCount = (blockCount > 1) ? blockCount : 1;
+	if (blockCount > hash->blockCapacity) {
+		uint32_t *blockCounts = (uint32_t *) MEMORY_MALLOC((size_t) cellCount * blockCount * sizeof(uint32_t));
+		if (blockCounts) {
+			MEMORY_FREE(hash->blockCounts);
+			hash->blockCounts = blockCounts;
+			hash->blockCapacity = blockCount;
+		} else {
+			// still correct with the blocks we have, just less parallel
+			blockCount = hash->blockCapacity;
+		}
+	}
+	hash->blockCount = blockCount;
+
+	HashArgs args{};
+	args.hash = hash;
+	args.agents = agents;
+
+	ParallelFor(scheduler, &HashCountTaskFunc, &args, hash->blockCount);
+	ParallelFor(scheduler, &HashTotalTaskFunc, &args, AGENTS_HASH_CELL_RANGES);
+	uint32_t running = 0;
+	for (uint32_t r = 0; r < AGENTS_HASH_CELL_RANGES; ++r) {
+		args.rangeBase[r] = running;
+		running += args.rangeTotals[r];
+	}
+	ParallelFor(scheduler, &HashOffsetTaskFunc, &args, AGENTS_HASH_CELL_RANGES);
+	hash->cellStart[hash->gridWidth * hash->gridHeight] = agents->count;
+	ParallelFor(scheduler, &HashScatterTaskFunc, &args, hash->blockCount);
+}
+
+uint32_t Agents_QueryRadius(Agents_SpatialHash const *hash, float x, float y, float radius, uint32_t *results, uint32_t maxResults) {
+	ASSERT(hash);
+	if (hash->count == 0) return 0;
+
+	uint32_t const c0 = HashCellOf(hash, x - radius, y - radius);
+	uint32_t const c1 = HashCellOf(hash, x + radius, y + radius);
+	uint32_t const cx0 = c0 % hash->gridWidth, cy0 = c0 / hash->gridWidth;
+	uint32_t const cx1 = c1 % hash->gridWidth, cy1 = c1 / hash->gridWidth;
+	float const r2 = radius * radius;
+
+	uint32_t found = 0;
+	for (uint32_t cy = cy0; cy <= cy1; ++cy) {
+		// a row of cells is one contiguous run in the sorted arrays
+		uint32_t const begin = hash->cellStart[cy * hash->gridWidth + cx0];
+		uint32_t const end = hash->cellStart[cy * hash->gridWidth + cx1 + 1];
+		for (uint32_t s = begin; s < end; ++s) {
+			float const dx = hash->sortedX[s] - x;
+			float const dy = hash->sortedY[s] - y;
+			if (dx * dx + dy * dy <= r2) {
+				if (found < maxResults) results[found] = hash->sortedIndex[s];
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
+uint32_t Agents_QueryKNearest(Agents_SpatialHash const *hash, float x, float y, uint32_t k, uint32_t *results, float *distancesSquared) {
+	ASSERT(hash);
+	if (k == 0 || hash->count == 0) return 0;
+
+	uint32_t const home = HashCellOf(hash, x, y);
+	int32_t const hx = (int32_t) (home % hash->gridWidth);
+	int32_t const hy = (int32_t) (home / hash->gridWidth);
+	int32_t const gw = (int32_t) hash->gridWidth;
+	int32_t const gh = (int32_t) hash->gridHeight;
+	int32_t const maxRing = (gw > gh) ? gw : gh;
+	float const cellSize = (float) (1u << hash->cellShift);
+
+	uint32_t found = 0;
+	for (int32_t ring = 0; ring <= maxRing; ++ring) {
+		for (int32_t cy = hy - ring; cy <= hy + ring; ++cy) {
+			if (cy < 0 || cy >= gh) continue;
+			bool const edgeRow = (cy == hy - ring) || (cy == hy + ring);
+			// middle rows only have the two cells on the ring edge
+			int32_t const step = edgeRow ? 1 : ((ring > 0) ? 2 * ring : 1);
+			for (int32_t cx = hx - ring; cx <= hx + ring; cx += step) {
+				if (cx < 0 || cx >= gw) continue;
+				ScanCellNearest(hash, (uint32_t) (cy * gw + cx), x, y, k, found, results, distancesSquared);
+			}
+		}
+
+		// anything not yet scanned is at least ring cells away
+		float const bound = (float) ring * cellSize;
+		if (found == k && distancesSquared[k - 1] <= bound * bound) break;
+	}
+	return found;
+}
@@ -0,0 +1,90 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_enki/TaskScheduler_c.h"
+#include "world2d.hpp"
+
+// Mobile creatures that live on a World2D. Agents are stored structure of
+// arrays so each pass only touches the fields it needs, removal swaps the
+// last agent into the hole so the arrays stay dense. Agent indices are only
+// stable until the next add/remove, ids are stable for the agents lifetime.
+struct Agents {
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t nextId;
+
+	// positions are in world cells
+	float* posX;
+	float* posY;
+	float* energy;
+	uint32_t* genome;
+	uint32_t* id;
+};
+
+// uniform grid aligned to the world cell grid, each hash cell is
+// 2^cellShift x 2^cellShift world cells. Rebuilt every tick by a counting
+// sort, sorted positions are kept alongside the sorted indices so queries
+// stream through contiguous memory.
+struct Agents_SpatialHash {
+	uint32_t cellShift;
+	uint32_t gridWidth;
+	uint32_t gridHeight;
+	float worldWidth;
+	float worldHeight;
+
+	uint32_t* cellStart;		// gridWidth * gridHeight + 1 entries
+
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t* agentCell;		// per agent, in agent order (kept by Agents_SortByHash)
+	uint32_t* sortedIndex;	// agent indices in cell order
+	float* sortedX;
+	float* sortedY;
+
+	// per block histograms for the parallel sort, the block count is picked
+	// each rebuild from the agents per cell and the worker count
+	uint32_t blockCount;
+	uint32_t blockCapacity;
+	uint32_t* blockCounts;	// blockCapacity * gridWidth * gridHeight
+};
+
+struct Agents_UpdateParams {
+	float speed;					// cells per tick
+	float metabolism;			// energy lost per tick
+	int16_t bite;					// food eaten per tick
+	float foodToEnergy;		// energy gained per unit of food
+	uint64_t seed;				// keys the wander draws, see world2d_rng.hpp
+};
+
+Agents* Agents_Create(uint32_t initialCapacity);
+void Agents_Destroy(Agents* agents);
+
+// returns the new agents index or UINT32_MAX on failure
+uint32_t Agents_Add(Agents* agents, float x, float y, float energy, uint32_t genome);
+void Agents_Remove(Agents* agents, uint32_t index);
+// swap removes every agent with no energy left, returns how many were removed
+uint32_t Agents_RemoveDead(Agents* agents);
+
+void Agents_UpdateParamsDefaults(Agents_UpdateParams* params);
+
+// agents sense the food gradient and move in parallel, then eat in agent
+// order (marking the eaten tiles dirty) and the dead are removed
+void Agents_Update(Agents* agents, World2D* world, enkiTaskSchedulerHandle scheduler, Agents_UpdateParams const* params);
+
+bool Agents_SpatialHashCreate(Agents_SpatialHash* hash, World2D const* world, uint32_t cellShift);
+void Agents_SpatialHashDestroy(Agents_SpatialHash* hash);
+
+// stable parallel counting sort, results don't depend on the thread count
+void Agents_SpatialHashRebuild(Agents_SpatialHash* hash, Agents const* agents, enkiTaskSchedulerHandle scheduler);
+
+// reorders the agents into the hashes cell order so agents that are close in
+// the world are close in memory, the hash stays valid (its indices become the
+// identity). Worth doing every few ticks for large populations
+bool Agents_SortByHash(Agents* agents, Agents_SpatialHash* hash);
+
+// agent indices within radius of x,y, returns the total found (which may be more than maxResults)
+uint32_t Agents_QueryRadius(Agents_SpatialHash const* hash, float x, float y, float radius, uint32_t* results, uint32_t maxResults);
+
+// the k nearest agents to x,y sorted nearest first, returns how many were found (<= k)
+uint32_t Agents_QueryKNearest(Agents_SpatialHash const* hash, float x, float y, uint32_t k, uint32_t* results, float* distancesSquared);
@@ -0,0 +1,322 @@
+// License Summary: MIT see LICENSE file
+// Headless ALife world benchmark, steps a World2D without a renderer, window
+// or GPU and reports the simulation throughput.
+//
+// usage: hermit_alifebench [--width N] [--height N] [--steps N] [--threads N]
+//                          [--kernels best|scalar|sse2|avx2|avx512] [--agents N]
+//                          [--worlds N] [--sleep 0|1] [--sprout N]
+// threads 0 (the default) uses every core, agents N also updates N agents and
+// rebuilds their spatial hash every step. The step is deterministic so the
+// checksum printed at the end must not change with --threads or --kernels.
+// worlds N (> 1) steps an ensemble of N width x height worlds instead, as a
+// parameter sweep would. sleep 0 steps every tile, even settled ones. sprout N
+// turns food sprouting on with a chance of N/65536 per cell per tick
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "al2o3_enki/TaskScheduler_c.h"
+#include "utils_simple_logmanager/logmanager.h"
+
+#include "world2d.hpp"
+#include "world2d_step.hpp"
+#include "world2d_kernels.hpp"
+#include "world2d_ensemble.hpp"
+#include "agents.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct BenchOptions {
+	uint32_t width;
+	uint32_t height;
+	uint32_t steps;
+	uint32_t threads;
+	char const* kernels;
+	uint32_t agents;
+	uint32_t worlds;
+	bool sleep;
+	uint16_t sprout;
+};
+
+void *EnkiAlloc(void *userData, size_t size) {
+	return MEMORY_ALLOCATOR_MALLOC((Memory_Allocator *) userData, size);
+}
+void EnkiFree(void *userData, void *ptr) {
+	MEMORY_ALLOCATOR_FREE((Memory_Allocator *) userData, ptr);
+}
+
+void PrintUsage() {
+	printf("usage: hermit_alifebench [--width N] [--height N] [--steps N] [--threads N]\n"
+				 "                         [--kernels best|scalar|sse2|avx2|avx512] [--agents N]\n"
+				 "                         [--worlds N] [--sleep 0|1] [--sprout N]\n");
+}
+
+bool ParseOptions(int argc, char const *argv[], BenchOptions *options) {
+	options->width = 1024;
+	options->height = 1024;
+	options->steps = 100;
+	options->threads = 0;
+	options->kernels = "best";
+	options->agents = 0;
+	options->worlds = 1;
+	options->sleep = true;
+	options->sprout = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		char const *arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		char const *value = argv[++i];
+
+		if (strcmp(arg, "--width") == 0) {
+			options->width = (uint32_t) strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--height") == 0) {
+			options->height = (uint32_t) strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--steps") == 0) {
+			options->steps = (uint32_t) strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--threads") == 0) {
+			options->threads = (uint32_t) strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--kernels") == 0) {
+			options->kernels = value;
+		} else if (strcmp(arg, "--agents") == 0) {
+			options->agents = (uint32_t) strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--worlds") == 0) {
+			options->worlds = (uint32_t) strtoul(value, nullptr, 10);
+		} else if (strcmp(arg, "--sleep") == 0) {
+			options->sleep = strtoul(value, nullptr, 10) != 0;
+		} else if (strcmp(arg, "--sprout") == 0) {
+			options->sprout = (uint16_t) strtoul(value, nullptr, 10);
+		} else {
+			return false;
+		}
+	}
+	return options->width > 0 && options->height > 0 && options->steps > 0 && options->worlds > 0;
+}
+
+World2D_Kernels const *KernelsByName(char const *name) {
+	if (strcmp(name, "best") == 0) return World2D_KernelsBest();
+	if (strcmp(name, "scalar") == 0) return World2D_KernelsScalar();
+
+	World2D_Kernels const *kernels = nullptr;
+	if (strcmp(name, "sse2") == 0) kernels = World2D_KernelsSSE2();
+	else if (strcmp(name, "avx2") == 0) kernels = World2D_KernelsAVX2();
+	else if (strcmp(name, "avx512") == 0) kernels = World2D_KernelsAVX512();
+
+	if (!World2D_KernelsVerify(kernels)) return nullptr;
+	return kernels;
+}
+
+uint64_t PeakMemoryBytes() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return (uint64_t) pmc.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+	return (uint64_t) usage.ru_maxrss;
+#else
+	return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// deterministic noise so runs are comparable
+void SeedWorld(World2D *world) {
+	uint32_t state = 0x9E3779B9u;
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2DChannel const &channel = world->channels[c];
+		if (channel.elementSize != sizeof(int16_t)) continue;
+
+		auto view = World2D_MutableElementsAs<int16_t>(world, c);
+		for (uint32_t y = 0; y < world->height; ++y) {
+			for (uint32_t x = 0; x < world->width; ++x) {
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				view.at(x, y) = (int16_t) (state & 0xFFF);
+			}
+		}
+	}
+	World2D_MarkDirtyRect(world, 0, 0, world->width, world->height);
+}
+
+void SeedAgents(Agents *agents, World2D const *world, uint32_t count) {
+	uint32_t state = 0x2545F491u;
+	for (uint32_t i = 0; i < count; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		float const x = (float) (state % world->width);
+		float const y = (float) ((state >> 16) % world->height);
+		// enough energy that the population survives the whole run
+		Agents_Add(agents, x, y, 1e6f, state);
+	}
+}
+
+uint64_t ChecksumChannel(World2D const *world, uint32_t channel) {
+	auto const view = World2D_ElementsAs<int16_t>(world, channel);
+	uint64_t sum = 0;
+	for (uint32_t y = 0; y < world->height; ++y) {
+		for (uint32_t x = 0; x < world->width; ++x) {
+			sum = sum * 31 + (uint16_t) view.at(x, y);
+		}
+	}
+	return sum;
+}
+
+// steps an ensemble of small worlds, the sweep case, and reports the combined throughput
+int RunEnsemble(BenchOptions const &options, World2D_StepParams const &stepParams, enkiTaskSchedulerHandle taskScheduler) {
+	World2D_Ensemble *ensemble = World2D_EnsembleCreate(WT_MOE, options.worlds, options.width, options.height);
+	if (!ensemble) {
+		LOGERROR("World2D_EnsembleCreate %u x %ux%u failed", options.worlds, options.width, options.height);
+		return 1;
+	}
+	for (uint32_t i = 0; i < options.worlds; ++i) {
+		SeedWorld(World2D_EnsembleWorld(ensemble, i));
+		World2D_EnsembleParams(ensemble, i)->kernels = stepParams.kernels;
+		World2D_EnsembleParams(ensemble, i)->tileSleep = stepParams.tileSleep;
+		World2D_EnsembleParams(ensemble, i)->foodSproutChance = stepParams.foodSproutChance;
+	}
+
+	// one untimed step to fault in the back planes
+	World2D_EnsembleStep(ensemble, taskScheduler, 1);
+
+	auto const start = std::chrono::steady_clock::now();
+	World2D_EnsembleStep(ensemble, taskScheduler, options.steps);
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double const cells = (double) options.worlds * options.width * options.height * options.steps;
+
+	printf("ensemble   %u worlds of %u x %u, %u steps\n", options.worlds, options.width, options.height, options.steps);
+	printf("threads    %u\n", enkiGetNumTaskThreads(taskScheduler));
+	printf("kernels    %s\n", stepParams.kernels->name);
+	printf("time       %.3f s (%.3f ms/step)\n", seconds, seconds * 1000.0 / options.steps);
+	printf("cells/sec  %.3f M\n", cells / seconds / 1e6);
+	printf("ns/cell    %.3f\n", seconds * 1e9 / cells);
+	printf("peak mem   %.2f MB\n", (double) PeakMemoryBytes() / (1024.0 * 1024.0));
+	printf("checksum   %016llx\n", (unsigned long long) ChecksumChannel(World2D_EnsembleWorld(ensemble, 0), WMC_FOOD));
+
+	World2D_EnsembleDestroy(ensemble);
+	return 0;
+}
+
+} // end anon namespace
+
+int main(int argc, char const *argv[]) {
+	SimpleLogManager_Handle logger = SimpleLogManager_Alloc();
+
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, &options)) {
+		PrintUsage();
+		SimpleLogManager_Free(logger);
+		return 1;
+	}
+
+	World2D_StepParams stepParams;
+	World2D_StepParamsDefaults(&stepParams);
+	stepParams.kernels = KernelsByName(options.kernels);
+	stepParams.tileSleep = options.sleep;
+	stepParams.foodSproutChance = options.sprout;
+	if (!stepParams.kernels) {
+		LOGERROR("Kernels %s unknown or unsupported", options.kernels);
+		SimpleLogManager_Free(logger);
+		return 1;
+	}
+
+	enkiTaskSchedulerHandle taskScheduler = enkiNewTaskScheduler(&EnkiAlloc, &EnkiFree, &Memory_GlobalAllocator);
+	if (options.threads > 0) {
+		enkiInitTaskSchedulerNumThreads(taskScheduler, options.threads);
+	} else {
+		enkiInitTaskScheduler(taskScheduler);
+	}
+
+	if (options.worlds > 1) {
+		int const result = RunEnsemble(options, stepParams, taskScheduler);
+		enkiDeleteTaskScheduler(taskScheduler);
+		SimpleLogManager_Free(logger);
+		return result;
+	}
+
+	World2D *world = World2D_Create(WT_MOE, options.width, options.height);
+	if (!world) {
+		LOGERROR("World2D_Create %ux%u failed", options.width, options.height);
+		enkiDeleteTaskScheduler(taskScheduler);
+		SimpleLogManager_Free(logger);
+		return 1;
+	}
+	SeedWorld(world);
+
+	Agents *agents = nullptr;
+	Agents_SpatialHash agentHash{};
+	Agents_UpdateParams agentParams;
+	Agents_UpdateParamsDefaults(&agentParams);
+	if (options.agents > 0) {
+		agents = Agents_Create(options.agents);
+		if (!agents || !Agents_SpatialHashCreate(&agentHash, world, 3)) {
+			LOGERROR("Agents_Create %u failed", options.agents);
+			Agents_Destroy(agents);
+			World2D_Destroy(world);
+			enkiDeleteTaskScheduler(taskScheduler);
+			SimpleLogManager_Free(logger);
+			return 1;
+		}
+		SeedAgents(agents, world, options.agents);
+	}
+
+	// one untimed step to fault in the back planes
+	World2D_Step(world, taskScheduler, &stepParams);
+
+	double agentSeconds = 0.0;
+	auto const start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < options.steps; ++i) {
+		World2D_Step(world, taskScheduler, &stepParams);
+		if (agents) {
+			auto const agentStart = std::chrono::steady_clock::now();
+			Agents_Update(agents, world, taskScheduler, &agentParams);
+			Agents_SpatialHashRebuild(&agentHash, agents, taskScheduler);
+			if ((i & 15) == 0) {
+				Agents_SortByHash(agents, &agentHash);
+			}
+			agentSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - agentStart).count();
+		}
+	}
+	auto const end = std::chrono::steady_clock::now();
+
+	double const seconds = std::chrono::duration<double>(end - start).count() - agentSeconds;
+	double const cells = (double) options.width * (double) options.height * (double) options.steps;
+
+	printf("world      %u x %u, %u steps\n", options.width, options.height, options.steps);
+	printf("threads    %u\n", enkiGetNumTaskThreads(taskScheduler));
+	printf("kernels    %s\n", stepParams.kernels->name);
+	printf("time       %.3f s (%.3f ms/step)\n", seconds, seconds * 1000.0 / options.steps);
+	printf("cells/sec  %.3f M\n", cells / seconds / 1e6);
+	printf("ns/cell    %.3f\n", seconds * 1e9 / cells);
+	printf("peak mem   %.2f MB\n", (double) PeakMemoryBytes() / (1024.0 * 1024.0));
+	printf("tiles      %u active, %u asleep\n", World2D_TilesActive(world), World2D_TilesAsleep(world));
+	printf("checksum   %016llx\n", (unsigned long long) ChecksumChannel(world, WMC_FOOD));
+	if (agents) {
+		printf("agents     %u (%.3f ms/step update + hash)\n", agents->count, agentSeconds * 1000.0 / options.steps);
+		Agents_SpatialHashDestroy(&agentHash);
+		Agents_Destroy(agents);
+	}
+
+	World2D_Destroy(world);
+	enkiDeleteTaskScheduler(taskScheduler);
+	SimpleLogManager_Free(logger);
+	return 0;
+}
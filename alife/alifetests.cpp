@@ -4,6 +4,8 @@
 #include "alifetests.hpp"
 #include "al2o3_memory/memory.h"
 #include "world2d.hpp"
+#include "world2d_step.hpp"
+#include "agents.hpp"
 #include "al2o3_vfile/vfile.hpp"
 #include "render_basics/descriptorset.h"
 #include "render_basics/buffer.h"
@@ -11,123 +13,84 @@
 #include "render_basics/graphicsencoder.h"
 #include "render_basics/rootsignature.h"
 #include "render_basics/shader.h"
-#include "accel_cuda.hpp"
-#include "accel_sycl.hpp"
+#include "render_basics/texture.h"
+#include "accel.hpp"
+#include "world2d_cull.hpp"
+#include <chrono>
+#include <cstring>
 
 namespace {
 
 void DestroyRenderable(World2DRender *render);
 
-World2DRender* MakeRenderable(World2D const* world, Render_RendererHandle renderer, Render_ROPLayout const* ropLayout) {
+// the only texture upload relied on from render_basics is at creation, so the
+// cell texture is made from the CPU copy of the atlas and remade on frames that change it
+Render_TextureHandle CreateCellTexture(World2DRender* render) {
+	Render_TextureCreateDesc cellTextureDesc{};
+	cellTextureDesc.format = TinyImageFormat_R8G8B8A8_UNORM;
+	cellTextureDesc.usageflags = Render_TUF_SHADER_READ;
+	cellTextureDesc.width = render->stream->atlasWidth;
+	cellTextureDesc.height = render->stream->atlasHeight;
+	cellTextureDesc.depth = 1;
+	cellTextureDesc.slices = 1;
+	cellTextureDesc.mipLevels = 1;
+	cellTextureDesc.sampleCount = 1;
+	cellTextureDesc.sampleQuality = 1;
+	cellTextureDesc.initialData = render->atlas;
+	cellTextureDesc.debugName = "World2DCells";
+	return Render_TextureSyncCreate(render->renderer, &cellTextureDesc);
+}
+
+void BindDescriptors(World2DRender* render) {
+	Render_DescriptorDesc params[2];
+	params[0].name = "View";
+	params[0].type = Render_DT_BUFFER;
+	params[0].buffer = render->uniformBuffer;
+	params[0].offset = 0;
+	params[0].size = sizeof(render->uniforms);
+	params[1].name = "foodTexture";
+	params[1].type = Render_DT_TEXTURE;
+	params[1].texture = render->cellTexture;
+	Render_DescriptorPresetFrequencyUpdated(render->descriptorSet, 0, 2, params);
+}
+
+World2DRender* MakeRenderable(World2D* world, Render_RendererHandle renderer, Render_ROPLayout const* ropLayout) {
 
 	World2DRender* render = (World2DRender*) MEMORY_CALLOC(1, sizeof(World2DRender));
 	if(!render) return nullptr;
 
 	render->renderer = renderer;
-	uint32_t const totalVertexCount = world->width * world->height;
-	uint32_t const totalIndexCount = (world->width-1) * (world->height-1) * 3;
-	uint32_t const indexTypeSize = (totalVertexCount > 0xFFFF) ? 4u : 2u;
 
-	// build render objects
-
-	// construct static vertex buffer
-	Render_BufferVertexDesc const vertexDesc {
-			totalVertexCount,
-			sizeof(float) * 5,
-			false
-	};
-	render->vertexBuffer = Render_BufferCreateVertex(renderer, &vertexDesc);
-
-	if(!Render_BufferHandleIsValid(render->vertexBuffer)) {
+	// cell state and its mip pyramid live in a persistent texture atlas, only
+	// changed tiles are streamed in
+	render->stream = World2D_TexStreamCreate(world, WORLD2D_RENDER_STREAM_BUDGET, WORLD2D_RENDER_CLIPMAP_LEVELS);
+	if (!render->stream) {
 		DestroyRenderable(render);
-		return false;
-	}
-	uint8_t* vertexData = nullptr;
-	// MAX 64 KB stack else use the heap
-	if(totalVertexCount > (0xFFFF / (sizeof(float) * 5))) {
-		// short term alloc
-		vertexData = (uint8_t*) MEMORY_MALLOC(totalVertexCount * (sizeof(float) * 5));
-	} else {
-		vertexData = (uint8_t*) STACK_ALLOC(totalVertexCount * (sizeof(float) * 5));
-	}
-
-	float * curVertexPtr = (float*)vertexData;
-	for(uint32_t y = 0; y < world->height-1;++y) {
-		for(int32_t x = -(int32_t)(world->width/2); x < (int32_t)(world->width/2);++x) {
-			curVertexPtr[0] = (float)x;
-			curVertexPtr[1] = 0.0f;
-			curVertexPtr[2] = (float)y;
-			curVertexPtr[3] = (float)(x + world->width/2) / (float)(world->width-1);
-			curVertexPtr[4] = (float)y / (float)(world->height-1);
-			curVertexPtr += 5;
-		}
+		return nullptr;
 	}
-	Render_BufferUpdateDesc const vertexUpdateDesc {
-			vertexData,
-			0,
-			totalVertexCount * sizeof(float) * 5
-	};
-	Render_BufferUpload(render->vertexBuffer, &vertexUpdateDesc);
 
-	// no need to free stack allocated ram
-	if(totalVertexCount > (0xFFFF / (sizeof(float) * 5))) {
-		MEMORY_FREE(vertexData);
+	// patches are placed each frame by UpdateClipmap
+	World2DRenderGrid& grid = render->uniforms.data.grid;
+	grid.worldWidth = world->width;
+	grid.worldHeight = world->height;
+	grid.patchQuads = WORLD2D_RENDER_PATCH_QUADS;
+	for (uint32_t i = 0; i < render->stream->mipCount; ++i) {
+		World2D_TexStreamMip const& mip = render->stream->mips[i];
+		grid.levels[i][2] = (int32_t) mip.x;
+		grid.levels[i][3] = (int32_t) mip.y;
+		grid.levelMips[i][0] = mip.width;
+		grid.levelMips[i][1] = mip.height;
 	}
 
-	// construct the static index buffer
-	Render_BufferIndexDesc const indexDesc {
-			totalIndexCount,
-			indexTypeSize,
-			false
-	};
-	render->indexBuffer = Render_BufferCreateIndex(renderer, &indexDesc);
-	if(!Render_BufferHandleIsValid(render->indexBuffer)) {
+	render->atlas = (uint8_t*) MEMORY_CALLOC((size_t) render->stream->atlasWidth * render->stream->atlasHeight, WORLD2D_TEXSTREAM_TEXEL_SIZE);
+	if (!render->atlas) {
 		DestroyRenderable(render);
-		return false;
-	}
-
-	uint8_t* indexData = nullptr;
-	// MAX 64 KB stack else use the heap
-	if(totalIndexCount > (0xFFFF / (indexTypeSize*3))) {
-		// short term alloc
-		indexData = (uint8_t*) MEMORY_MALLOC(totalIndexCount * indexTypeSize);
-	} else {
-		indexData = (uint8_t*) STACK_ALLOC(totalIndexCount * indexTypeSize);
-	}
-
-	uint8_t * curIndexPtr = indexData;
-	for(uint32_t y = 0; y < world->height-1;++y) {
-		for(uint32_t x = 0; x < world->width-1;++x) {
-			switch(indexTypeSize) {
-				case 2:
-					((uint16_t*)curIndexPtr)[0] = (y * world->height) + x;
-					((uint16_t*)curIndexPtr)[1] = ((y+1) * world->height) + x;
-					((uint16_t*)curIndexPtr)[2] = (y * world->height) + (x+1);
-					curIndexPtr += 6;
-					break;
-				case 4: {
-					((uint32_t*)curIndexPtr)[0] = (y * world->height) + x;
-					((uint32_t*)curIndexPtr)[1] = ((y+1) * world->height) + x;
-					((uint32_t*)curIndexPtr)[2] = (y * world->height) + (x+1);
-					curIndexPtr += 12;
-					break;
-				}
-				default:
-					LOGERROR("Invalid index buffer type size");
-					break;
-			}
-		}
+		return nullptr;
 	}
-	Render_BufferUpdateDesc const indexUpdateDesc {
-			indexData,
-			0,
-			totalIndexCount * indexTypeSize
-	};
-	Render_BufferUpload(render->indexBuffer, &indexUpdateDesc);
-
-	// no need to free stack allocated ram
-	if(totalIndexCount > (0xFFFF / (indexTypeSize*3))) {
-		MEMORY_FREE(indexData);
+	render->cellTexture = CreateCellTexture(render);
+	if (!Render_TextureHandleIsValid(render->cellTexture)) {
+		DestroyRenderable(render);
+		return nullptr;
 	}
 
 	static Render_BufferUniformDesc const ubDesc{
@@ -174,7 +137,7 @@ World2DRender* MakeRenderable(World2D const* world, Render_RendererHandle render
 	Render_GraphicsPipelineDesc gfxPipeDesc{};
 	gfxPipeDesc.shader = render->shader;
 	gfxPipeDesc.rootSignature = render->rootSignature;
-	gfxPipeDesc.vertexLayout = Render_GetStockVertexLayout(render->renderer, Render_SVL_3D_UV);
+	gfxPipeDesc.vertexLayout = nullptr;
 	gfxPipeDesc.blendState = Render_GetStockBlendState(render->renderer, Render_SBS_OPAQUE);
 	if(ropLayout->depthFormat == TinyImageFormat_UNDEFINED) {
 		gfxPipeDesc.depthState = Render_GetStockDepthState(render->renderer, Render_SDS_IGNORE);
@@ -205,13 +168,7 @@ World2DRender* MakeRenderable(World2D const* world, Render_RendererHandle render
 		return nullptr;
 	}
 
-	Render_DescriptorDesc params[1];
-	params[0].name = "View";
-	params[0].type = Render_DT_BUFFER;
-	params[0].buffer = render->uniformBuffer;
-	params[0].offset = 0;
-	params[0].size = sizeof(render->uniforms);
-	Render_DescriptorPresetFrequencyUpdated(render->descriptorSet, 0, 1, params);
+	BindDescriptors(render);
 
 	return render;
 }
@@ -225,12 +182,153 @@ void DestroyRenderable(World2DRender *render) {
 	Render_RootSignatureDestroy(render->renderer, render->rootSignature);
 
 	Render_BufferDestroy(render->renderer, render->uniformBuffer);
-	Render_BufferDestroy(render->renderer, render->indexBuffer);
-	Render_BufferDestroy(render->renderer, render->vertexBuffer);
+	Render_TextureDestroy(render->renderer, render->cellTexture);
+	for (Render_TextureHandle texture : render->retiredTextures) {
+		if (Render_TextureHandleIsValid(texture)) Render_TextureDestroy(render->renderer, texture);
+	}
+	if (render->atlas) MEMORY_FREE(render->atlas);
+	World2D_TexStreamDestroy(render->stream);
 
 	MEMORY_FREE(render);
 }
+
+int32_t FloorTo(int32_t v, int32_t multiple) {
+	return (v >= 0) ? v - (v % multiple) : v - (multiple - 1 - ((-v - 1) % multiple));
+}
+
+// centres the clipmap levels on the camera. Each level's origin snaps to its
+// parent's quad grid so its border vertices land on the coarser level's, and
+// patches outside the world or wholly under the finer level aren't drawn. Stops
+// at the first level that covers the whole world so the patch count is bounded
+// by the level count, not the world size.
+void UpdateClipmap(World2DRender* render, float cameraCellX, float cameraCellY) {
+	World2DRenderGrid& grid = render->uniforms.data.grid;
+	int32_t const cx = (int32_t) floorf(cameraCellX);
+	int32_t const cy = (int32_t) floorf(cameraCellY);
+	int32_t const worldMaxX = (int32_t) grid.worldWidth - 1;
+	int32_t const worldMaxY = (int32_t) grid.worldHeight - 1;
+
+	render->clipmapPatchCount = 0;
+	grid.levelCount = 0;
+	for (uint32_t level = 0; level < render->stream->mipCount; ++level) {
+		int32_t const spacing = 1 << level;
+		int32_t const patchSize = WORLD2D_RENDER_PATCH_QUADS * spacing;
+		int32_t const extent = WORLD2D_RENDER_LEVEL_PATCHES * patchSize;
+		int32_t const ox = FloorTo(cx, spacing * 2) - extent / 2;
+		int32_t const oy = FloorTo(cy, spacing * 2) - extent / 2;
+		grid.levels[level][0] = ox;
+		grid.levels[level][1] = oy;
+		grid.levelCount++;
+
+		int32_t const* inner = (level > 0) ? grid.levels[level - 1] : nullptr;
+		int32_t const innerExtent = extent / 2;
+		for (int32_t py = 0; py < WORLD2D_RENDER_LEVEL_PATCHES; ++py) {
+			for (int32_t px = 0; px < WORLD2D_RENDER_LEVEL_PATCHES; ++px) {
+				int32_t const x0 = ox + px * patchSize;
+				int32_t const y0 = oy + py * patchSize;
+				if (x0 >= worldMaxX || y0 >= worldMaxY || x0 + patchSize <= 0 || y0 + patchSize <= 0) continue;
+				if (inner && x0 >= inner[0] && y0 >= inner[1] &&
+						x0 + patchSize <= inner[0] + innerExtent && y0 + patchSize <= inner[1] + innerExtent) {
+					continue;
+				}
+				int32_t* patch = grid.patches[render->clipmapPatchCount++];
+				patch[0] = x0;
+				patch[1] = y0;
+				patch[2] = (int32_t) level;
+				patch[3] = 0;
+			}
+		}
+
+		if (ox <= 0 && oy <= 0 && ox + extent >= worldMaxX && oy + extent >= worldMaxY) break;
+	}
+}
+
+// drops the clipmap patches outside the view frustum and compacts the rest to
+// the front of grid.patches, so the draw and its vertex work only
+// cover what can be seen. Bounds are the patch clamped to the world, full
+// height as the heights aren't known on the CPU.
+void CullPatches(World2DRender* render, Math_Mat4F const& worldToNDC) {
+	World2DRenderGrid& grid = render->uniforms.data.grid;
+	float const halfWidth = (float) (grid.worldWidth / 2);
+	float const worldMaxX = (float) (grid.worldWidth - 1);
+	float const worldMaxY = (float) (grid.worldHeight - 1);
+
+	for (uint32_t i = 0; i < render->clipmapPatchCount; ++i) {
+		int32_t const* patch = grid.patches[i];
+		float const patchSize = (float) (WORLD2D_RENDER_PATCH_QUADS << patch[2]);
+		float const x0 = fmaxf((float) patch[0], 0.0f);
+		float const y0 = fmaxf((float) patch[1], 0.0f);
+		float const x1 = fminf((float) patch[0] + patchSize, worldMaxX);
+		float const y1 = fminf((float) patch[1] + patchSize, worldMaxY);
+		render->patchMinX[i] = x0 - halfWidth;
+		render->patchMaxX[i] = x1 - halfWidth;
+		render->patchMinY[i] = 0.0f;
+		render->patchMaxY[i] = WORLD2D_RENDER_HEIGHT_SCALE;
+		render->patchMinZ[i] = y0;
+		render->patchMaxZ[i] = y1;
+	}
+
+	float matrix[16];
+	static_assert(sizeof(matrix) == sizeof(Math_Mat4F), "Math_Mat4F expected to be 16 floats");
+	memcpy(matrix, &worldToNDC, sizeof(matrix));
+	World2D_CullFrustum frustum;
+	World2D_CullFrustumFromMatrix(matrix, &frustum);
+
+	World2D_CullBoxes const boxes{
+			render->patchMinX, render->patchMinY, render->patchMinZ,
+			render->patchMaxX, render->patchMaxY, render->patchMaxZ,
+	};
+	render->patchCount = World2D_CullBoxesVisible(&frustum, &boxes, render->clipmapPatchCount, render->visiblePatches);
+
+	// visible indices ascend so compacting in place never overwrites one still to be read
+	for (uint32_t i = 0; i < render->patchCount; ++i) {
+		uint32_t const src = render->visiblePatches[i];
+		if (src == i) continue;
+		memcpy(grid.patches[i], grid.patches[src], sizeof(grid.patches[i]));
+	}
+}
+
+// copies the tiles that changed since the last frame from this frames staging
+// slice into the CPU atlas, the packing cost follows the changed area not the
+// world size. If anything changed the cell texture is remade from the atlas,
+// the one it replaces is kept until the GPU is done with it
+void StreamCellTexture(World2DRender* render) {
+	// replaced WORLD2D_TEXSTREAM_FRAMES frames ago, so no longer in flight
+	Render_TextureHandle& retired = render->retiredTextures[render->retireSlot];
+	render->retireSlot = (render->retireSlot + 1) % WORLD2D_TEXSTREAM_FRAMES;
+	if (Render_TextureHandleIsValid(retired)) {
+		Render_TextureDestroy(render->renderer, retired);
+		retired = {};
+	}
+
+	uint32_t const regionCount = World2D_TexStreamBeginFrame(render->stream);
+	if (regionCount == 0) return;
+
+	uint8_t const* staging = World2D_TexStreamFrameStaging(render->stream);
+	size_t const atlasPitch = (size_t) render->stream->atlasWidth * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+	for (uint32_t i = 0; i < regionCount; ++i) {
+		World2D_TexStreamRegion const& region = render->stream->regions[i];
+		size_t const rowBytes = (size_t) region.width * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+		for (uint32_t y = 0; y < region.height; ++y) {
+			memcpy(render->atlas + (region.y + y) * atlasPitch + region.x * WORLD2D_TEXSTREAM_TEXEL_SIZE,
+						 staging + region.stagingOffset + y * rowBytes,
+						 rowBytes);
+		}
+	}
+
+	Render_TextureHandle const texture = CreateCellTexture(render);
+	if (!Render_TextureHandleIsValid(texture)) {
+		// the atlas has the changes, they go with the next texture made
+		LOGERROR("World2D cell texture recreate failed");
+		return;
+	}
+	retired = render->cellTexture;
+	render->cellTexture = texture;
+	BindDescriptors(render);
+}
+
 void RenderWorld2D(World2D const * world, World2DRender* render, Render_GraphicsEncoderHandle encoder) {
+	StreamCellTexture(render);
 
 	// upload the uniforms
 	Render_BufferUpdateDesc uniformUpdate = {
@@ -241,36 +339,63 @@ void RenderWorld2D(World2D const * world, World2DRender* render, Render_Graphics
 	Render_BufferUpload(render->uniformBuffer, &uniformUpdate);
 
 	Render_GraphicsEncoderBindDescriptorSet(encoder, render->descriptorSet, 0);
-	Render_GraphicsEncoderBindIndexBuffer(encoder, render->indexBuffer, 0);
-	Render_GraphicsEncoderBindVertexBuffer(encoder, render->vertexBuffer, 0);
 	Render_GraphicsEncoderBindPipeline(encoder, render->pipeline);
 
-	uint32_t const totalIndexCount = (world->width-1) * (world->height-1) * 3;
-	Render_GraphicsEncoderDrawIndexed(encoder, totalIndexCount, 0, 0);
+	// only patches that passed the frustum test are in the list, quads outside
+	// the world or under a finer level collapse in the vertex shader
+	Render_GraphicsEncoderDraw(encoder, render->patchCount * WORLD2D_RENDER_PATCH_VERTICES, 0);
 }
 
 }; // end anon namespace
 
-ALifeTests* ALifeTests::Create(Render_RendererHandle renderer, Render_ROPLayout const * targetLayout) {
+ALifeTests* ALifeTests::Create(Render_RendererHandle renderer, Render_ROPLayout const * targetLayout, enkiTaskSchedulerHandle taskScheduler) {
 	ALifeTests* alt = (ALifeTests*) MEMORY_CALLOC(1, sizeof(ALifeTests));
 	if(!alt) {
 		return nullptr;
 	}
+	alt->taskScheduler = taskScheduler;
 
-	alt->accelCuda = AccelCUDA_Create();
-	alt->accelSycl = AccelSycl_Create();
+	auto phaseStart = std::chrono::steady_clock::now();
+	auto const logPhase = [&phaseStart](char const* phase) {
+		auto const now = std::chrono::steady_clock::now();
+		LOGINFO("ALifeTests %s %.2f ms", phase, std::chrono::duration<double, std::milli>(now - phaseStart).count());
+		phaseStart = now;
+	};
 
 	alt->world2d = World2D_Create(WT_MOE, 64, 64);
 	if(!alt->world2d) {
 		Destroy(alt);
 		return nullptr;
 	}
+	World2D_StepParamsDefaults(&alt->stepParams);
+	alt->stepBudgetMS = ALIFETESTS_STEP_BUDGET_MS;
+	logPhase("world");
+
+	// device backends come up on an enki task, the world steps on the cpu till then
+	alt->accel = Accel_Create(taskScheduler);
+	if(!alt->accel || !Accel_Bind(alt->accel, alt->world2d, &alt->stepParams)) {
+		Destroy(alt);
+		return nullptr;
+	}
+	logPhase("accel");
+
+	alt->agents = Agents_Create(256);
+	if(!alt->agents || !Agents_SpatialHashCreate(&alt->agentHash, alt->world2d, 3)) {
+		Destroy(alt);
+		return nullptr;
+	}
+	Agents_UpdateParamsDefaults(&alt->agentParams);
+	for(uint32_t i = 0; i < 256; ++i) {
+		Agents_Add(alt->agents, (float)(i % 16) * 4.0f, (float)(i / 16) * 4.0f, 100.0f, i);
+	}
+	logPhase("agents");
 
 	alt->worldRender = MakeRenderable(alt->world2d, renderer, targetLayout);
 	if(!alt->worldRender){
 		Destroy(alt);
 		return nullptr;
 	}
+	logPhase("renderable");
 
 	return alt;
 }
@@ -279,26 +404,41 @@ void ALifeTests::Destroy(ALifeTests* alt) {
 	if(!alt) return;
 
 	DestroyRenderable(alt->worldRender);
+	Agents_SpatialHashDestroy(&alt->agentHash);
+	Agents_Destroy(alt->agents);
+	Accel_Destroy(alt->accel);
 	World2D_Destroy(alt->world2d);
 
-	AccelSycl_Destroy(alt->accelSycl);
-	AccelCUDA_Destroy(alt->accelCuda);
 	MEMORY_FREE(alt);
 }
 
-void ALifeTests::update(double deltaMS, Render_View const& view) {
+void ALifeTests::simulate(double stepMS, uint32_t frameSteps) {
+	ASSERT(frameSteps > 0);
+	// the move only reads the front planes but eating takes food out of them,
+	// mid tick the tiles still to step would see that and the stepped ones not
+	if(Accel_StepSliced(accel, world2d, &stepParams, &stepSlice, stepBudgetMS / frameSteps)) {
+		Agents_Update(agents, world2d, taskScheduler, &agentParams);
+		Agents_SpatialHashRebuild(&agentHash, agents, taskScheduler);
+	}
+}
+
+void ALifeTests::update(Render_View const& view) {
 	if(worldRender) {
-		worldRender->uniforms.view.worldToViewMatrix = Math_LookAtMat4F(view.position, view.lookAt, view.upVector);
+		worldRender->uniforms.data.view.worldToViewMatrix = Math_LookAtMat4F(view.position, view.lookAt, view.upVector);
 
 		float const f = 1.0f / tanf(view.perspectiveFOV / 2.0f);
-		worldRender->uniforms.view.viewToNDCMatrix = {
+		worldRender->uniforms.data.view.viewToNDCMatrix = {
 				f / view.perspectiveAspectWoverH, 0.0f, 0.0f, 0.0f,
 				0.0f, f, 0.0f, 0.0f,
 				0.0f, 0.0f, 0.0f, 1.0f,
 				0.0f, 0.0f, view.nearOffset, 0.0f
 		};
 
-		worldRender->uniforms.view.worldToNDCMatrix = Math_MultiplyMat4F(worldRender->uniforms.view.worldToViewMatrix, worldRender->uniforms.view.viewToNDCMatrix);
+		worldRender->uniforms.data.view.worldToNDCMatrix = Math_MultiplyMat4F(worldRender->uniforms.data.view.worldToViewMatrix, worldRender->uniforms.data.view.viewToNDCMatrix);
+
+		// the grid is centred on x, cell rows run along z
+		UpdateClipmap(worldRender, view.position.x + (float)(world2d->width / 2), view.position.z);
+		CullPatches(worldRender, worldRender->uniforms.data.view.worldToNDCMatrix);
 	}
 }
 
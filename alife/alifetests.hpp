@@ -3,7 +3,52 @@
 
 #include "render_basics/api.h"
 #include "render_basics/view.h"
+#include "al2o3_enki/TaskScheduler_c.h"
 #include "world2d.hpp"
+#include "world2d_step.hpp"
+#include "agents.hpp"
+#include "world2d_texstream.hpp"
+#include "world2d_cull.hpp"
+#include "accel.hpp"
+
+// The world is drawn as a geometry clipmap centred on the camera. Level L is
+// a 4x4 grid of patches with quads 2^L cells across, so each level covers
+// twice the area of the one inside it at the same triangle count. Patches are
+// built from the vertex id, WORLD2D_RENDER_PATCH_VERTICES per patch, there are
+// no vertex or index buffers.
+#define WORLD2D_RENDER_PATCH_QUADS 32
+#define WORLD2D_RENDER_PATCH_VERTICES (WORLD2D_RENDER_PATCH_QUADS * WORLD2D_RENDER_PATCH_QUADS * 6)
+#define WORLD2D_RENDER_LEVEL_PATCHES 4
+#define WORLD2D_RENDER_CLIPMAP_LEVELS 10
+#define WORLD2D_RENDER_MAX_PATCHES (WORLD2D_RENDER_CLIPMAP_LEVELS * WORLD2D_RENDER_LEVEL_PATCHES * WORLD2D_RENDER_LEVEL_PATCHES)
+// cell height at full food, matches heightScale in world2dmoe_vertex.hlsl
+#define WORLD2D_RENDER_HEIGHT_SCALE 8.0f
+// CPU time per frame for the world step, shared by the frame's simulation
+// steps. Ticks that need more are spread over several frames and the agents
+// move once per completed tick
+#define ALIFETESTS_STEP_BUDGET_MS 4.0
+// staging bytes streamed into the cell texture per frame, 4MB is a 1024^2 area
+#define WORLD2D_RENDER_STREAM_BUDGET (4u * 1024u * 1024u)
+
+// matches the Grid part of the View cbuffer in world2dmoe_vertex.hlsl
+struct World2DRenderGrid {
+	uint32_t worldWidth;
+	uint32_t worldHeight;
+	uint32_t patchQuads;
+	uint32_t levelCount;
+
+	// per level, x y of its origin in cells and x y of its mip in the atlas
+	int32_t levels[WORLD2D_RENDER_CLIPMAP_LEVELS][4];
+	// per level, width and height of its mip
+	uint32_t levelMips[WORLD2D_RENDER_CLIPMAP_LEVELS][4];
+	// per drawn patch, x y of the patch origin in cells and its level
+	int32_t patches[WORLD2D_RENDER_MAX_PATCHES][4];
+};
+
+struct World2DRenderUniforms {
+	Render_GpuView view;
+	World2DRenderGrid grid;
+};
 
 struct World2DRender {
 	Render_RendererHandle renderer;
@@ -13,29 +58,58 @@ struct World2DRender {
 	Render_RootSignatureHandle rootSignature;
 
 	union {
-		Render_GpuView view;
+		World2DRenderUniforms data;
 		uint8_t spacer[UNIFORM_BUFFER_MIN_SIZE];
 	} uniforms;
 
 	Render_BufferHandle uniformBuffer;
-	Render_BufferHandle indexBuffer;
-	Render_BufferHandle vertexBuffer;
+	// patches the clipmap placed this frame and how many survived culling,
+	// only the survivors are in grid.patches and drawn
+	uint32_t clipmapPatchCount;
+	uint32_t patchCount;
+
+	// world space bounds of the placed patches, one array per axis for the
+	// frustum test, and the indices of the visible ones
+	float patchMinX[WORLD2D_RENDER_MAX_PATCHES];
+	float patchMinY[WORLD2D_RENDER_MAX_PATCHES];
+	float patchMinZ[WORLD2D_RENDER_MAX_PATCHES];
+	float patchMaxX[WORLD2D_RENDER_MAX_PATCHES];
+	float patchMaxY[WORLD2D_RENDER_MAX_PATCHES];
+	float patchMaxZ[WORLD2D_RENDER_MAX_PATCHES];
+	uint32_t visiblePatches[WORLD2D_RENDER_MAX_PATCHES];
 
+	// the cell texture is made from atlas, a CPU copy the stream's changed
+	// tiles are copied into. Textures it replaced wait out the frames in flight
+	Render_TextureHandle cellTexture;
+	uint8_t* atlas;
+	Render_TextureHandle retiredTextures[WORLD2D_TEXSTREAM_FRAMES];
+	uint32_t retireSlot;
+	World2D_TexStream* stream;
 };
 
 class ALifeTests {
 public:
-	static ALifeTests* Create(Render_RendererHandle renderer, Render_ROPLayout const * targetLayout);
+	static ALifeTests* Create(Render_RendererHandle renderer, Render_ROPLayout const * targetLayout, enkiTaskSchedulerHandle taskScheduler);
 	static void Destroy(ALifeTests* alt);
 
-	void update(double deltaMS, Render_View const& view);
+	// one of the frame's frameSteps fixed simulation steps, each gets that
+	// share of the frame's step budget. The world's cells are drawn as they are
+	// at the last completed tick, there is nothing between ticks to interpolate
+	void simulate(double stepMS, uint32_t frameSteps);
+	void update(Render_View const& view);
 	void render(Render_GraphicsEncoderHandle encoder);
 
 protected:
 
+	enkiTaskSchedulerHandle taskScheduler;
 	World2D* world2d;
+	World2D_StepParams stepParams;
+	World2D_StepSlice stepSlice;
+	double stepBudgetMS;
+	Agents* agents;
+	Agents_SpatialHash agentHash;
+	Agents_UpdateParams agentParams;
 	World2DRender* worldRender;
-	struct Cuda* accelCuda;
-	struct Sycl* accelSycl;
+	Accel* accel;
 
 };
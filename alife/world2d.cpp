@@ -5,28 +5,98 @@
 #include "al2o3_platform/platform.h"
 #include "al2o3_memory/memory.h"
 #include "world2d.hpp"
-#include "al2o3_vfile/vfile.hpp"
-#include "render_basics/descriptorset.h"
-#include "render_basics/buffer.h"
-#include "render_basics/pipeline.h"
-#include "render_basics/graphicsencoder.h"
-#include "render_basics/rootsignature.h"
-#include "render_basics/shader.h"
+#include "world2d_schema.hpp"
 
+namespace {
 
-World2D* World2D_Create(WorldType type, uint32_t width, uint32_t height) {
-	World2D* world = (World2D*) MEMORY_CALLOC(1, sizeof(World2D));
-	if(!world) goto Fail;
+uint32_t RoundUp(uint32_t v, uint32_t multiple) {
+	return ((v + multiple - 1) / multiple) * multiple;
+}
+
+bool AllocChannel(World2D* world, World2D_ChannelDesc const& desc, World2D_Layout layoutOverride) {
+	ASSERT(world->channelCount < WORLD2D_MAX_CHANNELS);
+	World2DChannel& channel = world->channels[world->channelCount];
+	World2D_DescribeChannel(world->width, world->height, desc, layoutOverride, channel);
+
+	channel.data = MEMORY_AALLOC(channel.sizeInBytes, WORLD2D_CACHE_LINE_SIZE);
+	if(!channel.data) return false;
+	desc.fill(channel.data, channel.sizeInBytes);
+
+	if(channel.doubleBuffered) {
+		channel.back = MEMORY_AALLOC(channel.sizeInBytes, WORLD2D_CACHE_LINE_SIZE);
+		if(!channel.back) {
+			MEMORY_FREE(channel.data);
+			channel.data = nullptr;
+			return false;
+		}
+		desc.fill(channel.back, channel.sizeInBytes);
+	}
+
+	world->channelCount++;
+	return true;
+}
+
+size_t CacheLineRoundUp(size_t v) {
+	return (v + WORLD2D_CACHE_LINE_SIZE - 1) & ~(size_t)(WORLD2D_CACHE_LINE_SIZE - 1);
+}
 
+// the header of a world before any planes, shared by the heap and arena creates
+void InitWorld(World2D* world, WorldType type, uint32_t width, uint32_t height) {
+	world->type = type;
 	world->width = width;
 	world->height = height;
-	switch(type) {
-		case WT_MOE:
-			world->world = MEMORY_CALLOC(width*height, sizeof(WorldMOE));
+	world->dirtyTilesX = (width + WORLD2D_DIRTY_TILE_SIZE - 1) >> WORLD2D_DIRTY_TILE_SHIFT;
+	world->dirtyTilesY = (height + WORLD2D_DIRTY_TILE_SIZE - 1) >> WORLD2D_DIRTY_TILE_SHIFT;
+}
+
+} // end anon namespace
+
+void World2D_DescribeChannel(uint32_t width, uint32_t height, World2D_ChannelDesc const& desc, World2D_Layout layoutOverride, World2DChannel& channel) {
+	channel.name = desc.name;
+	channel.elementSize = desc.elementSize;
+	channel.doubleBuffered = desc.doubleBuffered;
+	channel.layout = (layoutOverride == WL_DEFAULT) ? desc.layout : layoutOverride;
+
+	switch(channel.layout) {
+		case WL_TILED_MORTON:
+			channel.pitch = RoundUp(width, WORLD2D_MORTON_TILE_SIZE);
+			channel.paddedHeight = RoundUp(height, WORLD2D_MORTON_TILE_SIZE);
+			break;
+		default:
+			channel.layout = WL_ROW_MAJOR;
+			channel.pitch = RoundUp(width, WORLD2D_CACHE_LINE_SIZE / desc.elementSize);
+			channel.paddedHeight = height;
 			break;
 	}
 
-	if(!world->world) goto Fail;
+	size_t const size = (size_t)channel.pitch * channel.paddedHeight * channel.elementSize;
+	channel.sizeInBytes = (size + WORLD2D_CACHE_LINE_SIZE - 1) & ~(size_t)(WORLD2D_CACHE_LINE_SIZE - 1);
+}
+
+World2D_ChannelDesc const* World2D_TypeChannelDescs(WorldType type, uint32_t* channelCount) {
+	ASSERT(channelCount);
+	World2D_TypeOps const* ops = World2D_TypeOpsFor(type);
+	*channelCount = ops ? ops->channelCount : 0;
+	return ops ? ops->channels : nullptr;
+}
+
+World2D* World2D_Create(WorldType type, uint32_t width, uint32_t height, World2D_Layout layout) {
+	World2D* world = (World2D*) MEMORY_CALLOC(1, sizeof(World2D));
+	if(!world) goto Fail;
+
+	InitWorld(world, type, width, height);
+	world->dirtyTiles = (uint8_t*) MEMORY_CALLOC(world->dirtyTilesX * world->dirtyTilesY, sizeof(uint8_t));
+	world->tileActivity = (uint8_t*) MEMORY_CALLOC(world->dirtyTilesX * world->dirtyTilesY, sizeof(uint8_t));
+	if(!world->dirtyTiles || !world->tileActivity) goto Fail;
+	{
+		uint32_t descCount = 0;
+		World2D_ChannelDesc const* descs = World2D_TypeChannelDescs(type, &descCount);
+		for(uint32_t i = 0; i < descCount; ++i) {
+			if(!AllocChannel(world, descs[i], layout)) goto Fail;
+		}
+	}
+
+	if(world->channelCount == 0) goto Fail;
 
 	return world;
 Fail:
@@ -34,10 +104,267 @@ Fail:
 	return nullptr;
 }
 
+size_t World2D_ArenaSize(WorldType type, uint32_t width, uint32_t height, World2D_Layout layout) {
+	World2D world{};
+	InitWorld(&world, type, width, height);
+
+	size_t size = CacheLineRoundUp(sizeof(World2D));
+	// dirty tiles and tile activity
+	size += CacheLineRoundUp((size_t)world.dirtyTilesX * world.dirtyTilesY) * 2;
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = World2D_TypeChannelDescs(type, &descCount);
+	for(uint32_t i = 0; i < descCount; ++i) {
+		World2DChannel channel{};
+		World2D_DescribeChannel(world.width, world.height, descs[i], layout, channel);
+		size += channel.sizeInBytes * (channel.doubleBuffered ? 2 : 1);
+	}
+	return size;
+}
+
+World2D* World2D_CreateInArena(WorldType type, uint32_t width, uint32_t height, World2D_Layout layout, void* arena) {
+	ASSERT(arena);
+	ASSERT(((uintptr_t)arena & (WORLD2D_CACHE_LINE_SIZE - 1)) == 0);
+
+	uint8_t* next = (uint8_t*)arena;
+	World2D* world = (World2D*)next;
+	memset(world, 0, sizeof(World2D));
+	world->inArena = true;
+	InitWorld(world, type, width, height);
+	next += CacheLineRoundUp(sizeof(World2D));
+
+	size_t const dirtyBytes = (size_t)world->dirtyTilesX * world->dirtyTilesY;
+	world->dirtyTiles = next;
+	memset(world->dirtyTiles, 0, dirtyBytes);
+	next += CacheLineRoundUp(dirtyBytes);
+	world->tileActivity = next;
+	memset(world->tileActivity, 0, dirtyBytes);
+	next += CacheLineRoundUp(dirtyBytes);
+
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = World2D_TypeChannelDescs(type, &descCount);
+	for(uint32_t i = 0; i < descCount; ++i) {
+		ASSERT(world->channelCount < WORLD2D_MAX_CHANNELS);
+		World2DChannel& channel = world->channels[world->channelCount++];
+		World2D_DescribeChannel(world->width, world->height, descs[i], layout, channel);
+		channel.data = next;
+		next += channel.sizeInBytes;
+		descs[i].fill(channel.data, channel.sizeInBytes);
+		if(channel.doubleBuffered) {
+			channel.back = next;
+			next += channel.sizeInBytes;
+			descs[i].fill(channel.back, channel.sizeInBytes);
+		}
+	}
+	ASSERT((size_t)(next - (uint8_t*)arena) == World2D_ArenaSize(type, width, height, layout));
+
+	if(world->channelCount == 0) return nullptr;
+	return world;
+}
+
 void World2D_Destroy(World2D* world) {
+	// arena worlds are freed with their arena
+	if(world && world->inArena) return;
 	if(world) {
-		if (world->world)
-			MEMORY_FREE(world->world);
+		for(uint32_t i = 0; i < world->channelCount; ++i) {
+			if (world->channels[i].data)
+				MEMORY_FREE(world->channels[i].data);
+			if (world->channels[i].back)
+				MEMORY_FREE(world->channels[i].back);
+		}
+		if (world->dirtyTiles)
+			MEMORY_FREE(world->dirtyTiles);
+		if (world->tileActivity)
+			MEMORY_FREE(world->tileActivity);
 		MEMORY_FREE(world);
 	}
-}
\ No newline at end of file
+}
+
+void World2D_Clear(World2D* world) {
+	ASSERT(world);
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = World2D_TypeChannelDescs(world->type, &descCount);
+	ASSERT(descCount == world->channelCount);
+	for(uint32_t i = 0; i < world->channelCount; ++i) {
+		World2DChannel& channel = world->channels[i];
+		descs[i].fill(channel.data, channel.sizeInBytes);
+		if(channel.back) descs[i].fill(channel.back, channel.sizeInBytes);
+	}
+	World2D_MarkDirtyRect(world, 0, 0, world->width, world->height);
+}
+
+void World2D_SwapBuffers(World2D* world) {
+	ASSERT(world);
+	for(uint32_t i = 0; i < world->channelCount; ++i) {
+		World2DChannel& channel = world->channels[i];
+		if(!channel.doubleBuffered) continue;
+
+		void* tmp = channel.data;
+		channel.data = channel.back;
+		channel.back = tmp;
+	}
+	world->tick++;
+}
+
+uint32_t World2D_DirtyConsumerRegister(World2D* world) {
+	ASSERT(world);
+	for(uint32_t i = 0; i < WORLD2D_MAX_DIRTY_CONSUMERS; ++i) {
+		uint8_t const bit = (uint8_t)(1u << i);
+		if(world->dirtyConsumersInUse & bit) continue;
+
+		world->dirtyConsumersInUse |= bit;
+		uint32_t const tileCount = world->dirtyTilesX * world->dirtyTilesY;
+		for(uint32_t t = 0; t < tileCount; ++t) {
+			world->dirtyTiles[t] |= bit;
+		}
+		return i;
+	}
+	LOGERROR("World2D has no free dirty consumer slots");
+	return WORLD2D_INVALID_DIRTY_CONSUMER;
+}
+
+void World2D_DirtyConsumerUnregister(World2D* world, uint32_t consumer) {
+	if(!world || consumer >= WORLD2D_MAX_DIRTY_CONSUMERS) return;
+	world->dirtyConsumersInUse &= (uint8_t)~(1u << consumer);
+}
+
+void World2D_MarkDirtyRect(World2D* world, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+	ASSERT(world);
+	if(width == 0 || height == 0 || x >= world->width || y >= world->height) return;
+
+	// no x + width, it wraps for "to the edge" sizes like UINT32_MAX
+	uint32_t const x1 = (width > world->width - x) ? world->width : x + width;
+	uint32_t const y1 = (height > world->height - y) ? world->height : y + height;
+	uint32_t const tx0 = x >> WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const ty0 = y >> WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const tx1 = (x1 - 1) >> WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const ty1 = (y1 - 1) >> WORLD2D_DIRTY_TILE_SHIFT;
+
+	for(uint32_t ty = ty0; ty <= ty1; ++ty) {
+		memset(world->dirtyTiles + ty * world->dirtyTilesX + tx0, 0xFF, tx1 - tx0 + 1);
+	}
+	if(world->tilesAsleep) World2D_WakeTiles(world, tx0, ty0, tx1, ty1);
+}
+
+void World2D_WakeTiles(World2D* world, uint32_t tileX0, uint32_t tileY0, uint32_t tileX1, uint32_t tileY1) {
+	ASSERT(world);
+	ASSERT(tileX0 <= tileX1 && tileX1 < world->dirtyTilesX);
+	ASSERT(tileY0 <= tileY1 && tileY1 < world->dirtyTilesY);
+	uint32_t const tx0 = (tileX0 > 0) ? tileX0 - 1 : 0;
+	uint32_t const ty0 = (tileY0 > 0) ? tileY0 - 1 : 0;
+	uint32_t const tx1 = (tileX1 + 1 < world->dirtyTilesX) ? tileX1 + 1 : tileX1;
+	uint32_t const ty1 = (tileY1 + 1 < world->dirtyTilesY) ? tileY1 + 1 : tileY1;
+
+	for(uint32_t ty = ty0; ty <= ty1; ++ty) {
+		uint8_t* row = world->tileActivity + ty * world->dirtyTilesX;
+		for(uint32_t tx = tx0; tx <= tx1; ++tx) {
+			if(!(row[tx] & WORLD2D_TILE_ASLEEP)) continue;
+			row[tx] &= (uint8_t)~WORLD2D_TILE_ASLEEP;
+			world->tilesAsleep--;
+		}
+	}
+}
+
+bool World2D_IsAnyDirty(World2D const* world, uint32_t consumer) {
+	ASSERT(world);
+	ASSERT(consumer < WORLD2D_MAX_DIRTY_CONSUMERS);
+	uint8_t const bit = (uint8_t)(1u << consumer);
+	uint32_t const tileCount = world->dirtyTilesX * world->dirtyTilesY;
+	for(uint32_t t = 0; t < tileCount; ++t) {
+		if(world->dirtyTiles[t] & bit) return true;
+	}
+	return false;
+}
+
+uint32_t World2D_GetDirtyRects(World2D const* world, uint32_t consumer, World2D_Rect* rects, uint32_t maxRects) {
+	ASSERT(world);
+	ASSERT(consumer < WORLD2D_MAX_DIRTY_CONSUMERS);
+	uint8_t const bit = (uint8_t)(1u << consumer);
+
+	// rects are built in tile units, a run on this row extends a rect from the
+	// row above if it has exactly the same span
+	uint32_t count = 0;
+	uint32_t prevRowStart = 0;
+	bool overflow = false;
+	uint32_t minTX = world->dirtyTilesX, minTY = world->dirtyTilesY, maxTX = 0, maxTY = 0;
+
+	for(uint32_t ty = 0; ty < world->dirtyTilesY; ++ty) {
+		uint8_t const* row = world->dirtyTiles + ty * world->dirtyTilesX;
+		uint32_t const rowStart = count;
+		uint32_t tx = 0;
+		while(tx < world->dirtyTilesX) {
+			if(!(row[tx] & bit)) { ++tx; continue; }
+			uint32_t const runStart = tx;
+			while(tx < world->dirtyTilesX && (row[tx] & bit)) ++tx;
+
+			minTX = (runStart < minTX) ? runStart : minTX;
+			maxTX = (tx - 1 > maxTX) ? tx - 1 : maxTX;
+			minTY = (ty < minTY) ? ty : minTY;
+			maxTY = ty;
+			if(overflow) continue;
+
+			bool merged = false;
+			for(uint32_t i = prevRowStart; i < rowStart; ++i) {
+				World2D_Rect& r = rects[i];
+				if(r.x == runStart && r.width == tx - runStart && r.y + r.height == ty) {
+					r.height++;
+					merged = true;
+					break;
+				}
+			}
+			if(merged) continue;
+
+			if(count == maxRects) {
+				overflow = true;
+				continue;
+			}
+			rects[count++] = { runStart, ty, tx - runStart, 1 };
+		}
+		// merged rects from the row above stay in the window for the next row
+		if(!overflow) {
+			uint32_t keep = rowStart;
+			for(uint32_t i = prevRowStart; i < rowStart; ++i) {
+				if(rects[i].y + rects[i].height == ty + 1) {
+					keep = (i < keep) ? i : keep;
+				}
+			}
+			prevRowStart = keep;
+		}
+	}
+
+	if(overflow) {
+		if(maxRects == 0) return 0;
+		rects[0] = { minTX, minTY, maxTX - minTX + 1, maxTY - minTY + 1 };
+		count = 1;
+	}
+
+	// tiles to cells, clipped to the world
+	for(uint32_t i = 0; i < count; ++i) {
+		World2D_Rect& r = rects[i];
+		uint32_t const x0 = r.x << WORLD2D_DIRTY_TILE_SHIFT;
+		uint32_t const y0 = r.y << WORLD2D_DIRTY_TILE_SHIFT;
+		uint32_t x1 = (r.x + r.width) << WORLD2D_DIRTY_TILE_SHIFT;
+		uint32_t y1 = (r.y + r.height) << WORLD2D_DIRTY_TILE_SHIFT;
+		x1 = (x1 < world->width) ? x1 : world->width;
+		y1 = (y1 < world->height) ? y1 : world->height;
+		r = { x0, y0, x1 - x0, y1 - y0 };
+	}
+	return count;
+}
+
+void World2D_ClearDirty(World2D* world, uint32_t consumer) {
+	ASSERT(world);
+	ASSERT(consumer < WORLD2D_MAX_DIRTY_CONSUMERS);
+	uint8_t const mask = (uint8_t)~(1u << consumer);
+	uint32_t const tileCount = world->dirtyTilesX * world->dirtyTilesY;
+	for(uint32_t t = 0; t < tileCount; ++t) {
+		world->dirtyTiles[t] &= mask;
+	}
+}
+
+void World2D_ClearDirtyTile(World2D* world, uint32_t consumer, uint32_t tileX, uint32_t tileY) {
+	ASSERT(world);
+	ASSERT(consumer < WORLD2D_MAX_DIRTY_CONSUMERS);
+	ASSERT(tileX < world->dirtyTilesX && tileY < world->dirtyTilesY);
+	world->dirtyTiles[tileY * world->dirtyTilesX + tileX] &= (uint8_t)~(1u << consumer);
+}
+
@@ -1,36 +1,240 @@
 // License Summary: MIT see LICENSE file
 #pragma once
 
-#include "al2o3_cmath/vector.hpp"
-#include "render_basics/api.h"
+#include "al2o3_platform/platform.h"
 
+// every channel plane starts on its own cache line and row major rows are
+// padded to a whole number of cache lines
+#define WORLD2D_CACHE_LINE_SIZE 64
+#define WORLD2D_MAX_CHANNELS 8
+
+// changes are tracked per 32x32 cell tile, one byte per tile with a bit per
+// registered consumer so a renderer clearing its view doesn't hide changes
+// from a snapshotter
+#define WORLD2D_DIRTY_TILE_SHIFT 5
+#define WORLD2D_DIRTY_TILE_SIZE (1 << WORLD2D_DIRTY_TILE_SHIFT)
+#define WORLD2D_MAX_DIRTY_CONSUMERS 8
+#define WORLD2D_INVALID_DIRTY_CONSUMER 0xFFFFFFFFu
+
+// tile sleeping, per dirty tile. A tile the step left unchanged, with no
+// changed neighbours and contents the world type says the tick can't disturb,
+// sleeps and the step skips it. Any marked write wakes the tiles it touches
+// and their neighbours, whose halos it's in.
+#define WORLD2D_TILE_ASLEEP 0x1
+// set by the step for the tick in progress, cleared when the tick ends
+#define WORLD2D_TILE_CHANGED 0x2
+#define WORLD2D_TILE_SETTLED 0x4
+
+// tiled layout uses 8x8 element tiles, morton ordered within the tile
+#define WORLD2D_MORTON_TILE_SHIFT 3
+#define WORLD2D_MORTON_TILE_SIZE (1 << WORLD2D_MORTON_TILE_SHIFT)
+
+// each type is described by a World2D_Schema specialisation (world2d_schema.hpp)
 enum WorldType {
 	WT_MOE,
+
+	WT_COUNT
+};
+
+enum World2D_Layout {
+	WL_DEFAULT, // use the layout the world type declares for the channel
+	WL_ROW_MAJOR,
+	WL_TILED_MORTON,
+};
+
+// channels of a WT_MOE world
+enum WorldMOEChannel {
+	WMC_FOOD,				// int16_t
+	WMC_MOISTURE,		// int16_t
+	WMC_PHEROMONE,	// int16_t
+	WMC_OCCUPANCY,	// uint8_t
+
+	WMC_COUNT
+};
+
+struct World2DChannel;
+
+// generated from the world type's schema
+struct World2D_ChannelDesc {
+	char const* name;
+	uint32_t elementSize;
+	World2D_Layout layout;
+	bool doubleBuffered;
+	int32_t defaultValue;
+
+	// sets every element of a plane to defaultValue
+	void (*fill)(void* plane, size_t sizeInBytes);
+	// copies width x height elements between planes of different layouts
+	void (*relayout)(World2DChannel const& from, World2DChannel& to, uint32_t width, uint32_t height);
 };
 
-struct WorldMOE {
-	int16_t food;
+// the channels a world type is made of
+World2D_ChannelDesc const* World2D_TypeChannelDescs(WorldType type, uint32_t* channelCount);
+
+// fills in everything about a width x height world's channel but its planes,
+// WL_DEFAULT takes the desc's layout
+void World2D_DescribeChannel(uint32_t width, uint32_t height, World2D_ChannelDesc const& desc, World2D_Layout layout, World2DChannel& channel);
+
+struct World2DChannel {
+	char const* name;
+	uint32_t elementSize;
+	World2D_Layout layout;
+
+	bool doubleBuffered;
+
+	// row major: elements per row (width padded to a cache line)
+	// tiled morton: width padded to a whole number of tiles
+	uint32_t pitch;
+	uint32_t paddedHeight;
+	size_t sizeInBytes;
+
+	// data is the front plane everyone reads, back is only written by the
+	// world step and swapped with data when a tick completes
+	void* data;
+	void* back;
+};
+
+struct World2D_Rect {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
 };
 
 struct World2D {
+	WorldType type;
 	uint32_t width;
 	uint32_t height;
 
-	void* world;
-	bool dirty;
+	uint32_t channelCount;
+	World2DChannel channels[WORLD2D_MAX_CHANNELS];
+
+	uint64_t tick;
+
+	uint32_t dirtyTilesX;
+	uint32_t dirtyTilesY;
+	uint8_t dirtyConsumersInUse;
+	uint8_t* dirtyTiles;
+
+	// WORLD2D_TILE_ flags per dirty tile
+	uint8_t* tileActivity;
+	uint32_t tilesAsleep;
+
+	// the world, its dirty tiles and planes live in memory owned by someone else
+	bool inArena;
 };
 
-World2D* World2D_Create(WorldType type, uint32_t width, uint32_t height);
+World2D* World2D_Create(WorldType type, uint32_t width, uint32_t height, World2D_Layout layout = WL_DEFAULT);
+// does nothing for arena worlds, their memory goes with the arena
 void World2D_Destroy(World2D* world);
 
-template<typename T> T const * World2D_ElementsAs(World2D const * world) {
-	ASSERT(world);
-	return (T const *)world->world;
+// bytes World2D_CreateInArena needs, a multiple of WORLD2D_CACHE_LINE_SIZE so
+// worlds can be packed back to back
+size_t World2D_ArenaSize(WorldType type, uint32_t width, uint32_t height, World2D_Layout layout = WL_DEFAULT);
+// builds a world entirely inside arena, which must be cache line aligned and
+// World2D_ArenaSize bytes. Can't fail for lack of memory
+World2D* World2D_CreateInArena(WorldType type, uint32_t width, uint32_t height, World2D_Layout layout, void* arena);
+
+// resets every plane to its channel default and marks the whole world dirty,
+// the tick is left alone
+void World2D_Clear(World2D* world);
+
+// flips front and back planes of every double buffered channel and advances the tick
+void World2D_SwapBuffers(World2D* world);
+
+// each consumer (renderer, snapshotter, replicator...) gets its own dirty bit,
+// new consumers start with the whole world dirty
+uint32_t World2D_DirtyConsumerRegister(World2D* world);
+void World2D_DirtyConsumerUnregister(World2D* world, uint32_t consumer);
+
+// wakes tiles [tileX0, tileX1] x [tileY0, tileY1] and their neighbours
+void World2D_WakeTiles(World2D* world, uint32_t tileX0, uint32_t tileY0, uint32_t tileX1, uint32_t tileY1);
+
+inline uint32_t World2D_TilesAsleep(World2D const* world) {
+	return world->tilesAsleep;
+}
+inline uint32_t World2D_TilesActive(World2D const* world) {
+	return world->dirtyTilesX * world->dirtyTilesY - world->tilesAsleep;
+}
+
+// writers mark what they change, marks are seen by every consumer and wake
+// any sleeping tiles nearby. Marking isn't thread safe while tiles are asleep,
+// the world step marks its own changes without waking anything
+void World2D_MarkDirtyRect(World2D* world, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+inline void World2D_MarkDirtyTile(World2D* world, uint32_t tileX, uint32_t tileY) {
+	ASSERT(tileX < world->dirtyTilesX && tileY < world->dirtyTilesY);
+	world->dirtyTiles[tileY * world->dirtyTilesX + tileX] = 0xFF;
+	if(world->tilesAsleep) World2D_WakeTiles(world, tileX, tileY, tileX, tileY);
+}
+
+inline bool World2D_IsTileDirty(World2D const* world, uint32_t consumer, uint32_t tileX, uint32_t tileY) {
+	ASSERT(consumer < WORLD2D_MAX_DIRTY_CONSUMERS);
+	ASSERT(tileX < world->dirtyTilesX && tileY < world->dirtyTilesY);
+	return (world->dirtyTiles[tileY * world->dirtyTilesX + tileX] & (1u << consumer)) != 0;
+}
+bool World2D_IsAnyDirty(World2D const* world, uint32_t consumer);
+
+// coalesces the consumers dirty tiles into cell rectangles clipped to the world.
+// Returns the number written, if more than maxRects would be needed a single
+// bounding rectangle is returned instead
+uint32_t World2D_GetDirtyRects(World2D const* world, uint32_t consumer, World2D_Rect* rects, uint32_t maxRects);
+
+void World2D_ClearDirty(World2D* world, uint32_t consumer);
+void World2D_ClearDirtyTile(World2D* world, uint32_t consumer, uint32_t tileX, uint32_t tileY);
+
+// spreads the low 3 bits of v to the even bits
+inline uint32_t World2D_MortonPart1By1(uint32_t v) {
+	v &= 0x7;
+	v = (v | (v << 2)) & 0x33;
+	v = (v | (v << 1)) & 0x55;
+	return v;
 }
 
-template<typename T> T * World2D_MutableElementsAs(World2D * world) {
+inline size_t World2D_ElementIndex(World2D_Layout layout, uint32_t pitch, uint32_t x, uint32_t y) {
+	if(layout == WL_TILED_MORTON) {
+		size_t const tilesPerRow = pitch >> WORLD2D_MORTON_TILE_SHIFT;
+		size_t const tile = (size_t)(y >> WORLD2D_MORTON_TILE_SHIFT) * tilesPerRow + (x >> WORLD2D_MORTON_TILE_SHIFT);
+		uint32_t const inTile = World2D_MortonPart1By1(x) | (World2D_MortonPart1By1(y) << 1);
+		return (tile << (WORLD2D_MORTON_TILE_SHIFT * 2)) + inTile;
+	} else {
+		return (size_t)y * pitch + x;
+	}
+}
+
+// typed view of a single channel plane
+template<typename T> struct World2D_ChannelView {
+	T* data;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	World2D_Layout layout;
+
+	T& at(uint32_t x, uint32_t y) const {
+		ASSERT(x < width && y < height);
+		return data[World2D_ElementIndex(layout, pitch, x, y)];
+	}
+
+	// rows are only contiguous for row major planes
+	T* row(uint32_t y) const {
+		ASSERT(layout == WL_ROW_MAJOR);
+		ASSERT(y < height);
+		return data + (size_t)y * pitch;
+	}
+};
+
+template<typename T> World2D_ChannelView<T const> World2D_ElementsAs(World2D const * world, uint32_t channel) {
 	ASSERT(world);
-	world->dirty = true;
-	return (T*)world->world;
+	ASSERT(channel < world->channelCount);
+	World2DChannel const& c = world->channels[channel];
+	ASSERT(sizeof(T) == c.elementSize);
+	return { (T const *)c.data, world->width, world->height, c.pitch, c.layout };
 }
 
+// writes through the view must be marked with World2D_MarkDirtyRect
+template<typename T> World2D_ChannelView<T> World2D_MutableElementsAs(World2D * world, uint32_t channel) {
+	ASSERT(world);
+	ASSERT(channel < world->channelCount);
+	World2DChannel const& c = world->channels[channel];
+	ASSERT(sizeof(T) == c.elementSize);
+	return { (T *)c.data, world->width, world->height, c.pitch, c.layout };
+}
@@ -0,0 +1,378 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_aggregate.hpp"
+#include <climits>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t TileSize = WORLD2D_AGGREGATE_TILE_SIZE;
+constexpr uint32_t TileCells = TileSize * TileSize;
+
+World2D_AggregateStats const EmptyStats{INT32_MAX, INT32_MIN, 0};
+
+// runs func over [0, count) ranges on the scheduler, or inline without one
+void ParallelFor(enkiTaskSchedulerHandle scheduler, enkiTaskExecuteRange func, void *args, uint32_t count) {
+	if (count == 0) return;
+	if (!scheduler || count == 1) {
+		func(0, count, 0, args);
+		return;
+	}
+	enkiTaskSetHandle taskSet = enkiCreateTaskSet(scheduler, func);
+	enkiAddTaskSetToPipeMinRange(scheduler, taskSet, args, count, 1);
+	enkiWaitForTaskSet(scheduler, taskSet);
+	enkiDeleteTaskSet(taskSet);
+}
+
+int32_t CellValue(World2DChannel const& channel, uint32_t x, uint32_t y) {
+	size_t const index = World2D_ElementIndex(channel.layout, channel.pitch, x, y);
+	if (channel.elementSize == 1) return ((uint8_t const*) channel.data)[index];
+	return ((int16_t const*) channel.data)[index];
+}
+
+void Accumulate(World2D_AggregateStats& into, World2D_AggregateStats const& from) {
+	if (from.min < into.min) into.min = from.min;
+	if (from.max > into.max) into.max = from.max;
+	into.sum += from.sum;
+}
+
+void AccumulateValue(World2D_AggregateStats& into, int32_t v) {
+	if (v < into.min) into.min = v;
+	if (v > into.max) into.max = v;
+	into.sum += v;
+}
+
+int32_t const* TileSums(World2D_Aggregates const* agg, World2D_AggregateChannel const& c, uint32_t tx, uint32_t ty) {
+	return c.tileSums + ((size_t) ty * agg->tilesX + tx) * TileCells;
+}
+
+// a cell's value recovered from its tile's SAT, so cell level answers agree
+// with the rest of the aggregates rather than the live world
+int32_t CellFromSums(World2D_Aggregates const* agg, World2D_AggregateChannel const& c, uint32_t x, uint32_t y) {
+	int32_t const* sums = TileSums(agg, c, x >> WORLD2D_AGGREGATE_TILE_SHIFT, y >> WORLD2D_AGGREGATE_TILE_SHIFT);
+	uint32_t const lx = x & (TileSize - 1);
+	uint32_t const ly = y & (TileSize - 1);
+	int32_t v = sums[ly * TileSize + lx];
+	if (lx > 0) v -= sums[ly * TileSize + lx - 1];
+	if (ly > 0) v -= sums[(ly - 1) * TileSize + lx];
+	if (lx > 0 && ly > 0) v += sums[(ly - 1) * TileSize + lx - 1];
+	return v;
+}
+
+// sum of the cells in [0, x) x [0, y), x and y up to the world size
+int64_t SumTo(World2D_Aggregates const* agg, World2D_AggregateChannel const& c, uint32_t x, uint32_t y) {
+	uint32_t const tx = x >> WORLD2D_AGGREGATE_TILE_SHIFT;
+	uint32_t const ty = y >> WORLD2D_AGGREGATE_TILE_SHIFT;
+	uint32_t const lx = x & (TileSize - 1);
+	uint32_t const ly = y & (TileSize - 1);
+
+	// whole tiles above and left, then the partial tile column, tile row and tile
+	int64_t sum = c.tileTable[(size_t) ty * (agg->tilesX + 1) + tx];
+	if (lx > 0) sum += c.columnPrefix[((size_t) ty * agg->tilesX + tx) * TileSize + lx - 1];
+	if (ly > 0) sum += c.rowPrefix[((size_t) ty * (agg->tilesX + 1) + tx) * TileSize + ly - 1];
+	if (lx > 0 && ly > 0) sum += TileSums(agg, c, tx, ty)[(ly - 1) * TileSize + lx - 1];
+	return sum;
+}
+
+// entry (nx, ny) of level from the up to four entries under it
+World2D_AggregateStats FilterEntry(World2D const* world, World2DChannel const& channel, World2D_AggregateChannel const& c,
+																	 uint32_t level, uint32_t nx, uint32_t ny) {
+	World2D_AggregateStats stats = EmptyStats;
+	if (level == 1) {
+		for (uint32_t y = ny * 2; y < ny * 2 + 2 && y < world->height; ++y) {
+			for (uint32_t x = nx * 2; x < nx * 2 + 2 && x < world->width; ++x) {
+				AccumulateValue(stats, CellValue(channel, x, y));
+			}
+		}
+	} else {
+		World2D_AggregateLevel const& below = c.levels[level - 1];
+		for (uint32_t y = ny * 2; y < ny * 2 + 2 && y < below.height; ++y) {
+			for (uint32_t x = nx * 2; x < nx * 2 + 2 && x < below.width; ++x) {
+				Accumulate(stats, below.stats[(size_t) y * below.width + x]);
+			}
+		}
+	}
+	return stats;
+}
+
+// the tile's SAT and its pyramid entries up to the tile size
+struct TileTaskArgs {
+	World2D_Aggregates* agg;
+};
+
+void TileTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	World2D_Aggregates* agg = ((TileTaskArgs*) pArgs)->agg;
+	World2D const* world = agg->world;
+
+	for (uint32_t i = start; i < end; ++i) {
+		uint32_t const channelIndex = agg->trackedChannels[i / agg->dirtyCount];
+		uint32_t const tile = agg->dirtyTiles[i % agg->dirtyCount];
+		uint32_t const tx = tile % agg->tilesX;
+		uint32_t const ty = tile / agg->tilesX;
+		World2DChannel const& channel = world->channels[channelIndex];
+		World2D_AggregateChannel& c = agg->channels[channelIndex];
+
+		// cells past the world edge count as 0
+		int32_t* sums = c.tileSums + (size_t) tile * TileCells;
+		for (uint32_t ly = 0; ly < TileSize; ++ly) {
+			uint32_t const y = ty * TileSize + ly;
+			int32_t rowSum = 0;
+			for (uint32_t lx = 0; lx < TileSize; ++lx) {
+				uint32_t const x = tx * TileSize + lx;
+				if (x < world->width && y < world->height) rowSum += CellValue(channel, x, y);
+				sums[ly * TileSize + lx] = rowSum + ((ly > 0) ? sums[(ly - 1) * TileSize + lx] : 0);
+			}
+		}
+
+		for (uint32_t level = 1; level < c.levelCount && level <= WORLD2D_AGGREGATE_TILE_SHIFT; ++level) {
+			World2D_AggregateLevel& l = c.levels[level];
+			uint32_t const perTile = TileSize >> level;
+			for (uint32_t ny = ty * perTile; ny < (ty + 1) * perTile && ny < l.height; ++ny) {
+				for (uint32_t nx = tx * perTile; nx < (tx + 1) * perTile && nx < l.width; ++nx) {
+					l.stats[(size_t) ny * l.width + nx] = FilterEntry(world, channel, c, level, nx, ny);
+				}
+			}
+		}
+	}
+}
+
+// running sums down each changed tile column
+void ColumnTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	World2D_Aggregates* agg = ((TileTaskArgs*) pArgs)->agg;
+
+	for (uint32_t i = start; i < end; ++i) {
+		World2D_AggregateChannel& c = agg->channels[agg->trackedChannels[i / agg->dirtyColumnCount]];
+		uint32_t const tx = agg->dirtyColumns[i % agg->dirtyColumnCount];
+		int64_t running[TileSize] = {};
+		for (uint32_t ty = 0; ty <= agg->tilesY; ++ty) {
+			int64_t* prefix = c.columnPrefix + ((size_t) ty * agg->tilesX + tx) * TileSize;
+			memcpy(prefix, running, sizeof(running));
+			if (ty == agg->tilesY) break;
+			int32_t const* bottomRow = TileSums(agg, c, tx, ty) + (TileSize - 1) * TileSize;
+			for (uint32_t k = 0; k < TileSize; ++k) running[k] += bottomRow[k];
+		}
+	}
+}
+
+// running sums along each changed tile row
+void RowTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	World2D_Aggregates* agg = ((TileTaskArgs*) pArgs)->agg;
+
+	for (uint32_t i = start; i < end; ++i) {
+		World2D_AggregateChannel& c = agg->channels[agg->trackedChannels[i / agg->dirtyRowCount]];
+		uint32_t const ty = agg->dirtyRows[i % agg->dirtyRowCount];
+		int64_t running[TileSize] = {};
+		for (uint32_t tx = 0; tx <= agg->tilesX; ++tx) {
+			int64_t* prefix = c.rowPrefix + ((size_t) ty * (agg->tilesX + 1) + tx) * TileSize;
+			memcpy(prefix, running, sizeof(running));
+			if (tx == agg->tilesX) break;
+			int32_t const* sums = TileSums(agg, c, tx, ty);
+			for (uint32_t k = 0; k < TileSize; ++k) running[k] += sums[k * TileSize + TileSize - 1];
+		}
+	}
+}
+
+// tile totals SAT and the levels coarser than a tile, both about one entry per
+// tile so rebuilding them whole is cheaper than tracking what changed
+void CoarseTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	World2D_Aggregates* agg = ((TileTaskArgs*) pArgs)->agg;
+	World2D const* world = agg->world;
+
+	for (uint32_t i = start; i < end; ++i) {
+		uint32_t const channelIndex = agg->trackedChannels[i];
+		World2D_AggregateChannel& c = agg->channels[channelIndex];
+
+		uint32_t const stride = agg->tilesX + 1;
+		for (uint32_t ty = 1; ty <= agg->tilesY; ++ty) {
+			int64_t rowSum = 0;
+			for (uint32_t tx = 1; tx <= agg->tilesX; ++tx) {
+				rowSum += TileSums(agg, c, tx - 1, ty - 1)[TileCells - 1];
+				c.tileTable[(size_t) ty * stride + tx] = rowSum + c.tileTable[(size_t) (ty - 1) * stride + tx];
+			}
+		}
+
+		for (uint32_t level = WORLD2D_AGGREGATE_TILE_SHIFT + 1; level < c.levelCount; ++level) {
+			World2D_AggregateLevel& l = c.levels[level];
+			for (uint32_t ny = 0; ny < l.height; ++ny) {
+				for (uint32_t nx = 0; nx < l.width; ++nx) {
+					l.stats[(size_t) ny * l.width + nx] = FilterEntry(world, world->channels[channelIndex], c, level, nx, ny);
+				}
+			}
+		}
+	}
+}
+
+void Bounds(World2D_Aggregates const* agg, World2D_AggregateChannel const& c, uint32_t level, uint32_t nx, uint32_t ny,
+						World2D_Rect const& rect, World2D_AggregateStats& stats) {
+	if (level == 0) {
+		if (nx >= rect.x && ny >= rect.y && nx < rect.x + rect.width && ny < rect.y + rect.height) {
+			AccumulateValue(stats, CellFromSums(agg, c, nx, ny));
+		}
+		return;
+	}
+
+	uint32_t const x0 = nx << level;
+	uint32_t const y0 = ny << level;
+	uint32_t x1 = (nx + 1) << level;
+	uint32_t y1 = (ny + 1) << level;
+	if (x1 > agg->world->width) x1 = agg->world->width;
+	if (y1 > agg->world->height) y1 = agg->world->height;
+
+	if (x1 <= rect.x || y1 <= rect.y || x0 >= rect.x + rect.width || y0 >= rect.y + rect.height) return;
+	if (x0 >= rect.x && y0 >= rect.y && x1 <= rect.x + rect.width && y1 <= rect.y + rect.height) {
+		Accumulate(stats, c.levels[level].stats[(size_t) ny * c.levels[level].width + nx]);
+		return;
+	}
+
+	uint32_t const belowWidth = (level == 1) ? agg->world->width : c.levels[level - 1].width;
+	uint32_t const belowHeight = (level == 1) ? agg->world->height : c.levels[level - 1].height;
+	for (uint32_t y = ny * 2; y < ny * 2 + 2 && y < belowHeight; ++y) {
+		for (uint32_t x = nx * 2; x < nx * 2 + 2 && x < belowWidth; ++x) {
+			Bounds(agg, c, level - 1, x, y, rect, stats);
+		}
+	}
+}
+
+} // end anon namespace
+
+World2D_Aggregates* World2D_AggregatesCreate(World2D* world, uint32_t channelMask) {
+	ASSERT(world);
+
+	World2D_Aggregates* agg = (World2D_Aggregates*) MEMORY_CALLOC(1, sizeof(World2D_Aggregates));
+	if (!agg) return nullptr;
+	agg->world = world;
+	agg->consumer = WORLD2D_INVALID_DIRTY_CONSUMER;
+	agg->tilesX = world->dirtyTilesX;
+	agg->tilesY = world->dirtyTilesY;
+
+	size_t const tileCount = (size_t) agg->tilesX * agg->tilesY;
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		if (!(channelMask & (1u << i))) continue;
+		if (world->channels[i].elementSize > 2) {
+			LOGERROR("World2D aggregates only support 8 and 16 bit channels, %s is %u bytes",
+							 world->channels[i].name, world->channels[i].elementSize);
+			goto Fail;
+		}
+
+		World2D_AggregateChannel& c = agg->channels[i];
+		c.tracked = true;
+		agg->trackedChannels[agg->trackedCount++] = i;
+
+		c.tileSums = (int32_t*) MEMORY_MALLOC(tileCount * TileCells * sizeof(int32_t));
+		c.columnPrefix = (int64_t*) MEMORY_MALLOC((size_t) (agg->tilesY + 1) * agg->tilesX * TileSize * sizeof(int64_t));
+		c.rowPrefix = (int64_t*) MEMORY_MALLOC((size_t) agg->tilesY * (agg->tilesX + 1) * TileSize * sizeof(int64_t));
+		// the first row and column stay 0
+		c.tileTable = (int64_t*) MEMORY_CALLOC((size_t) (agg->tilesX + 1) * (agg->tilesY + 1), sizeof(int64_t));
+		if (!c.tileSums || !c.columnPrefix || !c.rowPrefix || !c.tileTable) goto Fail;
+
+		// down to a single entry covering the world
+		c.levelCount = 1;
+		uint32_t width = world->width;
+		uint32_t height = world->height;
+		while (width > 1 || height > 1) {
+			ASSERT(c.levelCount < WORLD2D_AGGREGATE_MAX_LEVELS);
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+			World2D_AggregateLevel& l = c.levels[c.levelCount++];
+			l.width = width;
+			l.height = height;
+			l.stats = (World2D_AggregateStats*) MEMORY_MALLOC((size_t) width * height * sizeof(World2D_AggregateStats));
+			if (!l.stats) goto Fail;
+		}
+	}
+
+	agg->dirtyTiles = (uint32_t*) MEMORY_MALLOC(tileCount * sizeof(uint32_t));
+	agg->dirtyColumns = (uint32_t*) MEMORY_MALLOC(agg->tilesX * sizeof(uint32_t));
+	agg->columnMarks = (uint8_t*) MEMORY_CALLOC(agg->tilesX, sizeof(uint8_t));
+	agg->dirtyRows = (uint32_t*) MEMORY_MALLOC(agg->tilesY * sizeof(uint32_t));
+	if (!agg->dirtyTiles || !agg->dirtyColumns || !agg->columnMarks || !agg->dirtyRows) goto Fail;
+
+	agg->consumer = World2D_DirtyConsumerRegister(world);
+	if (agg->consumer == WORLD2D_INVALID_DIRTY_CONSUMER) goto Fail;
+
+	return agg;
+Fail:
+	World2D_AggregatesDestroy(agg);
+	return nullptr;
+}
+
+void World2D_AggregatesDestroy(World2D_Aggregates* agg) {
+	if (!agg) return;
+	if (agg->consumer != WORLD2D_INVALID_DIRTY_CONSUMER) {
+		World2D_DirtyConsumerUnregister(agg->world, agg->consumer);
+	}
+	for (uint32_t i = 0; i < WORLD2D_MAX_CHANNELS; ++i) {
+		World2D_AggregateChannel& c = agg->channels[i];
+		for (uint32_t level = 1; level < c.levelCount; ++level) {
+			if (c.levels[level].stats) MEMORY_FREE(c.levels[level].stats);
+		}
+		if (c.tileTable) MEMORY_FREE(c.tileTable);
+		if (c.rowPrefix) MEMORY_FREE(c.rowPrefix);
+		if (c.columnPrefix) MEMORY_FREE(c.columnPrefix);
+		if (c.tileSums) MEMORY_FREE(c.tileSums);
+	}
+	if (agg->dirtyRows) MEMORY_FREE(agg->dirtyRows);
+	if (agg->columnMarks) MEMORY_FREE(agg->columnMarks);
+	if (agg->dirtyColumns) MEMORY_FREE(agg->dirtyColumns);
+	if (agg->dirtyTiles) MEMORY_FREE(agg->dirtyTiles);
+	MEMORY_FREE(agg);
+}
+
+void World2D_AggregatesUpdate(World2D_Aggregates* agg, enkiTaskSchedulerHandle scheduler) {
+	ASSERT(agg);
+	World2D* world = agg->world;
+	if (agg->trackedCount == 0 || !World2D_IsAnyDirty(world, agg->consumer)) return;
+
+	// gather and consume the dirty tiles, noting which tile rows and columns
+	// need their running sums redone
+	agg->dirtyCount = 0;
+	agg->dirtyColumnCount = 0;
+	agg->dirtyRowCount = 0;
+	for (uint32_t ty = 0; ty < agg->tilesY; ++ty) {
+		bool rowDirty = false;
+		for (uint32_t tx = 0; tx < agg->tilesX; ++tx) {
+			if (!World2D_IsTileDirty(world, agg->consumer, tx, ty)) continue;
+			World2D_ClearDirtyTile(world, agg->consumer, tx, ty);
+			agg->dirtyTiles[agg->dirtyCount++] = ty * agg->tilesX + tx;
+			rowDirty = true;
+			if (!agg->columnMarks[tx]) {
+				agg->columnMarks[tx] = 1;
+				agg->dirtyColumns[agg->dirtyColumnCount++] = tx;
+			}
+		}
+		if (rowDirty) agg->dirtyRows[agg->dirtyRowCount++] = ty;
+	}
+	for (uint32_t i = 0; i < agg->dirtyColumnCount; ++i) agg->columnMarks[agg->dirtyColumns[i]] = 0;
+
+	// each pass reads only what the one before wrote
+	TileTaskArgs args{agg};
+	ParallelFor(scheduler, &TileTaskFunc, &args, agg->dirtyCount * agg->trackedCount);
+	ParallelFor(scheduler, &ColumnTaskFunc, &args, agg->dirtyColumnCount * agg->trackedCount);
+	ParallelFor(scheduler, &RowTaskFunc, &args, agg->dirtyRowCount * agg->trackedCount);
+	ParallelFor(scheduler, &CoarseTaskFunc, &args, agg->trackedCount);
+}
+
+int64_t World2D_AggregateSum(World2D_Aggregates const* agg, uint32_t channel, World2D_Rect const& rect) {
+	ASSERT(agg);
+	ASSERT(channel < WORLD2D_MAX_CHANNELS && agg->channels[channel].tracked);
+	ASSERT(rect.x + rect.width <= agg->world->width && rect.y + rect.height <= agg->world->height);
+	World2D_AggregateChannel const& c = agg->channels[channel];
+	uint32_t const x1 = rect.x + rect.width;
+	uint32_t const y1 = rect.y + rect.height;
+	return SumTo(agg, c, x1, y1) - SumTo(agg, c, rect.x, y1) - SumTo(agg, c, x1, rect.y) + SumTo(agg, c, rect.x, rect.y);
+}
+
+World2D_AggregateStats World2D_AggregateBounds(World2D_Aggregates const* agg, uint32_t channel, World2D_Rect const& rect) {
+	ASSERT(agg);
+	ASSERT(channel < WORLD2D_MAX_CHANNELS && agg->channels[channel].tracked);
+	ASSERT(rect.width > 0 && rect.height > 0);
+	ASSERT(rect.x + rect.width <= agg->world->width && rect.y + rect.height <= agg->world->height);
+	World2D_AggregateChannel const& c = agg->channels[channel];
+
+	// the top level is a single entry
+	World2D_AggregateStats stats = EmptyStats;
+	Bounds(agg, c, c.levelCount - 1, 0, 0, rect, stats);
+	return stats;
+}
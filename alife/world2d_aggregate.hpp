@@ -0,0 +1,102 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_enki/TaskScheduler_c.h"
+#include "world2d.hpp"
+
+// Region aggregates over World2D channels, kept up to date from the world's
+// dirty tiles so analysis and LOD code don't scan cells.
+//
+// Sums come from a summed-area table split at the dirty tile grid. Each tile
+// holds the SAT of its own cells, and three small tables stitch the tiles
+// together: per tile column the running sum of the tiles above, per tile row
+// the running sum of the tiles to the left and a SAT over whole tile totals.
+// A changed tile only rebuilds its own SAT, its column and row of the stitch
+// tables and the tile totals, yet any rectangle sum is still four O(1) lookups.
+//
+// Min, max and sum are also kept as a pyramid, level L covering 2^L x 2^L
+// cells. Levels up to the tile size are rebuilt inside changed tiles, the
+// coarser ones (about one entry per tile all told) are rebuilt whole.
+#define WORLD2D_AGGREGATE_TILE_SHIFT WORLD2D_DIRTY_TILE_SHIFT
+#define WORLD2D_AGGREGATE_TILE_SIZE WORLD2D_DIRTY_TILE_SIZE
+#define WORLD2D_AGGREGATE_MAX_LEVELS 24
+
+struct World2D_AggregateStats {
+	int32_t min;
+	int32_t max;
+	int64_t sum;
+};
+
+struct World2D_AggregateLevel {
+	uint32_t width;
+	uint32_t height;
+	World2D_AggregateStats* stats;
+};
+
+struct World2D_AggregateChannel {
+	bool tracked;
+
+	// per tile, WORLD2D_AGGREGATE_TILE_SIZE^2 inclusive sums of the tile's cells
+	int32_t* tileSums;
+	// per tile (tilesY + 1 rows), for each local column the sum of that column
+	// and those left of it over every tile above in the same tile column
+	int64_t* columnPrefix;
+	// per tile (tilesX + 1 columns), for each local row the sum of that row and
+	// those above it over every tile to the left in the same tile row
+	int64_t* rowPrefix;
+	// (tilesX + 1) x (tilesY + 1) exclusive SAT of whole tile totals
+	int64_t* tileTable;
+
+	// level 0 is the cells themselves and has no stats
+	uint32_t levelCount;
+	World2D_AggregateLevel levels[WORLD2D_AGGREGATE_MAX_LEVELS];
+};
+
+struct World2D_Aggregates {
+	World2D* world;
+	uint32_t consumer;
+	uint32_t tilesX;
+	uint32_t tilesY;
+
+	// indexed by world channel, untracked channels have nothing allocated
+	World2D_AggregateChannel channels[WORLD2D_MAX_CHANNELS];
+	uint32_t trackedChannels[WORLD2D_MAX_CHANNELS];
+	uint32_t trackedCount;
+
+	// scratch for an update
+	uint32_t dirtyCount;
+	uint32_t* dirtyTiles;
+	uint32_t dirtyColumnCount;
+	uint32_t* dirtyColumns;
+	uint8_t* columnMarks;
+	uint32_t dirtyRowCount;
+	uint32_t* dirtyRows;
+};
+
+// channelMask has a bit per world channel to aggregate, channels of up to 16
+// bits (int16_t or uint8_t) are supported. Everything starts dirty so the first
+// update builds the lot
+World2D_Aggregates* World2D_AggregatesCreate(World2D* world, uint32_t channelMask);
+void World2D_AggregatesDestroy(World2D_Aggregates* agg);
+
+// rebuilds what the tiles dirtied since the last update cover, in parallel on
+// the scheduler if there is one. Queries see the world as of the last update
+void World2D_AggregatesUpdate(World2D_Aggregates* agg, enkiTaskSchedulerHandle scheduler);
+
+// sum of the cells in the rectangle, which must lie inside the world. O(1)
+int64_t World2D_AggregateSum(World2D_Aggregates const* agg, uint32_t channel, World2D_Rect const& rect);
+
+// min, max and sum of the cells in the rectangle, which must lie inside the
+// world and not be empty. Walks the pyramid, O(log n) for a tile or any
+// rectangle aligned to its size, O(perimeter) in general
+World2D_AggregateStats World2D_AggregateBounds(World2D_Aggregates const* agg, uint32_t channel, World2D_Rect const& rect);
+
+// stats of a pyramid entry, level 1 .. levelCount - 1
+inline World2D_AggregateStats const& World2D_AggregateLevelStats(World2D_Aggregates const* agg, uint32_t channel, uint32_t level, uint32_t x, uint32_t y) {
+	ASSERT(channel < WORLD2D_MAX_CHANNELS && agg->channels[channel].tracked);
+	World2D_AggregateChannel const& c = agg->channels[channel];
+	ASSERT(level > 0 && level < c.levelCount);
+	ASSERT(x < c.levels[level].width && y < c.levels[level].height);
+	return c.levels[level].stats[(size_t) y * c.levels[level].width + x];
+}
@@ -0,0 +1,393 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_checkpoint.hpp"
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint64_t AlignUp(uint64_t v, uint64_t alignment) {
+	return (v + alignment - 1) & ~(alignment - 1);
+}
+
+// 4 independent lanes of multiply/rotate over 64 bit words so it runs near
+// memory speed, size must be a multiple of 32 bytes (planes are cache line sized)
+uint64_t Checksum(void const* data, size_t size) {
+	uint64_t const prime = 0x9E3779B185EBCA87ull;
+	uint64_t lanes[4] = {prime, prime + 1, prime + 2, prime + 3};
+	uint64_t const* words = (uint64_t const*) data;
+	size_t const count = size / sizeof(uint64_t);
+	ASSERT((count & 3) == 0);
+	for (size_t i = 0; i < count; i += 4) {
+		for (uint32_t l = 0; l < 4; ++l) {
+			uint64_t v = lanes[l] ^ (words[i + l] * prime);
+			lanes[l] = ((v << 31) | (v >> 33)) * prime;
+		}
+	}
+	uint64_t h = (uint64_t) size;
+	for (uint32_t l = 0; l < 4; ++l) {
+		h = (h ^ lanes[l]) * prime;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+// every byte before the checksum field, zero padded to Checksum's 32 bytes
+uint64_t HeaderChecksum(World2D_CheckpointHeader const* header) {
+	size_t const covered = offsetof(World2D_CheckpointHeader, headerChecksum);
+	uint64_t padded[AlignUp(covered, 32) / sizeof(uint64_t)] = {};
+	memcpy(padded, header, covered);
+	return Checksum(padded, sizeof(padded));
+}
+
+bool WriteZeros(FILE* file, uint64_t count) {
+	static uint8_t const zeros[4096] = {};
+	while (count > 0) {
+		size_t const n = (count > sizeof(zeros)) ? sizeof(zeros) : (size_t) count;
+		if (fwrite(zeros, 1, n, file) != n) return false;
+		count -= n;
+	}
+	return true;
+}
+
+bool ValidateHeader(World2D_CheckpointHeader const* header, uint64_t fileSize, char const* filename) {
+	if (header->magic != WORLD2D_CHECKPOINT_MAGIC) {
+		LOGERROR("%s is not a World2D checkpoint", filename);
+		return false;
+	}
+	if (header->endianTag != WORLD2D_CHECKPOINT_ENDIAN_TAG) {
+		LOGERROR("%s was written with a different endianness", filename);
+		return false;
+	}
+	if (header->version != WORLD2D_CHECKPOINT_VERSION || header->headerSize != sizeof(World2D_CheckpointHeader)) {
+		LOGERROR("%s is checkpoint version %u, expected %u", filename, header->version, WORLD2D_CHECKPOINT_VERSION);
+		return false;
+	}
+	if (header->headerChecksum != HeaderChecksum(header)) {
+		LOGERROR("%s header checksum mismatch", filename);
+		return false;
+	}
+	if (header->fileSize != fileSize) {
+		LOGERROR("%s is truncated (%llu of %llu bytes)", filename,
+						 (unsigned long long) fileSize, (unsigned long long) header->fileSize);
+		return false;
+	}
+
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = World2D_TypeChannelDescs((WorldType) header->type, &descCount);
+	if (!descs || descCount != header->channelCount || header->width == 0 || header->height == 0) {
+		LOGERROR("%s has an unknown world type or channel table", filename);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header->channelCount; ++i) {
+		World2D_CheckpointChannel const& channel = header->channels[i];
+		World2D_ChannelDesc const& desc = descs[i];
+		bool const knownLayout = channel.layout == WL_ROW_MAJOR || channel.layout == WL_TILED_MORTON;
+
+		// the plane must be exactly what the writer lays out for this size, the
+		// mapped view and relayout index it as such
+		World2DChannel expected{};
+		if (knownLayout) {
+			World2D_DescribeChannel(header->width, header->height, desc, (World2D_Layout) channel.layout, expected);
+		}
+
+		bool const valid = knownLayout &&
+				strncmp(channel.name, desc.name, WORLD2D_CHECKPOINT_NAME_SIZE) == 0 &&
+				channel.elementSize == desc.elementSize &&
+				channel.pitch == expected.pitch &&
+				channel.paddedHeight == expected.paddedHeight &&
+				channel.sizeInBytes == expected.sizeInBytes &&
+				(channel.offset % WORLD2D_CHECKPOINT_ALIGNMENT) == 0 &&
+				channel.offset + channel.sizeInBytes <= fileSize;
+		if (!valid) {
+			LOGERROR("%s channel %u (%s) doesn't match world type", filename, i, desc.name);
+			return false;
+		}
+	}
+	return true;
+}
+
+void Unmap(World2D_Checkpoint* checkpoint) {
+#if defined(_WIN32)
+	if (checkpoint->mapping) UnmapViewOfFile(checkpoint->mapping);
+	if (checkpoint->mappingHandle) CloseHandle((HANDLE) checkpoint->mappingHandle);
+	if (checkpoint->fileHandle && checkpoint->fileHandle != INVALID_HANDLE_VALUE) CloseHandle((HANDLE) checkpoint->fileHandle);
+	checkpoint->mappingHandle = nullptr;
+	checkpoint->fileHandle = nullptr;
+#else
+	if (checkpoint->mapping) munmap(checkpoint->mapping, checkpoint->mappingSize);
+	if (checkpoint->fd >= 0) close(checkpoint->fd);
+	checkpoint->fd = -1;
+#endif
+	checkpoint->mapping = nullptr;
+	checkpoint->mappingSize = 0;
+}
+
+// read only private mapping of the whole file
+bool Map(World2D_Checkpoint* checkpoint, char const* filename) {
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+														FILE_ATTRIBUTE_NORMAL, nullptr);
+	checkpoint->fileHandle = file;
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return false;
+	checkpoint->mappingSize = (size_t) size.QuadPart;
+
+	// a write copy section lets the view be flipped to copy on write later
+	checkpoint->mappingHandle = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (!checkpoint->mappingHandle) return false;
+	checkpoint->mapping = MapViewOfFile((HANDLE) checkpoint->mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+	if (!checkpoint->mapping) return false;
+
+	DWORD oldProtect;
+	return VirtualProtect(checkpoint->mapping, checkpoint->mappingSize, PAGE_READONLY, &oldProtect) != 0;
+#else
+	checkpoint->fd = open(filename, O_RDONLY);
+	if (checkpoint->fd < 0) return false;
+
+	struct stat st;
+	if (fstat(checkpoint->fd, &st) != 0 || st.st_size == 0) return false;
+	checkpoint->mappingSize = (size_t) st.st_size;
+
+	void* mapping = mmap(nullptr, checkpoint->mappingSize, PROT_READ, MAP_PRIVATE, checkpoint->fd, 0);
+	if (mapping == MAP_FAILED) return false;
+	checkpoint->mapping = mapping;
+	return true;
+#endif
+}
+
+bool IsInMapping(World2D_Checkpoint const* checkpoint, void const* ptr) {
+	uint8_t const* base = (uint8_t const*) checkpoint->mapping;
+	return ptr >= base && ptr < base + checkpoint->mappingSize;
+}
+
+} // end anon namespace
+
+bool World2D_CheckpointSave(World2D const* world, char const* filename) {
+	ASSERT(world);
+	ASSERT(filename);
+
+	World2D_CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = WORLD2D_CHECKPOINT_MAGIC;
+	header.version = WORLD2D_CHECKPOINT_VERSION;
+	header.endianTag = WORLD2D_CHECKPOINT_ENDIAN_TAG;
+	header.headerSize = sizeof(World2D_CheckpointHeader);
+	header.type = (uint32_t) world->type;
+	header.width = world->width;
+	header.height = world->height;
+	header.channelCount = world->channelCount;
+	header.tick = world->tick;
+
+	uint64_t offset = AlignUp(sizeof(header), WORLD2D_CHECKPOINT_ALIGNMENT);
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		World2DChannel const& src = world->channels[i];
+		World2D_CheckpointChannel& dst = header.channels[i];
+		strncpy(dst.name, src.name, WORLD2D_CHECKPOINT_NAME_SIZE - 1);
+		dst.elementSize = src.elementSize;
+		dst.layout = (uint32_t) src.layout;
+		dst.pitch = src.pitch;
+		dst.paddedHeight = src.paddedHeight;
+		dst.offset = offset;
+		dst.sizeInBytes = src.sizeInBytes;
+		dst.checksum = Checksum(src.data, src.sizeInBytes);
+		offset = AlignUp(offset + src.sizeInBytes, WORLD2D_CHECKPOINT_ALIGNMENT);
+	}
+	header.fileSize = offset;
+	header.headerChecksum = HeaderChecksum(&header);
+
+	FILE* file = fopen(filename, "wb");
+	if (!file) {
+		LOGERROR("Unable to open %s for writing", filename);
+		return false;
+	}
+
+	uint64_t written = sizeof(header);
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (uint32_t i = 0; ok && i < world->channelCount; ++i) {
+		World2D_CheckpointChannel const& channel = header.channels[i];
+		ok = WriteZeros(file, channel.offset - written) &&
+				fwrite(world->channels[i].data, 1, channel.sizeInBytes, file) == channel.sizeInBytes;
+		written = channel.offset + channel.sizeInBytes;
+	}
+	ok = ok && WriteZeros(file, header.fileSize - written);
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok) {
+		LOGERROR("Failed writing checkpoint %s", filename);
+		remove(filename);
+	}
+	return ok;
+}
+
+World2D_Checkpoint* World2D_CheckpointOpen(char const* filename, bool verifyChecksums) {
+	ASSERT(filename);
+	World2D_Checkpoint* checkpoint = (World2D_Checkpoint*) MEMORY_CALLOC(1, sizeof(World2D_Checkpoint));
+	if (!checkpoint) return nullptr;
+#if !defined(_WIN32)
+	checkpoint->fd = -1;
+#endif
+
+	World2D_CheckpointHeader const* header = nullptr;
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = nullptr;
+	World2D* world = nullptr;
+
+	if (!Map(checkpoint, filename)) {
+		LOGERROR("Unable to map checkpoint %s", filename);
+		goto Fail;
+	}
+	if (checkpoint->mappingSize < sizeof(World2D_CheckpointHeader)) {
+		LOGERROR("%s is too small to be a checkpoint", filename);
+		goto Fail;
+	}
+
+	header = (World2D_CheckpointHeader const*) checkpoint->mapping;
+	if (!ValidateHeader(header, checkpoint->mappingSize, filename)) goto Fail;
+
+	if (verifyChecksums) {
+		for (uint32_t i = 0; i < header->channelCount; ++i) {
+			World2D_CheckpointChannel const& channel = header->channels[i];
+			uint8_t const* payload = (uint8_t const*) checkpoint->mapping + channel.offset;
+			if (Checksum(payload, channel.sizeInBytes) != channel.checksum) {
+				LOGERROR("%s channel %s checksum mismatch", filename, channel.name);
+				goto Fail;
+			}
+		}
+	}
+
+	world = (World2D*) MEMORY_CALLOC(1, sizeof(World2D));
+	checkpoint->world = world;
+	if (!world) goto Fail;
+
+	world->type = (WorldType) header->type;
+	world->width = header->width;
+	world->height = header->height;
+	world->tick = header->tick;
+	world->dirtyTilesX = (world->width + WORLD2D_DIRTY_TILE_SIZE - 1) >> WORLD2D_DIRTY_TILE_SHIFT;
+	world->dirtyTilesY = (world->height + WORLD2D_DIRTY_TILE_SIZE - 1) >> WORLD2D_DIRTY_TILE_SHIFT;
+	world->dirtyTiles = (uint8_t*) MEMORY_CALLOC(world->dirtyTilesX * world->dirtyTilesY, sizeof(uint8_t));
+	world->tileActivity = (uint8_t*) MEMORY_CALLOC(world->dirtyTilesX * world->dirtyTilesY, sizeof(uint8_t));
+	if (!world->dirtyTiles || !world->tileActivity) goto Fail;
+
+	descs = World2D_TypeChannelDescs(world->type, &descCount);
+	for (uint32_t i = 0; i < header->channelCount; ++i) {
+		World2D_CheckpointChannel const& src = header->channels[i];
+		World2DChannel& dst = world->channels[i];
+		dst.name = descs[i].name;
+		dst.elementSize = src.elementSize;
+		dst.layout = (World2D_Layout) src.layout;
+		dst.doubleBuffered = descs[i].doubleBuffered;
+		dst.pitch = src.pitch;
+		dst.paddedHeight = src.paddedHeight;
+		dst.sizeInBytes = (size_t) src.sizeInBytes;
+		dst.data = (uint8_t*) checkpoint->mapping + src.offset;
+		dst.back = nullptr;
+	}
+	world->channelCount = header->channelCount;
+
+	return checkpoint;
+Fail:
+	World2D_CheckpointClose(checkpoint);
+	return nullptr;
+}
+
+void World2D_CheckpointClose(World2D_Checkpoint* checkpoint) {
+	if (!checkpoint) return;
+
+	if (checkpoint->world) {
+		// planes in the mapping aren't World2D's to free, after a promote and
+		// some steps a mapped plane may have been swapped to the back
+		for (uint32_t i = 0; i < checkpoint->world->channelCount; ++i) {
+			World2DChannel& channel = checkpoint->world->channels[i];
+			if (IsInMapping(checkpoint, channel.data)) channel.data = nullptr;
+			if (IsInMapping(checkpoint, channel.back)) channel.back = nullptr;
+		}
+		World2D_Destroy(checkpoint->world);
+	}
+
+	Unmap(checkpoint);
+	MEMORY_FREE(checkpoint);
+}
+
+World2D* World2D_CheckpointPromote(World2D_Checkpoint* checkpoint) {
+	ASSERT(checkpoint);
+	if (checkpoint->promoted) return checkpoint->world;
+
+#if defined(_WIN32)
+	DWORD oldProtect;
+	if (!VirtualProtect(checkpoint->mapping, checkpoint->mappingSize, PAGE_WRITECOPY, &oldProtect)) {
+		LOGERROR("Unable to make checkpoint mapping copy on write");
+		return nullptr;
+	}
+#else
+	// the mapping is MAP_PRIVATE so writes copy the page, the file is never touched
+	if (mprotect(checkpoint->mapping, checkpoint->mappingSize, PROT_READ | PROT_WRITE) != 0) {
+		LOGERROR("Unable to make checkpoint mapping copy on write");
+		return nullptr;
+	}
+#endif
+
+	World2D* world = checkpoint->world;
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = World2D_TypeChannelDescs(world->type, &descCount);
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		World2DChannel& channel = world->channels[i];
+		if (!channel.doubleBuffered || channel.back) continue;
+
+		// the step writes every cell of the back plane, default fill only matters for the padding
+		channel.back = MEMORY_AALLOC(channel.sizeInBytes, WORLD2D_CACHE_LINE_SIZE);
+		if (!channel.back) {
+			LOGERROR("Out of memory promoting checkpoint channel %s", channel.name);
+			return nullptr;
+		}
+		descs[i].fill(channel.back, channel.sizeInBytes);
+	}
+
+	checkpoint->promoted = true;
+	return world;
+}
+
+World2D* World2D_CheckpointLoad(char const* filename, bool verifyChecksums) {
+	World2D_Checkpoint* checkpoint = World2D_CheckpointOpen(filename, verifyChecksums);
+	if (!checkpoint) return nullptr;
+
+	World2D const* src = checkpoint->world;
+	World2D* world = World2D_Create(src->type, src->width, src->height);
+	if (!world) {
+		World2D_CheckpointClose(checkpoint);
+		return nullptr;
+	}
+	world->tick = src->tick;
+
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const* descs = World2D_TypeChannelDescs(world->type, &descCount);
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		World2DChannel const& from = src->channels[i];
+		World2DChannel& to = world->channels[i];
+		if (from.layout == to.layout && from.pitch == to.pitch && from.sizeInBytes == to.sizeInBytes) {
+			memcpy(to.data, from.data, to.sizeInBytes);
+			continue;
+		}
+
+		// saved with a different layout, convert element by element
+		descs[i].relayout(from, to, world->width, world->height);
+	}
+	World2D_MarkDirtyRect(world, 0, 0, world->width, world->height);
+
+	World2D_CheckpointClose(checkpoint);
+	return world;
+}
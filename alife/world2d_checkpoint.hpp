@@ -0,0 +1,85 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d.hpp"
+
+// Binary checkpoint of a World2D's front planes. The header and channel
+// table come first, then each channel payload starting on its own
+// WORLD2D_CHECKPOINT_ALIGNMENT boundary so the file can be memory mapped and
+// the planes used in place. Little endian only, the header records the
+// endianness so a mismatch is detected rather than misread.
+#define WORLD2D_CHECKPOINT_MAGIC 0x43443257u	// 'W2DC'
+#define WORLD2D_CHECKPOINT_VERSION 2
+#define WORLD2D_CHECKPOINT_ENDIAN_TAG 0x01020304u
+// 64KB covers both page sizes and the windows mapping granularity
+#define WORLD2D_CHECKPOINT_ALIGNMENT 65536
+#define WORLD2D_CHECKPOINT_NAME_SIZE 32
+
+struct World2D_CheckpointChannel {
+	char name[WORLD2D_CHECKPOINT_NAME_SIZE];
+	uint32_t elementSize;
+	uint32_t layout;
+	uint32_t pitch;
+	uint32_t paddedHeight;
+	uint64_t offset;
+	uint64_t sizeInBytes;
+	uint64_t checksum;
+};
+
+struct World2D_CheckpointHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t endianTag;
+	uint32_t headerSize;
+
+	uint32_t type;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channelCount;
+	uint64_t tick;
+	uint64_t fileSize;
+
+	World2D_CheckpointChannel channels[WORLD2D_MAX_CHANNELS];
+
+	// of every byte above
+	uint64_t headerChecksum;
+};
+
+// writes the world's front planes, dirty state isn't saved
+bool World2D_CheckpointSave(World2D const* world, char const* filename);
+
+// A checkpoint mapped into memory. The world's planes point straight into the
+// mapping, so opening is independent of the world size, pages are faulted in
+// from the file as they are touched. The world starts read only (writing
+// to it will fault), promoting makes the mapping copy on write and gives the
+// double buffered channels back planes so the world can be stepped.
+struct World2D_Checkpoint {
+	World2D* world;
+	bool promoted;
+
+	void* mapping;
+	size_t mappingSize;
+#if defined(_WIN32)
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+};
+
+// verifyChecksums reads every payload, so costs a full pass over the file
+World2D_Checkpoint* World2D_CheckpointOpen(char const* filename, bool verifyChecksums);
+void World2D_CheckpointClose(World2D_Checkpoint* checkpoint);
+
+inline World2D const* World2D_CheckpointWorld(World2D_Checkpoint const* checkpoint) {
+	return checkpoint->world;
+}
+
+// makes the world writable, writes go to private copies of the touched pages
+// and never reach the file. Returns nullptr on failure. The world is owned by
+// the checkpoint and is valid until it is closed.
+World2D* World2D_CheckpointPromote(World2D_Checkpoint* checkpoint);
+
+// loads a checkpoint into a normal heap World2D (a full copy)
+World2D* World2D_CheckpointLoad(char const* filename, bool verifyChecksums);
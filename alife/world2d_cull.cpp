@@ -0,0 +1,98 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_cull.hpp"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#define WORLD2D_CULL_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// a box is outside if its corner furthest along a plane's normal is behind it
+bool BoxOutside(World2D_CullFrustum const* frustum, World2D_CullBoxes const* boxes, uint32_t i) {
+	for (uint32_t p = 0; p < 6; ++p) {
+		float const* plane = frustum->planes[p];
+		float const x = fmaxf(plane[0] * boxes->minX[i], plane[0] * boxes->maxX[i]);
+		float const y = fmaxf(plane[1] * boxes->minY[i], plane[1] * boxes->maxY[i]);
+		float const z = fmaxf(plane[2] * boxes->minZ[i], plane[2] * boxes->maxZ[i]);
+		if (x + y + z + plane[3] < 0.0f) return true;
+	}
+	return false;
+}
+
+} // end anon namespace
+
+void World2D_CullFrustumFromMatrix(float const worldToClip[16], World2D_CullFrustum* frustum) {
+	ASSERT(frustum);
+	// clip component j is world dotted with column j
+	float col[4][4];
+	for (uint32_t j = 0; j < 4; ++j) {
+		for (uint32_t i = 0; i < 4; ++i) col[j][i] = worldToClip[i * 4 + j];
+	}
+
+	for (uint32_t i = 0; i < 4; ++i) {
+		frustum->planes[0][i] = col[3][i] + col[0][i]; // left   -w <= x
+		frustum->planes[1][i] = col[3][i] - col[0][i]; // right   x <= w
+		frustum->planes[2][i] = col[3][i] + col[1][i]; // bottom -w <= y
+		frustum->planes[3][i] = col[3][i] - col[1][i]; // top     y <= w
+		frustum->planes[4][i] = col[2][i];             // 0 <= z
+		frustum->planes[5][i] = col[3][i] - col[2][i]; // z <= w
+	}
+
+	// normalising isn't needed for the sign test but keeps the d terms in world
+	// units, a degenerate plane (an infinite far plane) is left as is
+	for (uint32_t p = 0; p < 6; ++p) {
+		float* plane = frustum->planes[p];
+		float const length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 1e-12f) {
+			for (uint32_t i = 0; i < 4; ++i) plane[i] /= length;
+		}
+	}
+}
+
+uint32_t World2D_CullBoxesVisible(World2D_CullFrustum const* frustum, World2D_CullBoxes const* boxes, uint32_t count, uint32_t* visible) {
+	ASSERT(frustum);
+	ASSERT(boxes);
+	ASSERT(visible);
+
+	uint32_t visibleCount = 0;
+	uint32_t i = 0;
+
+#if WORLD2D_CULL_SSE
+	for (; i + 4 <= count; i += 4) {
+		__m128 const minX = _mm_loadu_ps(boxes->minX + i);
+		__m128 const minY = _mm_loadu_ps(boxes->minY + i);
+		__m128 const minZ = _mm_loadu_ps(boxes->minZ + i);
+		__m128 const maxX = _mm_loadu_ps(boxes->maxX + i);
+		__m128 const maxY = _mm_loadu_ps(boxes->maxY + i);
+		__m128 const maxZ = _mm_loadu_ps(boxes->maxZ + i);
+
+		__m128 outside = _mm_setzero_ps();
+		for (uint32_t p = 0; p < 6; ++p) {
+			float const* plane = frustum->planes[p];
+			__m128 const a = _mm_set1_ps(plane[0]);
+			__m128 const b = _mm_set1_ps(plane[1]);
+			__m128 const c = _mm_set1_ps(plane[2]);
+			__m128 dist = _mm_set1_ps(plane[3]);
+			dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(a, minX), _mm_mul_ps(a, maxX)));
+			dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(b, minY), _mm_mul_ps(b, maxY)));
+			dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(c, minZ), _mm_mul_ps(c, maxZ)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+		}
+
+		// compact the survivors of this group of four
+		int const inside = ~_mm_movemask_ps(outside) & 0xF;
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			if (inside & (1 << lane)) visible[visibleCount++] = i + lane;
+		}
+	}
+#endif
+
+	for (; i < count; ++i) {
+		if (!BoxOutside(frustum, boxes, i)) visible[visibleCount++] = i;
+	}
+	return visibleCount;
+}
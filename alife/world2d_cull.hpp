@@ -0,0 +1,30 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+
+// View frustum culling of axis aligned boxes. The six planes come straight
+// from a world to clip space matrix, boxes are tested four at a time with SSE
+// where it's available and one at a time otherwise.
+struct World2D_CullFrustum {
+	// a b c d, a point is inside when a*x + b*y + c*z + d >= 0 for all six
+	float planes[6][4];
+};
+
+// boxes laid out as separate arrays so four can be loaded at once
+struct World2D_CullBoxes {
+	float const* minX;
+	float const* minY;
+	float const* minZ;
+	float const* maxX;
+	float const* maxY;
+	float const* maxZ;
+};
+
+// worldToClip is row vector (clip = world * m) and row major, as
+// Render_GpuView::worldToNDCMatrix is. Clip z runs 0 to w
+void World2D_CullFrustumFromMatrix(float const worldToClip[16], World2D_CullFrustum* frustum);
+
+// writes the indices of boxes at least partly inside the frustum to visible
+// in ascending order and returns how many there are
+uint32_t World2D_CullBoxesVisible(World2D_CullFrustum const* frustum, World2D_CullBoxes const* boxes, uint32_t count, uint32_t* visible);
@@ -0,0 +1,145 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_ensemble.hpp"
+#include <climits>
+
+namespace {
+
+struct EnsembleTaskArgs {
+	World2D_Ensemble* ensemble;
+	uint32_t steps;
+	uint32_t tilesPerWorld;
+};
+
+// min, max and sum of the world's 16 bit channels
+void SummariseWorld(World2D_Ensemble* ensemble, uint32_t index) {
+	World2D const* world = ensemble->worlds[index];
+	World2D_AggregateStats* stats = ensemble->stats + (size_t) index * WORLD2D_MAX_CHANNELS;
+
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2DChannel const& channel = world->channels[c];
+		if (channel.elementSize != sizeof(int16_t)) continue;
+
+		World2D_AggregateStats s{INT32_MAX, INT32_MIN, 0};
+		auto const view = World2D_ElementsAs<int16_t>(world, c);
+		for (uint32_t y = 0; y < world->height; ++y) {
+			for (uint32_t x = 0; x < world->width; ++x) {
+				int32_t const v = view.at(x, y);
+				if (v < s.min) s.min = v;
+				if (v > s.max) s.max = v;
+				s.sum += v;
+			}
+		}
+		stats[c] = s;
+	}
+}
+
+// each entry is a whole world stepped through every tick
+void WorldTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	EnsembleTaskArgs const* args = (EnsembleTaskArgs const*) pArgs;
+	for (uint32_t i = start; i < end; ++i) {
+		for (uint32_t s = 0; s < args->steps; ++s) {
+			World2D_Step(args->ensemble->worlds[i], nullptr, &args->ensemble->params[i]);
+		}
+		SummariseWorld(args->ensemble, i);
+	}
+}
+
+// each entry is one step tile of one world
+void TileTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	EnsembleTaskArgs const* args = (EnsembleTaskArgs const*) pArgs;
+	for (uint32_t i = start; i < end; ++i) {
+		uint32_t const index = i / args->tilesPerWorld;
+		World2D_StepTile(args->ensemble->worlds[index], &args->ensemble->params[index], i % args->tilesPerWorld);
+	}
+}
+
+void SummariseTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	EnsembleTaskArgs const* args = (EnsembleTaskArgs const*) pArgs;
+	for (uint32_t i = start; i < end; ++i) {
+		SummariseWorld(args->ensemble, i);
+	}
+}
+
+void RunTaskSet(enkiTaskSchedulerHandle scheduler, enkiTaskExecuteRange func, void *args, uint32_t count) {
+	enkiTaskSetHandle taskSet = enkiCreateTaskSet(scheduler, func);
+	enkiAddTaskSetToPipeMinRange(scheduler, taskSet, args, count, 1);
+	enkiWaitForTaskSet(scheduler, taskSet);
+	enkiDeleteTaskSet(taskSet);
+}
+
+} // end anon namespace
+
+World2D_Ensemble* World2D_EnsembleCreate(WorldType type, uint32_t worldCount, uint32_t width, uint32_t height, World2D_Layout layout) {
+	ASSERT(worldCount > 0);
+
+	World2D_Ensemble* ensemble = (World2D_Ensemble*) MEMORY_CALLOC(1, sizeof(World2D_Ensemble));
+	if (!ensemble) return nullptr;
+	ensemble->type = type;
+	ensemble->width = width;
+	ensemble->height = height;
+	ensemble->worldCount = worldCount;
+
+	ensemble->worldBytes = World2D_ArenaSize(type, width, height, layout);
+	ensemble->arena = MEMORY_AALLOC(ensemble->worldBytes * worldCount, WORLD2D_CACHE_LINE_SIZE);
+	ensemble->worlds = (World2D**) MEMORY_CALLOC(worldCount, sizeof(World2D*));
+	ensemble->params = (World2D_StepParams*) MEMORY_CALLOC(worldCount, sizeof(World2D_StepParams));
+	ensemble->stats = (World2D_AggregateStats*) MEMORY_CALLOC((size_t) worldCount * WORLD2D_MAX_CHANNELS, sizeof(World2D_AggregateStats));
+	if (!ensemble->arena || !ensemble->worlds || !ensemble->params || !ensemble->stats) goto Fail;
+
+	for (uint32_t i = 0; i < worldCount; ++i) {
+		void* const memory = (uint8_t*) ensemble->arena + ensemble->worldBytes * i;
+		ensemble->worlds[i] = World2D_CreateInArena(type, width, height, layout, memory);
+		if (!ensemble->worlds[i]) goto Fail;
+
+		World2D_StepParamsDefaults(&ensemble->params[i]);
+		ensemble->params[i].seed += i;
+		SummariseWorld(ensemble, i);
+	}
+
+	return ensemble;
+Fail:
+	World2D_EnsembleDestroy(ensemble);
+	return nullptr;
+}
+
+void World2D_EnsembleDestroy(World2D_Ensemble* ensemble) {
+	if (!ensemble) return;
+	if (ensemble->stats) MEMORY_FREE(ensemble->stats);
+	if (ensemble->params) MEMORY_FREE(ensemble->params);
+	if (ensemble->worlds) MEMORY_FREE(ensemble->worlds);
+	if (ensemble->arena) MEMORY_FREE(ensemble->arena);
+	MEMORY_FREE(ensemble);
+}
+
+void World2D_EnsembleStep(World2D_Ensemble* ensemble, enkiTaskSchedulerHandle scheduler, uint32_t steps) {
+	ASSERT(ensemble);
+	if (steps == 0) return;
+
+	EnsembleTaskArgs args{ensemble, steps, 0};
+	uint32_t const threads = scheduler ? enkiGetNumTaskThreads(scheduler) : 1;
+
+	if (!scheduler || ensemble->worldCount >= threads * WORLD2D_ENSEMBLE_WORLDS_PER_THREAD) {
+		// whole worlds per entry, no sync until every tick is done
+		if (scheduler) {
+			RunTaskSet(scheduler, &WorldTaskFunc, &args, ensemble->worldCount);
+		} else {
+			WorldTaskFunc(0, ensemble->worldCount, 0, &args);
+		}
+		return;
+	}
+
+	// too few worlds to keep every thread busy, spread each tick over every
+	// world's tiles and swap the worlds between ticks
+	World2D const* first = ensemble->worlds[0];
+	args.tilesPerWorld = World2D_StepTileCountX(first) * World2D_StepTileCountY(first);
+	for (uint32_t s = 0; s < steps; ++s) {
+		RunTaskSet(scheduler, &TileTaskFunc, &args, ensemble->worldCount * args.tilesPerWorld);
+		for (uint32_t i = 0; i < ensemble->worldCount; ++i) {
+			World2D_StepFinish(ensemble->worlds[i]);
+		}
+	}
+	RunTaskSet(scheduler, &SummariseTaskFunc, &args, ensemble->worldCount);
+}
@@ -0,0 +1,62 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_enki/TaskScheduler_c.h"
+#include "world2d.hpp"
+#include "world2d_step.hpp"
+#include "world2d_aggregate.hpp"
+
+// Many small independent worlds of the same size stepped together, for
+// parameter sweeps. The worlds live back to back in one arena and each has its
+// own step params. Small worlds are too little work to split into tiles, so
+// with enough worlds to go round every task steps whole worlds through all
+// the requested ticks with no sync between them. With fewer worlds than that
+// each tick is spread over every world's tiles instead.
+//
+// After a step every world's 16 bit channels are summarised (min, max, sum)
+// by the task that stepped it, while its planes are still in cache.
+
+// whole worlds per task are used when there are at least this many worlds per thread
+#define WORLD2D_ENSEMBLE_WORLDS_PER_THREAD 2
+
+struct World2D_Ensemble {
+	WorldType type;
+	uint32_t width;
+	uint32_t height;
+	uint32_t worldCount;
+
+	void* arena;
+	size_t worldBytes;
+	World2D** worlds;
+
+	// per world, defaults with seed + world index so members don't share draws
+	World2D_StepParams* params;
+
+	// worldCount x WORLD2D_MAX_CHANNELS, only 16 bit channels are filled in
+	World2D_AggregateStats* stats;
+};
+
+World2D_Ensemble* World2D_EnsembleCreate(WorldType type, uint32_t worldCount, uint32_t width, uint32_t height,
+																				 World2D_Layout layout = WL_DEFAULT);
+void World2D_EnsembleDestroy(World2D_Ensemble* ensemble);
+
+// steps every world steps ticks, then refreshes the stats. Runs inline without
+// a scheduler. Each world's result is the same as stepping it alone
+void World2D_EnsembleStep(World2D_Ensemble* ensemble, enkiTaskSchedulerHandle scheduler, uint32_t steps);
+
+inline World2D* World2D_EnsembleWorld(World2D_Ensemble const* ensemble, uint32_t index) {
+	ASSERT(index < ensemble->worldCount);
+	return ensemble->worlds[index];
+}
+
+inline World2D_StepParams* World2D_EnsembleParams(World2D_Ensemble* ensemble, uint32_t index) {
+	ASSERT(index < ensemble->worldCount);
+	return &ensemble->params[index];
+}
+
+inline World2D_AggregateStats const& World2D_EnsembleStats(World2D_Ensemble const* ensemble, uint32_t index, uint32_t channel) {
+	ASSERT(index < ensemble->worldCount);
+	ASSERT(channel < WORLD2D_MAX_CHANNELS);
+	return ensemble->stats[(size_t) index * WORLD2D_MAX_CHANNELS + channel];
+}
@@ -0,0 +1,286 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_fork.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+size_t AlignUp(size_t v, size_t alignment) {
+	return (v + alignment - 1) & ~(alignment - 1);
+}
+
+// heap header, dirty tiles and activity for a world whose planes live elsewhere
+World2D* CreateWorldHeader(World2D const* from) {
+	World2D* world = (World2D*) MEMORY_CALLOC(1, sizeof(World2D));
+	if (!world) return nullptr;
+	world->type = from->type;
+	world->width = from->width;
+	world->height = from->height;
+	world->tick = from->tick;
+	world->dirtyTilesX = from->dirtyTilesX;
+	world->dirtyTilesY = from->dirtyTilesY;
+	world->channelCount = from->channelCount;
+	memcpy(world->channels, from->channels, sizeof(World2DChannel) * from->channelCount);
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		world->channels[i].data = nullptr;
+		world->channels[i].back = nullptr;
+	}
+
+	world->dirtyTiles = (uint8_t*) MEMORY_CALLOC(world->dirtyTilesX * world->dirtyTilesY, sizeof(uint8_t));
+	world->tileActivity = (uint8_t*) MEMORY_CALLOC(world->dirtyTilesX * world->dirtyTilesY, sizeof(uint8_t));
+	if (!world->dirtyTiles || !world->tileActivity) {
+		World2D_Destroy(world);
+		return nullptr;
+	}
+	return world;
+}
+
+// the planes aren't World2D's to free
+void DestroyWorldHeader(World2D* world) {
+	if (!world) return;
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		world->channels[i].data = nullptr;
+		world->channels[i].back = nullptr;
+	}
+	World2D_Destroy(world);
+}
+
+size_t PlaneOffset(World2D const* world, uint32_t channel) {
+	size_t offset = 0;
+	for (uint32_t i = 0; i < channel; ++i) {
+		offset += AlignUp(world->channels[i].sizeInBytes, WORLD2D_FORK_PLANE_ALIGNMENT);
+	}
+	return offset;
+}
+
+// anonymous shared memory holding the snapshot, mapped read/write
+bool CreateSnapshot(World2D_ForkSource* source) {
+#if defined(_WIN32)
+	uint64_t const size = (uint64_t) source->snapshotSize;
+	source->mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+																						 (DWORD) (size >> 32), (DWORD) size, nullptr);
+	if (!source->mappingHandle) return false;
+	source->snapshot = MapViewOfFile((HANDLE) source->mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
+	return source->snapshot != nullptr;
+#else
+#if defined(__linux__)
+	source->fd = memfd_create("world2d_fork", MFD_CLOEXEC);
+#else
+	// unlinked straight away, only the descriptor keeps it alive
+	char name[64];
+	snprintf(name, sizeof(name), "/world2d_fork_%d_%p", (int) getpid(), (void*) source);
+	source->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (source->fd >= 0) shm_unlink(name);
+#endif
+	if (source->fd < 0) return false;
+	if (ftruncate(source->fd, (off_t) source->snapshotSize) != 0) return false;
+
+	void* mapping = mmap(nullptr, source->snapshotSize, PROT_READ | PROT_WRITE, MAP_SHARED, source->fd, 0);
+	if (mapping == MAP_FAILED) return false;
+	source->snapshot = mapping;
+	return true;
+#endif
+}
+
+// once filled the snapshot must never change under the private views
+bool ProtectSnapshot(World2D_ForkSource* source) {
+#if defined(_WIN32)
+	DWORD oldProtect;
+	return VirtualProtect(source->snapshot, source->snapshotSize, PAGE_READONLY, &oldProtect) != 0;
+#else
+	return mprotect(source->snapshot, source->snapshotSize, PROT_READ) == 0;
+#endif
+}
+
+void DestroySnapshot(World2D_ForkSource* source) {
+#if defined(_WIN32)
+	if (source->snapshot) UnmapViewOfFile(source->snapshot);
+	if (source->mappingHandle) CloseHandle((HANDLE) source->mappingHandle);
+	source->mappingHandle = nullptr;
+#else
+	if (source->snapshot) munmap(source->snapshot, source->snapshotSize);
+	if (source->fd >= 0) close(source->fd);
+	source->fd = -1;
+#endif
+	source->snapshot = nullptr;
+}
+
+// a copy on write view of the whole snapshot
+void* MapPrivateView(World2D_ForkSource const* source) {
+#if defined(_WIN32)
+	return MapViewOfFile((HANDLE) source->mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+#else
+	void* view = mmap(nullptr, source->snapshotSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, source->fd, 0);
+	return (view == MAP_FAILED) ? nullptr : view;
+#endif
+}
+
+void UnmapPrivateView(World2D_ForkSource const* source, void* view) {
+	if (!view) return;
+#if defined(_WIN32)
+	UnmapViewOfFile(view);
+#else
+	munmap(view, source->snapshotSize);
+#endif
+}
+
+bool TileDiffers(World2D const* a, World2D const* b, uint32_t tileX, uint32_t tileY) {
+	uint32_t const x0 = tileX << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const y0 = tileY << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const x1 = (x0 + WORLD2D_DIRTY_TILE_SIZE < a->width) ? x0 + WORLD2D_DIRTY_TILE_SIZE : a->width;
+	uint32_t const y1 = (y0 + WORLD2D_DIRTY_TILE_SIZE < a->height) ? y0 + WORLD2D_DIRTY_TILE_SIZE : a->height;
+
+	for (uint32_t c = 0; c < a->channelCount; ++c) {
+		World2DChannel const& ca = a->channels[c];
+		World2DChannel const& cb = b->channels[c];
+		uint8_t const* pa = (uint8_t const*) ca.data;
+		uint8_t const* pb = (uint8_t const*) cb.data;
+		uint32_t const es = ca.elementSize;
+
+		if (ca.layout == WL_ROW_MAJOR) {
+			for (uint32_t y = y0; y < y1; ++y) {
+				size_t const offset = ((size_t) y * ca.pitch + x0) * es;
+				if (memcmp(pa + offset, pb + offset, (x1 - x0) * es) != 0) return true;
+			}
+		} else {
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = x0; x < x1; ++x) {
+					size_t const offset = World2D_ElementIndex(ca.layout, ca.pitch, x, y) * es;
+					if (memcmp(pa + offset, pb + offset, es) != 0) return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+} // end anon namespace
+
+World2D_ForkSource* World2D_ForkSourceCreate(World2D const* world) {
+	ASSERT(world);
+	World2D_ForkSource* source = (World2D_ForkSource*) MEMORY_CALLOC(1, sizeof(World2D_ForkSource));
+	if (!source) return nullptr;
+	source->refCount = 1;
+#if !defined(_WIN32)
+	source->fd = -1;
+#endif
+
+	source->world = CreateWorldHeader(world);
+	if (!source->world) goto Fail;
+	memcpy(source->world->tileActivity, world->tileActivity, world->dirtyTilesX * world->dirtyTilesY);
+	source->world->tilesAsleep = world->tilesAsleep;
+
+	source->snapshotSize = PlaneOffset(world, world->channelCount);
+	if (!CreateSnapshot(source)) {
+		LOGERROR("Unable to create a %zu byte World2D fork snapshot", source->snapshotSize);
+		goto Fail;
+	}
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		uint8_t* plane = (uint8_t*) source->snapshot + PlaneOffset(world, i);
+		memcpy(plane, world->channels[i].data, world->channels[i].sizeInBytes);
+		source->world->channels[i].data = plane;
+	}
+	if (!ProtectSnapshot(source)) {
+		LOGERROR("Unable to make the World2D fork snapshot read only");
+		goto Fail;
+	}
+
+	return source;
+Fail:
+	World2D_ForkSourceRelease(source);
+	return nullptr;
+}
+
+void World2D_ForkSourceRelease(World2D_ForkSource* source) {
+	if (!source) return;
+	ASSERT(source->refCount > 0);
+	if (--source->refCount > 0) return;
+
+	DestroyWorldHeader(source->world);
+	DestroySnapshot(source);
+	MEMORY_FREE(source);
+}
+
+World2D_Fork* World2D_ForkCreate(World2D_ForkSource* source, bool keepSleep) {
+	ASSERT(source);
+	World2D_Fork* fork = (World2D_Fork*) MEMORY_CALLOC(1, sizeof(World2D_Fork));
+	if (!fork) return nullptr;
+	fork->source = source;
+	source->refCount++;
+	fork->changedConsumer = WORLD2D_INVALID_DIRTY_CONSUMER;
+
+	World2D const* from = source->world;
+	World2D* world = CreateWorldHeader(from);
+	fork->world = world;
+	if (!world) goto Fail;
+
+	fork->views[0] = MapPrivateView(source);
+	fork->views[1] = MapPrivateView(source);
+	if (!fork->views[0] || !fork->views[1]) {
+		LOGERROR("Unable to map a World2D fork view");
+		goto Fail;
+	}
+
+	// front and back start as the same snapshot pages, which is what a
+	// sleeping tile needs, awake tiles rewrite their back cells next step
+	for (uint32_t i = 0; i < world->channelCount; ++i) {
+		size_t const offset = PlaneOffset(from, i);
+		world->channels[i].data = (uint8_t*) fork->views[0] + offset;
+		if (world->channels[i].doubleBuffered) {
+			world->channels[i].back = (uint8_t*) fork->views[1] + offset;
+		}
+	}
+
+	if (keepSleep) {
+		memcpy(world->tileActivity, from->tileActivity, from->dirtyTilesX * from->dirtyTilesY);
+		world->tilesAsleep = from->tilesAsleep;
+	}
+
+	fork->changedConsumer = World2D_DirtyConsumerRegister(world);
+	if (fork->changedConsumer == WORLD2D_INVALID_DIRTY_CONSUMER) goto Fail;
+	World2D_ClearDirty(world, fork->changedConsumer);
+
+	return fork;
+Fail:
+	World2D_ForkDestroy(fork);
+	return nullptr;
+}
+
+void World2D_ForkDestroy(World2D_Fork* fork) {
+	if (!fork) return;
+	DestroyWorldHeader(fork->world);
+	UnmapPrivateView(fork->source, fork->views[0]);
+	UnmapPrivateView(fork->source, fork->views[1]);
+	World2D_ForkSourceRelease(fork->source);
+	MEMORY_FREE(fork);
+}
+
+uint32_t World2D_ForkDiff(World2D_Fork const* a, World2D_Fork const* b, uint8_t* tileDiffers) {
+	ASSERT(a);
+	ASSERT(!b || b->source == a->source);
+	World2D const* wa = a->world;
+	World2D const* wb = b ? b->world : a->source->world;
+
+	// tiles neither side changed still hold the snapshot
+	uint32_t count = 0;
+	for (uint32_t ty = 0; ty < wa->dirtyTilesY; ++ty) {
+		for (uint32_t tx = 0; tx < wa->dirtyTilesX; ++tx) {
+			bool const touched = World2D_IsTileDirty(wa, a->changedConsumer, tx, ty) ||
+					(b && World2D_IsTileDirty(wb, b->changedConsumer, tx, ty));
+			bool const differs = touched && TileDiffers(wa, wb, tx, ty);
+			if (tileDiffers) tileDiffers[ty * wa->dirtyTilesX + tx] = differs ? 1 : 0;
+			count += differs ? 1 : 0;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,73 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d.hpp"
+
+// Copy on write branches of a World2D for what-if experiments.
+//
+// A fork source snapshots a world's front planes once into anonymous shared
+// memory. Each fork maps the snapshot privately twice, once for its front
+// planes and once for its back planes. A fork shares every page with the
+// snapshot until it writes that page, so it only costs the pages it has
+// changed. The OS counts page sharers; sources are refcounted by the forks
+// made from them and freed when the last one goes.
+//
+// The step rewrites every awake cell, so a fork only keeps sharing the pages
+// of tiles that stay asleep (WORLD2D_TILE_ASLEEP). With keepSleep a fork
+// starts with the source world's sleeping tiles. That is only valid if the
+// fork's step params settle tiles the same way as the original's. A different
+// seed is fine, a different food capacity isn't. Pages of row major planes
+// span whole rows, so what stays shared is bands of rows with no awake tiles.
+//
+// Each fork tracks the tiles changed since it was made with its own dirty
+// consumer, so a diff only compares tiles that either side has touched.
+//
+// None of this is thread safe, create and destroy forks from one thread.
+
+// planes start on their own page in the snapshot so writes to one never copy
+// the end of another
+#define WORLD2D_FORK_PLANE_ALIGNMENT 4096
+
+struct World2D_ForkSource {
+	uint32_t refCount;
+
+	// read only, planes point into the snapshot and have no back planes
+	World2D* world;
+
+	size_t snapshotSize;
+	void* snapshot;
+#if defined(_WIN32)
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+};
+
+struct World2D_Fork {
+	World2D* world;
+	World2D_ForkSource* source;
+	// dirty consumer marking the tiles changed since the fork was made
+	uint32_t changedConsumer;
+
+	// private views of the snapshot for the front and back planes
+	void* views[2];
+};
+
+// snapshots world's front planes and sleeping tiles, the returned source
+// holds one reference for the caller
+World2D_ForkSource* World2D_ForkSourceCreate(World2D const* world);
+void World2D_ForkSourceRelease(World2D_ForkSource* source);
+
+// a new world equal to the source's snapshot, holding a reference to source
+World2D_Fork* World2D_ForkCreate(World2D_ForkSource* source, bool keepSleep);
+void World2D_ForkDestroy(World2D_Fork* fork);
+
+inline World2D* World2D_ForkWorld(World2D_Fork const* fork) {
+	return fork->world;
+}
+
+// number of dirty tiles whose cells differ between two forks of the same
+// source, b nullptr compares a against the source snapshot. tileDiffers, if
+// not nullptr, gets a byte per dirty tile, 1 where they differ
+uint32_t World2D_ForkDiff(World2D_Fork const* a, World2D_Fork const* b, uint8_t* tileDiffers);
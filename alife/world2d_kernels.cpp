@@ -0,0 +1,210 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WORLD2D_KERNELS_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+void ScalarDiffuse5(int16_t *out, int16_t const *above, int16_t const *row, int16_t const *below, uint32_t count, uint32_t shift) {
+	for (uint32_t x = 0; x < count; ++x) {
+		out[x] = World2D_Diffuse5Cell(row[x], above[x], below[x], (row + 1)[x], (row - 1)[x], shift);
+	}
+}
+
+void ScalarDiffuse9(int16_t *out, int16_t const *above, int16_t const *row, int16_t const *below, uint32_t count, uint32_t shift) {
+	for (uint32_t x = 0; x < count; ++x) {
+		out[x] = World2D_Diffuse9Cell(row[x],
+																	above[x], below[x], (row + 1)[x], (row - 1)[x],
+																	(above - 1)[x], (above + 1)[x], (below - 1)[x], (below + 1)[x],
+																	shift);
+	}
+}
+
+void ScalarDecay(int16_t *inout, uint32_t count, int16_t decay) {
+	for (uint32_t x = 0; x < count; ++x) {
+		inout[x] = World2D_DecayCell(inout[x], decay);
+	}
+}
+
+void ScalarGrow(int16_t *inout, uint32_t count, int16_t growth, int16_t capacity) {
+	for (uint32_t x = 0; x < count; ++x) {
+		inout[x] = World2D_GrowCell(inout[x], growth, capacity);
+	}
+}
+
+#if WORLD2D_KERNELS_X86
+void CpuId(int leaf, int subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, leaf, subleaf);
+	for (int i = 0; i < 4; ++i) regs[i] = (uint32_t) info[i];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t XGetBV0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t) edx << 32) | eax;
+#endif
+}
+
+// both the CPU and the OS (saving the wider registers) must support an ISA
+void DetectIsa(bool &hasAVX2, bool &hasAVX512BW) {
+	hasAVX2 = false;
+	hasAVX512BW = false;
+
+	uint32_t regs[4];
+	CpuId(0, 0, regs);
+	uint32_t const maxLeaf = regs[0];
+	if (maxLeaf < 7) return;
+
+	CpuId(1, 0, regs);
+	bool const osxsave = (regs[2] & (1u << 27)) != 0;
+	bool const avx = (regs[2] & (1u << 28)) != 0;
+	if (!osxsave || !avx) return;
+
+	uint64_t const xcr0 = XGetBV0();
+	bool const osYmm = (xcr0 & 0x6) == 0x6;
+	bool const osZmm = (xcr0 & 0xE6) == 0xE6;
+
+	CpuId(7, 0, regs);
+	hasAVX2 = osYmm && (regs[1] & (1u << 5)) != 0;
+	hasAVX512BW = osZmm && (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 30)) != 0;
+}
+#endif
+
+// small xorshift so the verify rows are the same every run
+uint32_t NextRandom(uint32_t &state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+} // end anon namespace
+
+World2D_Kernels const *World2D_KernelsScalar() {
+	static World2D_Kernels const kernels = {
+			"Scalar",
+			&ScalarDiffuse5,
+			&ScalarDiffuse9,
+			&ScalarDecay,
+			&ScalarGrow,
+	};
+	return &kernels;
+}
+
+bool World2D_KernelsSupported(World2D_Kernels const *kernels) {
+	if (!kernels) return false;
+	if (kernels == World2D_KernelsScalar()) return true;
+
+#if WORLD2D_KERNELS_X86
+	static bool hasAVX2, hasAVX512BW;
+	static bool const detected = (DetectIsa(hasAVX2, hasAVX512BW), true);
+	(void) detected;
+
+	if (kernels == World2D_KernelsSSE2()) return true;
+	if (kernels == World2D_KernelsAVX2()) return hasAVX2;
+	if (kernels == World2D_KernelsAVX512()) return hasAVX512BW;
+#endif
+	return false;
+}
+
+bool World2D_KernelsVerify(World2D_Kernels const *kernels) {
+	if (!World2D_KernelsSupported(kernels)) return false;
+	World2D_Kernels const *ref = World2D_KernelsScalar();
+	if (kernels == ref) return true;
+
+	// odd length to exercise the scalar tails, +2 for the halo either side
+	static uint32_t const MaxCount = 203;
+	int16_t rows[3][MaxCount + 2];
+	int16_t expected[MaxCount];
+	int16_t result[MaxCount];
+
+	uint32_t state = 0x1234567u;
+	for (uint32_t pass = 0; pass < 16; ++pass) {
+		// first passes use the full 16 bit range to hit the saturation paths
+		for (auto &row : rows) {
+			for (int16_t &v : row) {
+				uint32_t const r = NextRandom(state);
+				v = (pass < 8) ? (int16_t) r : (int16_t) (r & 0x1FFF);
+			}
+		}
+		uint32_t const count = MaxCount - pass;
+		uint32_t const shift = pass & 0x7;
+		int16_t const *above = &rows[0][1];
+		int16_t const *row = &rows[1][1];
+		int16_t const *below = &rows[2][1];
+
+		ref->diffuse5(expected, above, row, below, count, shift);
+		kernels->diffuse5(result, above, row, below, count, shift);
+		if (memcmp(expected, result, count * sizeof(int16_t)) != 0) {
+			LOGERROR("World2D %s diffuse5 kernel doesn't match scalar", kernels->name);
+			return false;
+		}
+
+		ref->diffuse9(expected, above, row, below, count, shift);
+		kernels->diffuse9(result, above, row, below, count, shift);
+		if (memcmp(expected, result, count * sizeof(int16_t)) != 0) {
+			LOGERROR("World2D %s diffuse9 kernel doesn't match scalar", kernels->name);
+			return false;
+		}
+
+		int16_t const decay = (int16_t) (NextRandom(state) & 0x7FFF);
+		memcpy(expected, row, count * sizeof(int16_t));
+		memcpy(result, row, count * sizeof(int16_t));
+		ref->decay(expected, count, decay);
+		kernels->decay(result, count, decay);
+		if (memcmp(expected, result, count * sizeof(int16_t)) != 0) {
+			LOGERROR("World2D %s decay kernel doesn't match scalar", kernels->name);
+			return false;
+		}
+
+		int16_t const growth = (int16_t) NextRandom(state);
+		int16_t const capacity = (int16_t) NextRandom(state);
+		memcpy(expected, row, count * sizeof(int16_t));
+		memcpy(result, row, count * sizeof(int16_t));
+		ref->grow(expected, count, growth, capacity);
+		kernels->grow(result, count, growth, capacity);
+		if (memcmp(expected, result, count * sizeof(int16_t)) != 0) {
+			LOGERROR("World2D %s grow kernel doesn't match scalar", kernels->name);
+			return false;
+		}
+	}
+	return true;
+}
+
+World2D_Kernels const *World2D_KernelsBest() {
+	static World2D_Kernels const *best = []() -> World2D_Kernels const * {
+		World2D_Kernels const *candidates[3] = {
+				World2D_KernelsAVX512(),
+				World2D_KernelsAVX2(),
+				World2D_KernelsSSE2(),
+		};
+
+		for (auto const* candidate : candidates) {
+			if (World2D_KernelsVerify(candidate)) {
+				LOGINFO("World2D using %s kernels", candidate->name);
+				return candidate;
+			}
+		}
+		LOGINFO("World2D using Scalar kernels");
+		return World2D_KernelsScalar();
+	}();
+
+	return best;
+}
@@ -0,0 +1,91 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+
+// row kernels for the 16 bit world channels.
+// All variants must give bit identical results to the scalar reference, so
+// every operation is defined in terms that map directly onto 16 bit SIMD
+// lanes (floor averages, saturating add/sub, mulhi).
+//
+// The diffuse kernels read row[-1] and row[count] (and the same for above and
+// below for 9 point), the caller is responsible for those being valid.
+
+struct World2D_Kernels {
+	char const* name;
+
+	// out = c + sat(avg(n,s,e,w) - c) >> shift
+	void (*diffuse5)(int16_t* out, int16_t const* above, int16_t const* row, int16_t const* below, uint32_t count, uint32_t shift);
+	// as diffuse5 but averaging all 8 neighbours
+	void (*diffuse9)(int16_t* out, int16_t const* above, int16_t const* row, int16_t const* below, uint32_t count, uint32_t shift);
+	// v -= (v * decay) >> 16
+	void (*decay)(int16_t* inout, uint32_t count, int16_t decay);
+	// v = min(sat(v + growth), capacity)
+	void (*grow)(int16_t* inout, uint32_t count, int16_t growth, int16_t capacity);
+};
+
+World2D_Kernels const* World2D_KernelsScalar();
+
+// widest variant the CPU supports that passes its self test against the scalar kernels
+World2D_Kernels const* World2D_KernelsBest();
+
+// true if the CPU and OS can run this variant
+bool World2D_KernelsSupported(World2D_Kernels const* kernels);
+
+// runs kernels against the scalar reference on random rows, returns true if bit exact
+bool World2D_KernelsVerify(World2D_Kernels const* kernels);
+
+// per ISA variants, return nullptr if not compiled in
+World2D_Kernels const* World2D_KernelsSSE2();
+World2D_Kernels const* World2D_KernelsAVX2();
+World2D_Kernels const* World2D_KernelsAVX512();
+
+// per cell reference ops, static so that ISA specific translation units
+// never share a copy with generic code through the linker. Also compiled for
+// the device by the CUDA backend
+#if defined(__CUDACC__)
+#define WORLD2D_CELL_OP __host__ __device__
+#else
+#define WORLD2D_CELL_OP
+#endif
+
+static inline WORLD2D_CELL_OP int16_t World2D_Sat16(int32_t v) {
+	return (int16_t) ((v < INT16_MIN) ? INT16_MIN : ((v > INT16_MAX) ? INT16_MAX : v));
+}
+
+// floor((a+b)/2) without leaving 16 bits
+static inline WORLD2D_CELL_OP int16_t World2D_Avg2(int16_t a, int16_t b) {
+	return (int16_t) ((a >> 1) + (b >> 1) + (a & b & 1));
+}
+
+static inline WORLD2D_CELL_OP int16_t World2D_DiffuseTowards(int16_t c, int16_t avg, uint32_t shift) {
+	int16_t const delta = World2D_Sat16((int32_t) avg - c);
+	return World2D_Sat16((int32_t) c + (delta >> shift));
+}
+
+static inline WORLD2D_CELL_OP int16_t World2D_Diffuse5Cell(int16_t c, int16_t n, int16_t s, int16_t e, int16_t w, uint32_t shift) {
+	return World2D_DiffuseTowards(c, World2D_Avg2(World2D_Avg2(n, s), World2D_Avg2(e, w)), shift);
+}
+
+static inline WORLD2D_CELL_OP int16_t World2D_Diffuse9Cell(int16_t c,
+																					 int16_t n, int16_t s, int16_t e, int16_t w,
+																					 int16_t nw, int16_t ne, int16_t sw, int16_t se,
+																					 uint32_t shift) {
+	int16_t const cross = World2D_Avg2(World2D_Avg2(n, s), World2D_Avg2(e, w));
+	int16_t const diag = World2D_Avg2(World2D_Avg2(nw, ne), World2D_Avg2(sw, se));
+	return World2D_DiffuseTowards(c, World2D_Avg2(cross, diag), shift);
+}
+
+static inline WORLD2D_CELL_OP int16_t World2D_DecayCell(int16_t v, int16_t decay) {
+	return (int16_t) (v - (int16_t) (((int32_t) v * decay) >> 16));
+}
+
+static inline WORLD2D_CELL_OP int16_t World2D_GrowCell(int16_t v, int16_t growth, int16_t capacity) {
+	int16_t const grown = World2D_Sat16((int32_t) v + growth);
+	return (grown < capacity) ? grown : capacity;
+}
+
+// grows by amount with a chance of chance/65536, random is the cell's draw
+static inline WORLD2D_CELL_OP int16_t World2D_SproutCell(int16_t v, uint32_t random, uint16_t chance, int16_t amount, int16_t capacity) {
+	return ((random & 0xFFFFu) < chance) ? World2D_GrowCell(v, amount, capacity) : v;
+}
@@ -0,0 +1,51 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_kernels.hpp"
+
+// compiled with AVX-512 F+BW code generation, only called after a runtime CPU check
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+
+namespace {
+
+struct AVX512Ops {
+	using V = __m512i;
+	static constexpr uint32_t Lanes = 32;
+
+	static V load(int16_t const *p) { return _mm512_loadu_si512((void const *) p); }
+	static void store(int16_t *p, V v) { _mm512_storeu_si512((void *) p, v); }
+	static V set1(int16_t v) { return _mm512_set1_epi16(v); }
+	static V add(V a, V b) { return _mm512_add_epi16(a, b); }
+	static V sub(V a, V b) { return _mm512_sub_epi16(a, b); }
+	static V adds(V a, V b) { return _mm512_adds_epi16(a, b); }
+	static V subs(V a, V b) { return _mm512_subs_epi16(a, b); }
+	static V and_(V a, V b) { return _mm512_and_si512(a, b); }
+	static V srai1(V a) { return _mm512_srai_epi16(a, 1); }
+	static V sra(V a, uint32_t shift) { return _mm512_sra_epi16(a, _mm_cvtsi32_si128((int) shift)); }
+	static V mulhi(V a, V b) { return _mm512_mulhi_epi16(a, b); }
+	static V min(V a, V b) { return _mm512_min_epi16(a, b); }
+};
+
+} // end anon namespace
+
+#include "world2d_kernels_simd.inl"
+
+World2D_Kernels const *World2D_KernelsAVX512() {
+	static World2D_Kernels const kernels = {
+			"AVX512",
+			&SimdKernels<AVX512Ops>::Diffuse5,
+			&SimdKernels<AVX512Ops>::Diffuse9,
+			&SimdKernels<AVX512Ops>::Decay,
+			&SimdKernels<AVX512Ops>::Grow,
+	};
+	return &kernels;
+}
+
+#else
+
+World2D_Kernels const *World2D_KernelsAVX512() {
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,86 @@
+// License Summary: MIT see LICENSE file
+// private to the world2d_kernels_<isa>.cpp files, each includes this after
+// defining an Ops struct for its vector width. Everything is in an anonymous
+// namespace so each ISA gets its own copy compiled with its own flags.
+
+namespace {
+
+template<typename Ops>
+struct SimdKernels {
+	using V = typename Ops::V;
+
+	static V Avg2(V a, V b) {
+		return Ops::add(Ops::add(Ops::srai1(a), Ops::srai1(b)), Ops::and_(Ops::and_(a, b), Ops::set1(1)));
+	}
+
+	static V DiffuseTowards(V c, V avg, uint32_t shift) {
+		V const delta = Ops::subs(avg, c);
+		return Ops::adds(c, Ops::sra(delta, shift));
+	}
+
+	static void Diffuse5(int16_t *out, int16_t const *above, int16_t const *row, int16_t const *below, uint32_t count, uint32_t shift) {
+		uint32_t x = 0;
+		for (; x + Ops::Lanes <= count; x += Ops::Lanes) {
+			V const c = Ops::load(row + x);
+			V const n = Ops::load(above + x);
+			V const s = Ops::load(below + x);
+			V const w = Ops::load(row + x - 1);
+			V const e = Ops::load(row + x + 1);
+			Ops::store(out + x, DiffuseTowards(c, Avg2(Avg2(n, s), Avg2(e, w)), shift));
+		}
+		for (; x < count; ++x) {
+			out[x] = World2D_Diffuse5Cell(row[x], above[x], below[x], (row + 1)[x], (row - 1)[x], shift);
+		}
+	}
+
+	static void Diffuse9(int16_t *out, int16_t const *above, int16_t const *row, int16_t const *below, uint32_t count, uint32_t shift) {
+		uint32_t x = 0;
+		for (; x + Ops::Lanes <= count; x += Ops::Lanes) {
+			V const c = Ops::load(row + x);
+			V const n = Ops::load(above + x);
+			V const s = Ops::load(below + x);
+			V const w = Ops::load(row + x - 1);
+			V const e = Ops::load(row + x + 1);
+			V const nw = Ops::load(above + x - 1);
+			V const ne = Ops::load(above + x + 1);
+			V const sw = Ops::load(below + x - 1);
+			V const se = Ops::load(below + x + 1);
+			V const cross = Avg2(Avg2(n, s), Avg2(e, w));
+			V const diag = Avg2(Avg2(nw, ne), Avg2(sw, se));
+			Ops::store(out + x, DiffuseTowards(c, Avg2(cross, diag), shift));
+		}
+		for (; x < count; ++x) {
+			out[x] = World2D_Diffuse9Cell(row[x],
+																		above[x], below[x], (row + 1)[x], (row - 1)[x],
+																		(above - 1)[x], (above + 1)[x], (below - 1)[x], (below + 1)[x],
+																		shift);
+		}
+	}
+
+	static void Decay(int16_t *inout, uint32_t count, int16_t decay) {
+		V const d = Ops::set1(decay);
+		uint32_t x = 0;
+		for (; x + Ops::Lanes <= count; x += Ops::Lanes) {
+			V const v = Ops::load(inout + x);
+			Ops::store(inout + x, Ops::sub(v, Ops::mulhi(v, d)));
+		}
+		for (; x < count; ++x) {
+			inout[x] = World2D_DecayCell(inout[x], decay);
+		}
+	}
+
+	static void Grow(int16_t *inout, uint32_t count, int16_t growth, int16_t capacity) {
+		V const g = Ops::set1(growth);
+		V const cap = Ops::set1(capacity);
+		uint32_t x = 0;
+		for (; x + Ops::Lanes <= count; x += Ops::Lanes) {
+			V const v = Ops::load(inout + x);
+			Ops::store(inout + x, Ops::min(Ops::adds(v, g), cap));
+		}
+		for (; x < count; ++x) {
+			inout[x] = World2D_GrowCell(inout[x], growth, capacity);
+		}
+	}
+};
+
+} // end anon namespace
@@ -0,0 +1,50 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <emmintrin.h>
+
+namespace {
+
+struct SSE2Ops {
+	using V = __m128i;
+	static constexpr uint32_t Lanes = 8;
+
+	static V load(int16_t const *p) { return _mm_loadu_si128((__m128i const *) p); }
+	static void store(int16_t *p, V v) { _mm_storeu_si128((__m128i *) p, v); }
+	static V set1(int16_t v) { return _mm_set1_epi16(v); }
+	static V add(V a, V b) { return _mm_add_epi16(a, b); }
+	static V sub(V a, V b) { return _mm_sub_epi16(a, b); }
+	static V adds(V a, V b) { return _mm_adds_epi16(a, b); }
+	static V subs(V a, V b) { return _mm_subs_epi16(a, b); }
+	static V and_(V a, V b) { return _mm_and_si128(a, b); }
+	static V srai1(V a) { return _mm_srai_epi16(a, 1); }
+	static V sra(V a, uint32_t shift) { return _mm_sra_epi16(a, _mm_cvtsi32_si128((int) shift)); }
+	static V mulhi(V a, V b) { return _mm_mulhi_epi16(a, b); }
+	static V min(V a, V b) { return _mm_min_epi16(a, b); }
+};
+
+} // end anon namespace
+
+#include "world2d_kernels_simd.inl"
+
+World2D_Kernels const *World2D_KernelsSSE2() {
+	static World2D_Kernels const kernels = {
+			"SSE2",
+			&SimdKernels<SSE2Ops>::Diffuse5,
+			&SimdKernels<SSE2Ops>::Diffuse9,
+			&SimdKernels<SSE2Ops>::Decay,
+			&SimdKernels<SSE2Ops>::Grow,
+	};
+	return &kernels;
+}
+
+#else
+
+World2D_Kernels const *World2D_KernelsSSE2() {
+	return nullptr;
+}
+
+#endif
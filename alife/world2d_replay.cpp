@@ -0,0 +1,682 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_replay.hpp"
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define WORLD2D_REPLAY_FRAME_KEYFRAME 0x1u
+
+namespace {
+
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t type;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channelCount;
+	uint32_t tileSize;
+	uint32_t tileBytes;
+	uint32_t keyframeInterval;
+	uint32_t pad;
+};
+
+// followed by tileCount uint32_t tile indices then encodedSize bytes
+struct FrameHeader {
+	uint64_t tick;
+	uint32_t flags;
+	uint32_t tileCount;
+	uint64_t encodedSize;
+};
+
+int Seek64(FILE* file, uint64_t offset) {
+#if defined(_WIN32)
+	return _fseeki64(file, (int64_t) offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t) offset, SEEK_SET);
+#endif
+}
+
+uint32_t TileBytes(World2D const* world) {
+	uint32_t bytes = 0;
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		bytes += world->channels[c].elementSize * WORLD2D_DIRTY_TILE_SIZE * WORLD2D_DIRTY_TILE_SIZE;
+	}
+	return bytes;
+}
+
+// tile data is each channel in turn, row major within the tile. Cells past the
+// world edge are left as they are (zero from the capture buffers)
+void CopyTileFromWorld(World2D const* world, uint32_t tileX, uint32_t tileY, uint8_t* dst) {
+	uint32_t const x0 = tileX << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const y0 = tileY << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const w = (world->width - x0 < WORLD2D_DIRTY_TILE_SIZE) ? world->width - x0 : WORLD2D_DIRTY_TILE_SIZE;
+	uint32_t const h = (world->height - y0 < WORLD2D_DIRTY_TILE_SIZE) ? world->height - y0 : WORLD2D_DIRTY_TILE_SIZE;
+
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2DChannel const& channel = world->channels[c];
+		uint32_t const es = channel.elementSize;
+		uint8_t const* src = (uint8_t const*) channel.data;
+		for (uint32_t y = 0; y < h; ++y) {
+			uint8_t* row = dst + (size_t) y * WORLD2D_DIRTY_TILE_SIZE * es;
+			if (channel.layout == WL_ROW_MAJOR) {
+				memcpy(row, src + World2D_ElementIndex(channel.layout, channel.pitch, x0, y0 + y) * es, (size_t) w * es);
+			} else {
+				for (uint32_t x = 0; x < w; ++x) {
+					memcpy(row + x * es, src + World2D_ElementIndex(channel.layout, channel.pitch, x0 + x, y0 + y) * es, es);
+				}
+			}
+		}
+		dst += (size_t) WORLD2D_DIRTY_TILE_SIZE * WORLD2D_DIRTY_TILE_SIZE * es;
+	}
+}
+
+void CopyTileToWorld(World2D* world, uint32_t tileX, uint32_t tileY, uint8_t const* src) {
+	uint32_t const x0 = tileX << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const y0 = tileY << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const w = (world->width - x0 < WORLD2D_DIRTY_TILE_SIZE) ? world->width - x0 : WORLD2D_DIRTY_TILE_SIZE;
+	uint32_t const h = (world->height - y0 < WORLD2D_DIRTY_TILE_SIZE) ? world->height - y0 : WORLD2D_DIRTY_TILE_SIZE;
+
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2DChannel const& channel = world->channels[c];
+		uint32_t const es = channel.elementSize;
+		uint8_t* dst = (uint8_t*) channel.data;
+		for (uint32_t y = 0; y < h; ++y) {
+			uint8_t const* row = src + (size_t) y * WORLD2D_DIRTY_TILE_SIZE * es;
+			if (channel.layout == WL_ROW_MAJOR) {
+				memcpy(dst + World2D_ElementIndex(channel.layout, channel.pitch, x0, y0 + y) * es, row, (size_t) w * es);
+			} else {
+				for (uint32_t x = 0; x < w; ++x) {
+					memcpy(dst + World2D_ElementIndex(channel.layout, channel.pitch, x0 + x, y0 + y) * es, row + x * es, es);
+				}
+			}
+		}
+		src += (size_t) WORLD2D_DIRTY_TILE_SIZE * WORLD2D_DIRTY_TILE_SIZE * es;
+	}
+	World2D_MarkDirtyTile(world, tileX, tileY);
+}
+
+void XorInto(uint8_t* dst, uint8_t const* a, uint8_t const* b, size_t size) {
+	// tile bytes are always a multiple of 8
+	for (size_t i = 0; i < size; i += 8) {
+		uint64_t va, vb;
+		memcpy(&va, a + i, 8);
+		memcpy(&vb, b + i, 8);
+		va ^= vb;
+		memcpy(dst + i, &va, 8);
+	}
+}
+
+uint8_t* PutVarint(uint8_t* dst, uint64_t v) {
+	while (v >= 0x80) {
+		*dst++ = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	*dst++ = (uint8_t) v;
+	return dst;
+}
+
+bool GetVarint(uint8_t const*& src, uint8_t const* end, uint64_t& v) {
+	v = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		if (src >= end) return false;
+		uint8_t const b = *src++;
+		v |= (uint64_t) (b & 0x7F) << shift;
+		if ((b & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+// worst case is alternating single zero and literal bytes, 3 bytes per 2 in
+size_t RleBound(size_t size) {
+	return size * 2 + 16;
+}
+
+// (zero run, literal count, literals) tokens. XORed tiles are mostly zeros so
+// zero runs are skipped a word at a time, literals end at a run of 4+ zeros
+size_t RleEncode(uint8_t const* src, size_t size, uint8_t* dst) {
+	uint8_t* out = dst;
+	size_t i = 0;
+	while (i < size) {
+		size_t const zeroStart = i;
+		while (i + 8 <= size) {
+			uint64_t word;
+			memcpy(&word, src + i, 8);
+			if (word != 0) break;
+			i += 8;
+		}
+		while (i < size && src[i] == 0) ++i;
+		size_t const zeros = i - zeroStart;
+
+		size_t const literalStart = i;
+		while (i < size) {
+			if (src[i] == 0) {
+				size_t run = 1;
+				while (run < 4 && i + run < size && src[i + run] == 0) ++run;
+				if (run == 4 || i + run == size) break;
+				i += run;
+			} else {
+				++i;
+			}
+		}
+		size_t const literals = i - literalStart;
+
+		out = PutVarint(out, zeros);
+		out = PutVarint(out, literals);
+		memcpy(out, src + literalStart, literals);
+		out += literals;
+	}
+	return (size_t) (out - dst);
+}
+
+bool RleDecode(uint8_t const* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+	uint8_t const* const end = src + srcSize;
+	size_t o = 0;
+	while (src < end) {
+		uint64_t zeros, literals;
+		if (!GetVarint(src, end, zeros) || !GetVarint(src, end, literals)) return false;
+		if (zeros > dstSize - o) return false;
+		memset(dst + o, 0, (size_t) zeros);
+		o += (size_t) zeros;
+		if (literals > dstSize - o || literals > (uint64_t) (end - src)) return false;
+		memcpy(dst + o, src, (size_t) literals);
+		o += (size_t) literals;
+		src += literals;
+	}
+	return o == dstSize;
+}
+
+bool GrowBuffer(uint8_t*& buffer, size_t& capacity, size_t needed) {
+	if (needed <= capacity) return true;
+	uint8_t* newBuffer = (uint8_t*) MEMORY_REALLOC(buffer, needed);
+	if (!newBuffer) return false;
+	buffer = newBuffer;
+	capacity = needed;
+	return true;
+}
+
+// the tiles dirty since the previous captured frame
+struct Slot {
+	uint64_t tick;
+	bool keyframe;
+	uint32_t tileCount;
+	uint32_t* tiles;
+	uint8_t* data;
+	uint32_t tileCapacity;
+};
+
+} // end anon namespace
+
+struct World2D_ReplayRecorder {
+	World2D* world;
+	uint32_t consumer;
+	FILE* file;
+
+	uint32_t tileCount;
+	uint32_t tileBytes;
+	uint32_t keyframeInterval;
+	uint32_t framesSinceKeyframe;
+	bool haveKeyframe;
+
+	uint32_t queueDepth;
+	Slot* slots;
+	uint32_t head;		// next slot capture fills
+	uint32_t tail;		// next slot the encoder takes
+	uint32_t queued;
+	bool quit;
+	std::mutex mutex;
+	std::condition_variable slotQueued;
+	std::thread encoder;
+
+	// encoder thread only. The world as of the last frame, the last keyframe
+	// and the tiles changed since it, which every delta has to carry
+	uint8_t* mirror;
+	uint8_t* keyframe;
+	uint8_t* changedSinceKeyframe;
+	uint32_t* frameTiles;
+	uint8_t* xorBuffer;
+	size_t xorCapacity;
+	uint8_t* encoded;
+	size_t encodedCapacity;
+	std::atomic<bool> writeFailed;
+
+	World2D_ReplayStats stats;
+};
+
+struct World2D_ReplayPlayer {
+	FILE* file;
+	FileHeader header;
+	World2D* world;
+
+	uint32_t tileCount;
+	uint32_t frameCount;
+	uint64_t* frameTicks;
+	uint64_t* frameOffsets;
+	uint32_t* frameKeyframe;	// frame index of each frame's keyframe
+
+	uint8_t* keyframe;
+	int64_t cachedKeyframe;
+	// tiles the current world holds from a delta rather than the keyframe
+	uint32_t* deltaTiles;
+	uint32_t deltaTileCount;
+
+	uint32_t* tiles;
+	uint8_t* decoded;
+	uint8_t* encoded;
+	size_t encodedCapacity;
+};
+
+namespace {
+
+bool EncodeSlot(World2D_ReplayRecorder* recorder, Slot const& slot) {
+	uint32_t const tileBytes = recorder->tileBytes;
+	for (uint32_t i = 0; i < slot.tileCount; ++i) {
+		memcpy(recorder->mirror + (size_t) slot.tiles[i] * tileBytes, slot.data + (size_t) i * tileBytes, tileBytes);
+		recorder->changedSinceKeyframe[slot.tiles[i]] = 1;
+	}
+
+	uint32_t tileCount = 0;
+	uint8_t const* payload = recorder->mirror;
+	if (slot.keyframe) {
+		// keyframes carry every tile in order
+		tileCount = recorder->tileCount;
+		for (uint32_t t = 0; t < tileCount; ++t) {
+			recorder->frameTiles[t] = t;
+		}
+		memcpy(recorder->keyframe, recorder->mirror, (size_t) tileCount * tileBytes);
+		memset(recorder->changedSinceKeyframe, 0, recorder->tileCount);
+	} else {
+		for (uint32_t t = 0; t < recorder->tileCount; ++t) {
+			if (recorder->changedSinceKeyframe[t]) recorder->frameTiles[tileCount++] = t;
+		}
+		if (!GrowBuffer(recorder->xorBuffer, recorder->xorCapacity, (size_t) tileCount * tileBytes)) return false;
+		for (uint32_t i = 0; i < tileCount; ++i) {
+			size_t const offset = (size_t) recorder->frameTiles[i] * tileBytes;
+			XorInto(recorder->xorBuffer + (size_t) i * tileBytes, recorder->mirror + offset, recorder->keyframe + offset, tileBytes);
+		}
+		payload = recorder->xorBuffer;
+	}
+	size_t const rawSize = (size_t) tileCount * tileBytes;
+
+	if (!GrowBuffer(recorder->encoded, recorder->encodedCapacity, RleBound(rawSize))) return false;
+	size_t const encodedSize = RleEncode(payload, rawSize, recorder->encoded);
+
+	FrameHeader const frame{slot.tick, slot.keyframe ? WORLD2D_REPLAY_FRAME_KEYFRAME : 0u, tileCount, encodedSize};
+	bool ok = fwrite(&frame, sizeof(frame), 1, recorder->file) == 1;
+	ok = ok && fwrite(recorder->frameTiles, sizeof(uint32_t), tileCount, recorder->file) == tileCount;
+	ok = ok && fwrite(recorder->encoded, 1, encodedSize, recorder->file) == encodedSize;
+
+	std::lock_guard<std::mutex> lock(recorder->mutex);
+	recorder->stats.framesWritten++;
+	recorder->stats.keyframesWritten += slot.keyframe ? 1 : 0;
+	recorder->stats.rawBytes += rawSize;
+	recorder->stats.encodedBytes += sizeof(frame) + tileCount * sizeof(uint32_t) + encodedSize;
+	return ok;
+}
+
+void EncoderThread(World2D_ReplayRecorder* recorder) {
+	for (;;) {
+		uint32_t slotIndex;
+		{
+			std::unique_lock<std::mutex> lock(recorder->mutex);
+			recorder->slotQueued.wait(lock, [recorder] { return recorder->queued > 0 || recorder->quit; });
+			if (recorder->queued == 0) return;
+			slotIndex = recorder->tail;
+		}
+
+		// the slot stays owned by the encoder until it's released below
+		if (!recorder->writeFailed && !EncodeSlot(recorder, recorder->slots[slotIndex])) {
+			LOGERROR("World2D replay write failed, recording stopped");
+			recorder->writeFailed = true;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(recorder->mutex);
+			recorder->tail = (recorder->tail + 1) % recorder->queueDepth;
+			recorder->queued--;
+		}
+	}
+}
+
+bool ReadFrameHeader(FILE* file, uint64_t offset, FrameHeader& frame) {
+	return Seek64(file, offset) == 0 && fread(&frame, sizeof(frame), 1, file) == 1;
+}
+
+// reads and decodes a frame into player->tiles / player->decoded
+bool ReadFrame(World2D_ReplayPlayer* player, uint32_t frameIndex, FrameHeader& frame) {
+	if (!ReadFrameHeader(player->file, player->frameOffsets[frameIndex], frame)) return false;
+	if (frame.tileCount > player->tileCount) return false;
+	if (fread(player->tiles, sizeof(uint32_t), frame.tileCount, player->file) != frame.tileCount) return false;
+	for (uint32_t i = 0; i < frame.tileCount; ++i) {
+		if (player->tiles[i] >= player->tileCount) return false;
+	}
+	if (!GrowBuffer(player->encoded, player->encodedCapacity, (size_t) frame.encodedSize)) return false;
+	if (fread(player->encoded, 1, (size_t) frame.encodedSize, player->file) != frame.encodedSize) return false;
+	return RleDecode(player->encoded, (size_t) frame.encodedSize, player->decoded,
+									 (size_t) frame.tileCount * player->header.tileBytes);
+}
+
+} // end anon namespace
+
+World2D_ReplayRecorder* World2D_ReplayRecorderCreate(World2D* world, char const* filename,
+																										 uint32_t keyframeInterval, uint32_t queueDepth) {
+	ASSERT(world);
+	ASSERT(filename);
+
+	void* mem = MEMORY_CALLOC(1, sizeof(World2D_ReplayRecorder));
+	if (!mem) return nullptr;
+	World2D_ReplayRecorder* recorder = new(mem) World2D_ReplayRecorder();
+
+	recorder->world = world;
+	recorder->consumer = WORLD2D_INVALID_DIRTY_CONSUMER;
+	recorder->tileCount = world->dirtyTilesX * world->dirtyTilesY;
+	recorder->tileBytes = TileBytes(world);
+	recorder->keyframeInterval = keyframeInterval ? keyframeInterval : 1;
+	recorder->queueDepth = queueDepth ? queueDepth : 1;
+
+	size_t const worldTileBytes = (size_t) recorder->tileCount * recorder->tileBytes;
+	FileHeader header{};
+
+	recorder->mirror = (uint8_t*) MEMORY_CALLOC(worldTileBytes, sizeof(uint8_t));
+	recorder->keyframe = (uint8_t*) MEMORY_MALLOC(worldTileBytes);
+	recorder->changedSinceKeyframe = (uint8_t*) MEMORY_CALLOC(recorder->tileCount, sizeof(uint8_t));
+	recorder->frameTiles = (uint32_t*) MEMORY_CALLOC(recorder->tileCount, sizeof(uint32_t));
+	recorder->slots = (Slot*) MEMORY_CALLOC(recorder->queueDepth, sizeof(Slot));
+	if (!recorder->mirror || !recorder->keyframe || !recorder->changedSinceKeyframe || !recorder->frameTiles || !recorder->slots) {
+		goto Fail;
+	}
+
+	recorder->file = fopen(filename, "wb");
+	if (!recorder->file) {
+		LOGERROR("Unable to open %s for writing", filename);
+		goto Fail;
+	}
+
+	header.magic = WORLD2D_REPLAY_MAGIC;
+	header.version = WORLD2D_REPLAY_VERSION;
+	header.type = (uint32_t) world->type;
+	header.width = world->width;
+	header.height = world->height;
+	header.channelCount = world->channelCount;
+	header.tileSize = WORLD2D_DIRTY_TILE_SIZE;
+	header.tileBytes = recorder->tileBytes;
+	header.keyframeInterval = recorder->keyframeInterval;
+	if (fwrite(&header, sizeof(header), 1, recorder->file) != 1) goto Fail;
+
+	recorder->consumer = World2D_DirtyConsumerRegister(world);
+	if (recorder->consumer == WORLD2D_INVALID_DIRTY_CONSUMER) goto Fail;
+
+	recorder->encoder = std::thread(&EncoderThread, recorder);
+	return recorder;
+Fail:
+	World2D_ReplayRecorderDestroy(recorder);
+	return nullptr;
+}
+
+void World2D_ReplayRecorderDestroy(World2D_ReplayRecorder* recorder) {
+	if (!recorder) return;
+
+	if (recorder->encoder.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(recorder->mutex);
+			recorder->quit = true;
+		}
+		recorder->slotQueued.notify_one();
+		recorder->encoder.join();
+	}
+
+	if (recorder->file) fclose(recorder->file);
+	if (recorder->consumer != WORLD2D_INVALID_DIRTY_CONSUMER) {
+		World2D_DirtyConsumerUnregister(recorder->world, recorder->consumer);
+	}
+
+	if (recorder->slots) {
+		for (uint32_t i = 0; i < recorder->queueDepth; ++i) {
+			if (recorder->slots[i].tiles) MEMORY_FREE(recorder->slots[i].tiles);
+			if (recorder->slots[i].data) MEMORY_FREE(recorder->slots[i].data);
+		}
+		if (recorder->slots) MEMORY_FREE(recorder->slots);
+	}
+	if (recorder->mirror) MEMORY_FREE(recorder->mirror);
+	if (recorder->keyframe) MEMORY_FREE(recorder->keyframe);
+	if (recorder->changedSinceKeyframe) MEMORY_FREE(recorder->changedSinceKeyframe);
+	if (recorder->frameTiles) MEMORY_FREE(recorder->frameTiles);
+	if (recorder->xorBuffer) MEMORY_FREE(recorder->xorBuffer);
+	if (recorder->encoded) MEMORY_FREE(recorder->encoded);
+
+	recorder->~World2D_ReplayRecorder();
+	MEMORY_FREE(recorder);
+}
+
+bool World2D_ReplayRecorderCapture(World2D_ReplayRecorder* recorder) {
+	ASSERT(recorder);
+	World2D* world = recorder->world;
+	if (recorder->writeFailed) return false;
+
+	uint32_t slotIndex;
+	{
+		std::lock_guard<std::mutex> lock(recorder->mutex);
+		if (recorder->queued == recorder->queueDepth) {
+			// the dirty tiles are left for the next frame captured
+			recorder->stats.framesDropped++;
+			return false;
+		}
+		slotIndex = recorder->head;
+	}
+	Slot& slot = recorder->slots[slotIndex];
+
+	// a new consumer starts with everything dirty, so the first frame copies every tile
+	uint32_t tileCount = 0;
+	for (uint32_t t = 0; t < recorder->tileCount; ++t) {
+		tileCount += World2D_IsTileDirty(world, recorder->consumer, t % world->dirtyTilesX, t / world->dirtyTilesX) ? 1 : 0;
+	}
+
+	if (tileCount > slot.tileCapacity) {
+		uint32_t* tiles = (uint32_t*) MEMORY_REALLOC(slot.tiles, tileCount * sizeof(uint32_t));
+		if (tiles) slot.tiles = tiles;
+		uint8_t* data = (uint8_t*) MEMORY_REALLOC(slot.data, (size_t) tileCount * recorder->tileBytes);
+		if (data) slot.data = data;
+		if (!tiles || !data) {
+			LOGERROR("Out of memory capturing replay frame");
+			return false;
+		}
+		slot.tileCapacity = tileCount;
+	}
+
+	slot.tick = world->tick;
+	slot.keyframe = !recorder->haveKeyframe || recorder->framesSinceKeyframe >= recorder->keyframeInterval;
+	slot.tileCount = 0;
+	for (uint32_t t = 0; t < recorder->tileCount; ++t) {
+		uint32_t const tx = t % world->dirtyTilesX;
+		uint32_t const ty = t / world->dirtyTilesX;
+		if (!World2D_IsTileDirty(world, recorder->consumer, tx, ty)) continue;
+		// zeroed so cells past the world edge encode the same every frame
+		uint8_t* dst = slot.data + (size_t) slot.tileCount * recorder->tileBytes;
+		memset(dst, 0, recorder->tileBytes);
+		CopyTileFromWorld(world, tx, ty, dst);
+		slot.tiles[slot.tileCount++] = t;
+	}
+	World2D_ClearDirty(world, recorder->consumer);
+
+	recorder->framesSinceKeyframe = slot.keyframe ? 1 : recorder->framesSinceKeyframe + 1;
+	recorder->haveKeyframe = true;
+
+	{
+		std::lock_guard<std::mutex> lock(recorder->mutex);
+		recorder->head = (recorder->head + 1) % recorder->queueDepth;
+		recorder->queued++;
+	}
+	recorder->slotQueued.notify_one();
+	return true;
+}
+
+void World2D_ReplayRecorderStats(World2D_ReplayRecorder* recorder, World2D_ReplayStats* stats) {
+	ASSERT(recorder);
+	ASSERT(stats);
+	std::lock_guard<std::mutex> lock(recorder->mutex);
+	*stats = recorder->stats;
+}
+
+World2D_ReplayPlayer* World2D_ReplayPlayerOpen(char const* filename) {
+	ASSERT(filename);
+	World2D_ReplayPlayer* player = (World2D_ReplayPlayer*) MEMORY_CALLOC(1, sizeof(World2D_ReplayPlayer));
+	if (!player) return nullptr;
+	player->cachedKeyframe = -1;
+
+	uint32_t frameCapacity = 0;
+	uint64_t offset = sizeof(FileHeader);
+	int64_t lastKeyframe = -1;
+	FrameHeader frame;
+
+	player->file = fopen(filename, "rb");
+	if (!player->file) {
+		LOGERROR("Unable to open replay %s", filename);
+		goto Fail;
+	}
+	if (fread(&player->header, sizeof(FileHeader), 1, player->file) != 1 ||
+			player->header.magic != WORLD2D_REPLAY_MAGIC ||
+			player->header.version != WORLD2D_REPLAY_VERSION ||
+			player->header.tileSize != WORLD2D_DIRTY_TILE_SIZE) {
+		LOGERROR("%s is not a version %u World2D replay", filename, WORLD2D_REPLAY_VERSION);
+		goto Fail;
+	}
+
+	player->world = World2D_Create((WorldType) player->header.type, player->header.width, player->header.height);
+	if (!player->world ||
+			player->world->channelCount != player->header.channelCount ||
+			TileBytes(player->world) != player->header.tileBytes) {
+		LOGERROR("%s world type doesn't match this build", filename);
+		goto Fail;
+	}
+	player->tileCount = player->world->dirtyTilesX * player->world->dirtyTilesY;
+
+	// index every frame, a truncated last frame (recording killed mid write) is ignored
+	while (ReadFrameHeader(player->file, offset, frame)) {
+		uint64_t const next = offset + sizeof(FrameHeader) + frame.tileCount * sizeof(uint32_t) + frame.encodedSize;
+		if (frame.tileCount > player->tileCount) break;
+		if (Seek64(player->file, next - 1) != 0 || fgetc(player->file) == EOF) break;
+
+		if (frame.flags & WORLD2D_REPLAY_FRAME_KEYFRAME) lastKeyframe = player->frameCount;
+		if (lastKeyframe < 0) break;
+
+		if (player->frameCount == frameCapacity) {
+			frameCapacity = frameCapacity ? frameCapacity * 2 : 1024;
+			uint64_t* ticks = (uint64_t*) MEMORY_REALLOC(player->frameTicks, frameCapacity * sizeof(uint64_t));
+			if (ticks) player->frameTicks = ticks;
+			uint64_t* offsets = (uint64_t*) MEMORY_REALLOC(player->frameOffsets, frameCapacity * sizeof(uint64_t));
+			if (offsets) player->frameOffsets = offsets;
+			uint32_t* keyframes = (uint32_t*) MEMORY_REALLOC(player->frameKeyframe, frameCapacity * sizeof(uint32_t));
+			if (keyframes) player->frameKeyframe = keyframes;
+			if (!ticks || !offsets || !keyframes) goto Fail;
+		}
+		player->frameTicks[player->frameCount] = frame.tick;
+		player->frameOffsets[player->frameCount] = offset;
+		player->frameKeyframe[player->frameCount] = (uint32_t) lastKeyframe;
+		player->frameCount++;
+		offset = next;
+	}
+
+	player->keyframe = (uint8_t*) MEMORY_MALLOC((size_t) player->tileCount * player->header.tileBytes);
+	player->decoded = (uint8_t*) MEMORY_MALLOC((size_t) player->tileCount * player->header.tileBytes);
+	player->tiles = (uint32_t*) MEMORY_MALLOC(player->tileCount * sizeof(uint32_t));
+	player->deltaTiles = (uint32_t*) MEMORY_MALLOC(player->tileCount * sizeof(uint32_t));
+	if (!player->keyframe || !player->decoded || !player->tiles || !player->deltaTiles) goto Fail;
+
+	return player;
+Fail:
+	World2D_ReplayPlayerClose(player);
+	return nullptr;
+}
+
+void World2D_ReplayPlayerClose(World2D_ReplayPlayer* player) {
+	if (!player) return;
+	if (player->file) fclose(player->file);
+	World2D_Destroy(player->world);
+	if (player->frameTicks) MEMORY_FREE(player->frameTicks);
+	if (player->frameOffsets) MEMORY_FREE(player->frameOffsets);
+	if (player->frameKeyframe) MEMORY_FREE(player->frameKeyframe);
+	if (player->keyframe) MEMORY_FREE(player->keyframe);
+	if (player->deltaTiles) MEMORY_FREE(player->deltaTiles);
+	if (player->tiles) MEMORY_FREE(player->tiles);
+	if (player->decoded) MEMORY_FREE(player->decoded);
+	if (player->encoded) MEMORY_FREE(player->encoded);
+	MEMORY_FREE(player);
+}
+
+uint32_t World2D_ReplayPlayerFrameCount(World2D_ReplayPlayer const* player) {
+	return player->frameCount;
+}
+
+uint64_t World2D_ReplayPlayerFirstTick(World2D_ReplayPlayer const* player) {
+	return player->frameCount ? player->frameTicks[0] : 0;
+}
+
+uint64_t World2D_ReplayPlayerLastTick(World2D_ReplayPlayer const* player) {
+	return player->frameCount ? player->frameTicks[player->frameCount - 1] : 0;
+}
+
+bool World2D_ReplayPlayerSeek(World2D_ReplayPlayer* player, uint64_t tick) {
+	ASSERT(player);
+
+	// frames are in tick order
+	uint32_t lo = 0, hi = player->frameCount;
+	while (lo < hi) {
+		uint32_t const mid = (lo + hi) / 2;
+		if (player->frameTicks[mid] < tick) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo == player->frameCount || player->frameTicks[lo] != tick) return false;
+
+	uint32_t const frameIndex = lo;
+	uint32_t const keyframeIndex = player->frameKeyframe[frameIndex];
+	uint32_t const tileBytes = player->header.tileBytes;
+	World2D* world = player->world;
+	FrameHeader frame;
+
+	if ((int64_t) keyframeIndex != player->cachedKeyframe) {
+		player->cachedKeyframe = -1;
+		if (!ReadFrame(player, keyframeIndex, frame) || frame.tileCount != player->tileCount) {
+			LOGERROR("World2D replay keyframe %u is corrupt", keyframeIndex);
+			return false;
+		}
+		memcpy(player->keyframe, player->decoded, (size_t) player->tileCount * tileBytes);
+		player->cachedKeyframe = keyframeIndex;
+		for (uint32_t t = 0; t < player->tileCount; ++t) {
+			CopyTileToWorld(world, t % world->dirtyTilesX, t / world->dirtyTilesX, player->keyframe + (size_t) t * tileBytes);
+		}
+	} else {
+		// same keyframe, only the tiles the last delta touched need restoring
+		for (uint32_t i = 0; i < player->deltaTileCount; ++i) {
+			uint32_t const t = player->deltaTiles[i];
+			CopyTileToWorld(world, t % world->dirtyTilesX, t / world->dirtyTilesX, player->keyframe + (size_t) t * tileBytes);
+		}
+	}
+	player->deltaTileCount = 0;
+
+	if (frameIndex != keyframeIndex) {
+		if (!ReadFrame(player, frameIndex, frame)) {
+			LOGERROR("World2D replay frame %u is corrupt", frameIndex);
+			return false;
+		}
+		for (uint32_t i = 0; i < frame.tileCount; ++i) {
+			uint32_t const t = player->tiles[i];
+			uint8_t* tile = player->decoded + (size_t) i * tileBytes;
+			XorInto(tile, tile, player->keyframe + (size_t) t * tileBytes, tileBytes);
+			CopyTileToWorld(world, t % world->dirtyTilesX, t / world->dirtyTilesX, tile);
+			player->deltaTiles[player->deltaTileCount++] = t;
+		}
+	}
+
+	world->tick = tick;
+	return true;
+}
+
+World2D* World2D_ReplayPlayerWorld(World2D_ReplayPlayer* player) {
+	ASSERT(player);
+	return player->world;
+}
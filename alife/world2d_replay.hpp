@@ -0,0 +1,60 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d.hpp"
+
+// Streaming replay log of a World2D. Every captured tick becomes a frame, a
+// keyframe holds every tile (32x32 cells, all channels) and the frames in
+// between hold only the tiles that changed since that keyframe, XORed
+// against it and run length encoded. As a delta is always against its
+// keyframe, seeking to any tick decodes at most one keyframe and one delta.
+//
+// Encoding and file writes happen on a background thread, which keeps its own
+// copy of the world in tiles. The capture call only copies the tiles dirty
+// since the last captured frame into a slot of a bounded queue, keyframes
+// included, and never waits for the encoder.
+#define WORLD2D_REPLAY_MAGIC 0x52443257u	// 'W2DR'
+#define WORLD2D_REPLAY_VERSION 1
+
+struct World2D_ReplayStats {
+	uint64_t framesWritten;
+	uint64_t keyframesWritten;
+	uint64_t rawBytes;			// tile bytes before encoding
+	uint64_t encodedBytes;	// bytes written to the file
+	uint64_t framesDropped;	// captures skipped because the queue was full
+};
+
+struct World2D_ReplayRecorder;
+
+// registers a dirty consumer on world, which must outlive the recorder.
+// keyframeInterval is in captured frames, queueDepth is the number of frames
+// that can be waiting to be encoded. A capture with the queue full is dropped
+// (counted in stats.framesDropped), its tiles stay dirty and go in the next
+// frame captured
+World2D_ReplayRecorder* World2D_ReplayRecorderCreate(World2D* world, char const* filename,
+																										 uint32_t keyframeInterval, uint32_t queueDepth);
+// flushes every queued frame and closes the file
+void World2D_ReplayRecorderDestroy(World2D_ReplayRecorder* recorder);
+
+// records the world's current front planes as a frame for world->tick, false
+// if the frame was dropped or recording has failed
+bool World2D_ReplayRecorderCapture(World2D_ReplayRecorder* recorder);
+
+// counters are updated by the encoder thread, so are a snapshot
+void World2D_ReplayRecorderStats(World2D_ReplayRecorder* recorder, World2D_ReplayStats* stats);
+
+struct World2D_ReplayPlayer;
+
+World2D_ReplayPlayer* World2D_ReplayPlayerOpen(char const* filename);
+void World2D_ReplayPlayerClose(World2D_ReplayPlayer* player);
+
+uint32_t World2D_ReplayPlayerFrameCount(World2D_ReplayPlayer const* player);
+uint64_t World2D_ReplayPlayerFirstTick(World2D_ReplayPlayer const* player);
+uint64_t World2D_ReplayPlayerLastTick(World2D_ReplayPlayer const* player);
+
+// decodes the frame for tick into the player's world, false if it wasn't recorded
+bool World2D_ReplayPlayerSeek(World2D_ReplayPlayer* player, uint64_t tick);
+
+// the decoded world, tiles changed by a seek are marked dirty
+World2D* World2D_ReplayPlayerWorld(World2D_ReplayPlayer* player);
@@ -0,0 +1,98 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_rng.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WORLD2D_RNG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// writes the ids of block that fall in [firstId, endId)
+void ScalarBlock(uint64_t seed, uint64_t tick, uint32_t stream, uint32_t block,
+								 uint32_t firstId, uint32_t endId, uint32_t* out) {
+	uint32_t ctr[4] = {block, stream, (uint32_t) tick, (uint32_t) (tick >> 32)};
+	World2D_Philox4x32(ctr, (uint32_t) seed, (uint32_t) (seed >> 32));
+	for (uint32_t i = 0; i < 4; ++i) {
+		uint32_t const id = block * 4 + i;
+		if (id >= firstId && id < endId) out[id - firstId] = ctr[i];
+	}
+}
+
+#if WORLD2D_RNG_SSE2
+// 32x32 -> 64 bit products of every lane with m, split into high and low words
+void MulHiLo(__m128i a, __m128i m, __m128i& hi, __m128i& lo) {
+	__m128i const lowWords = _mm_set_epi32(0, -1, 0, -1);
+	__m128i const p02 = _mm_mul_epu32(a, m);
+	__m128i const p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+	lo = _mm_or_si128(_mm_and_si128(p02, lowWords), _mm_slli_epi64(p13, 32));
+	hi = _mm_or_si128(_mm_srli_epi64(p02, 32), _mm_andnot_si128(lowWords, p13));
+}
+
+// four consecutive blocks, one per lane, out gets their 16 values in id order
+void SSE2Blocks(uint64_t seed, uint64_t tick, uint32_t stream, uint32_t block, uint32_t* out) {
+	__m128i c0 = _mm_add_epi32(_mm_set1_epi32((int) block), _mm_set_epi32(3, 2, 1, 0));
+	__m128i c1 = _mm_set1_epi32((int) stream);
+	__m128i c2 = _mm_set1_epi32((int) (uint32_t) tick);
+	__m128i c3 = _mm_set1_epi32((int) (uint32_t) (tick >> 32));
+	uint32_t k0 = (uint32_t) seed;
+	uint32_t k1 = (uint32_t) (seed >> 32);
+	__m128i const m0 = _mm_set1_epi32((int) 0xD2511F53u);
+	__m128i const m1 = _mm_set1_epi32((int) 0xCD9E8D57u);
+
+	for (uint32_t round = 0; round < 10; ++round) {
+		__m128i hi0, lo0, hi1, lo1;
+		MulHiLo(c0, m0, hi0, lo0);
+		MulHiLo(c2, m1, hi1, lo1);
+		__m128i const n0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int) k0));
+		__m128i const n2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int) k1));
+		c0 = n0;
+		c1 = lo1;
+		c2 = n2;
+		c3 = lo0;
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+
+	// lanes are blocks and registers words, transpose so each block's words are together
+	__m128i const t0 = _mm_unpacklo_epi32(c0, c1);
+	__m128i const t1 = _mm_unpacklo_epi32(c2, c3);
+	__m128i const t2 = _mm_unpackhi_epi32(c0, c1);
+	__m128i const t3 = _mm_unpackhi_epi32(c2, c3);
+	_mm_storeu_si128((__m128i*) (out + 0), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128((__m128i*) (out + 4), _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128((__m128i*) (out + 8), _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128((__m128i*) (out + 12), _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+} // end anon namespace
+
+void World2D_RandomBatch(uint64_t seed, uint64_t tick, uint32_t stream, uint32_t firstId, uint32_t count, uint32_t* out) {
+	ASSERT(out || count == 0);
+	ASSERT((uint64_t) firstId + count <= (uint64_t) UINT32_MAX + 1);
+	if (count == 0) return;
+
+	uint32_t const endId = firstId + count;
+	uint32_t block = firstId >> 2;
+	uint32_t const endBlock = (uint32_t) (((uint64_t) firstId + count + 3) >> 2);
+
+	// a partial first block
+	if (firstId & 3) {
+		ScalarBlock(seed, tick, stream, block++, firstId, endId, out);
+	}
+
+#if WORLD2D_RNG_SSE2
+	// whole blocks four at a time, written straight to out
+	while (block + 4 <= endBlock && (uint64_t) (block + 4) * 4 <= endId) {
+		SSE2Blocks(seed, tick, stream, block, out + (block * 4 - firstId));
+		block += 4;
+	}
+#endif
+
+	for (; block < endBlock; ++block) {
+		ScalarBlock(seed, tick, stream, block, firstId, endId, out);
+	}
+}
@@ -0,0 +1,41 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d_kernels.hpp"
+
+// Counter based random numbers (Philox4x32-10). A value is a pure function of
+// (seed, tick, stream, id) so it doesn't matter which thread, tile or device
+// asks for it or in what order, which is what keeps a stochastic step bit
+// identical for any thread count and on the GPU backends.
+//
+// Each Philox block gives 4 values, ids 4n .. 4n+3 share block n.
+// Streams keep different rules that use the same ids apart.
+#define WORLD2D_RNG_STREAM_FOOD_SPROUT 0u
+#define WORLD2D_RNG_STREAM_AGENT_WANDER 1u
+
+// one Philox4x32-10 block, ctr is replaced by the output
+static inline WORLD2D_CELL_OP void World2D_Philox4x32(uint32_t ctr[4], uint32_t k0, uint32_t k1) {
+	for (uint32_t round = 0; round < 10; ++round) {
+		uint64_t const p0 = (uint64_t) 0xD2511F53u * ctr[0];
+		uint64_t const p1 = (uint64_t) 0xCD9E8D57u * ctr[2];
+		uint32_t const c1 = ctr[1];
+		uint32_t const c3 = ctr[3];
+		ctr[0] = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+		ctr[1] = (uint32_t) p1;
+		ctr[2] = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+		ctr[3] = (uint32_t) p0;
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+}
+
+static inline WORLD2D_CELL_OP uint32_t World2D_Random(uint64_t seed, uint64_t tick, uint32_t stream, uint32_t id) {
+	uint32_t ctr[4] = {id >> 2, stream, (uint32_t) tick, (uint32_t) (tick >> 32)};
+	World2D_Philox4x32(ctr, (uint32_t) seed, (uint32_t) (seed >> 32));
+	return ctr[id & 3];
+}
+
+// out[i] = World2D_Random(seed, tick, stream, firstId + i), four blocks at a
+// time with SSE2 where it's available
+void World2D_RandomBatch(uint64_t seed, uint64_t tick, uint32_t stream, uint32_t firstId, uint32_t count, uint32_t* out);
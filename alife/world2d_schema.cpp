@@ -0,0 +1,95 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_schema.hpp"
+
+namespace {
+
+template<typename Channel>
+void FillPlane(void* plane, size_t sizeInBytes) {
+	using T = typename Channel::Type;
+	T* const elements = (T*) plane;
+	T const value = (T) Channel::defaultValue;
+	for (size_t i = 0; i < sizeInBytes / sizeof(T); ++i) {
+		elements[i] = value;
+	}
+}
+
+template<typename Channel>
+void RelayoutPlane(World2DChannel const& from, World2DChannel& to, uint32_t width, uint32_t height) {
+	using T = typename Channel::Type;
+	ASSERT(from.elementSize == sizeof(T) && to.elementSize == sizeof(T));
+	T const* src = (T const*) from.data;
+	T* dst = (T*) to.data;
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			dst[World2D_ElementIndex(to.layout, to.pitch, x, y)] = src[World2D_ElementIndex(from.layout, from.pitch, x, y)];
+		}
+	}
+}
+
+template<typename Channel>
+constexpr World2D_ChannelDesc DescOf() {
+	return {Channel::name, sizeof(typename Channel::Type), Channel::layout, Channel::doubleBuffered, Channel::defaultValue,
+					&FillPlane<Channel>, &RelayoutPlane<Channel>};
+}
+
+template<typename List> struct DescTable;
+template<typename... Channels> struct DescTable<World2D_ChannelList<Channels...>> {
+	static constexpr World2D_ChannelDesc descs[sizeof...(Channels)] = {DescOf<Channels>()...};
+};
+template<typename... Channels>
+constexpr World2D_ChannelDesc DescTable<World2D_ChannelList<Channels...>>::descs[sizeof...(Channels)];
+
+template<WorldType Type>
+constexpr World2D_TypeOps TypeOpsOf() {
+	using Schema = World2D_Schema<Type>;
+	return {Schema::name, DescTable<typename Schema::Channels>::descs, Schema::Channels::count,
+					&Schema::StepTile, &Schema::TileSettled, &Schema::PackTexels};
+}
+
+// indexed by WorldType
+World2D_TypeOps const TypeOps[] = {
+		TypeOpsOf<WT_MOE>(),
+};
+static_assert(sizeof(TypeOps) / sizeof(TypeOps[0]) == WT_COUNT, "every WorldType needs a registry entry");
+
+uint8_t ToUnorm8(int16_t v) {
+	return (v < 0) ? 0 : (uint8_t) (v >> 7);
+}
+
+} // end anon namespace
+
+World2D_TypeOps const* World2D_TypeOpsFor(WorldType type) {
+	return ((uint32_t) type < WT_COUNT) ? &TypeOps[type] : nullptr;
+}
+
+void World2D_Schema<WT_MOE>::PackTexels(World2D const* world, World2D_Rect const& rect, uint8_t* dst) {
+	auto const food = World2D_Elements<WT_MOE, WMC_FOOD>(world);
+	auto const moisture = World2D_Elements<WT_MOE, WMC_MOISTURE>(world);
+	auto const pheromone = World2D_Elements<WT_MOE, WMC_PHEROMONE>(world);
+	bool const rows = food.layout == WL_ROW_MAJOR && moisture.layout == WL_ROW_MAJOR && pheromone.layout == WL_ROW_MAJOR;
+
+	for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+		if (rows) {
+			int16_t const* f = food.row(y);
+			int16_t const* m = moisture.row(y);
+			int16_t const* p = pheromone.row(y);
+			for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+				dst[0] = ToUnorm8(p[x]);
+				dst[1] = ToUnorm8(f[x]);
+				dst[2] = ToUnorm8(m[x]);
+				dst[3] = 0xFF;
+				dst += WORLD2D_TEXEL_SIZE;
+			}
+		} else {
+			for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+				dst[0] = ToUnorm8(pheromone.at(x, y));
+				dst[1] = ToUnorm8(food.at(x, y));
+				dst[2] = ToUnorm8(moisture.at(x, y));
+				dst[3] = 0xFF;
+				dst += WORLD2D_TEXEL_SIZE;
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d.hpp"
+#include <tuple>
+
+// Compile time description of each world type. A type lists its channels, each
+// with its element type, preferred layout, buffering and default value, and
+// provides the per type hooks (step tile, tile settled, texel pack).
+// Everything else, the runtime channel descs, typed plane fill and relayout,
+// and the registry used to pick a type at runtime, is generated from that.
+//
+// Runtime code only dispatches once per tile, plane or rect through the
+// registry, the loops inside are instantiated per type and channel so they
+// have no per cell branches on element size or type.
+
+struct World2D_StepParams;
+
+// packed texels are RGBA8
+#define WORLD2D_TEXEL_SIZE 4
+
+template<typename T, World2D_Layout Layout, bool DoubleBuffered, int32_t DefaultValue>
+struct World2D_ChannelSchema {
+	using Type = T;
+	static constexpr World2D_Layout layout = Layout;
+	static constexpr bool doubleBuffered = DoubleBuffered;
+	static constexpr int32_t defaultValue = DefaultValue;
+};
+
+template<typename... Channels> struct World2D_ChannelList {
+	static constexpr uint32_t count = sizeof...(Channels);
+	template<uint32_t Index> using At = typename std::tuple_element<Index, std::tuple<Channels...>>::type;
+};
+
+// specialised per WorldType
+template<WorldType Type> struct World2D_Schema;
+
+// occupancy is randomly accessed by creatures so prefers the tiled layout and
+// isn't touched by the world step, everything else is walked by row stencils
+struct World2D_MOEFood : World2D_ChannelSchema<int16_t, WL_ROW_MAJOR, true, 0> { static constexpr char const* name = "food"; };
+struct World2D_MOEMoisture : World2D_ChannelSchema<int16_t, WL_ROW_MAJOR, true, 0> { static constexpr char const* name = "moisture"; };
+struct World2D_MOEPheromone : World2D_ChannelSchema<int16_t, WL_ROW_MAJOR, true, 0> { static constexpr char const* name = "pheromone"; };
+struct World2D_MOEOccupancy : World2D_ChannelSchema<uint8_t, WL_TILED_MORTON, false, 0> { static constexpr char const* name = "occupancy"; };
+
+template<> struct World2D_Schema<WT_MOE> {
+	static constexpr char const* name = "moe";
+	// in WorldMOEChannel order
+	using Channels = World2D_ChannelList<World2D_MOEFood, World2D_MOEMoisture, World2D_MOEPheromone, World2D_MOEOccupancy>;
+
+	// world2d_step.cpp
+	static void StepTile(World2D* world, World2D_StepParams const* params, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+	static bool TileSettled(World2D const* world, World2D_StepParams const* params, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+	// r pheromone, g food, b moisture, a 255. world2d_schema.cpp
+	static void PackTexels(World2D const* world, World2D_Rect const& rect, uint8_t* dst);
+};
+static_assert(World2D_Schema<WT_MOE>::Channels::count == WMC_COUNT, "MOE schema must list every WorldMOEChannel");
+
+template<WorldType Type, uint32_t Channel>
+using World2D_SchemaChannel = typename World2D_Schema<Type>::Channels::template At<Channel>;
+
+// runtime view of a world type, one per WorldType
+struct World2D_TypeOps {
+	char const* name;
+	World2D_ChannelDesc const* channels;
+	uint32_t channelCount;
+
+	// computes cells [x0, x1) x [y0, y1) into the back planes
+	void (*stepTile)(World2D* world, World2D_StepParams const* params, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+	// only asked about cells the last step left unchanged, true if stepping them
+	// again with the same neighbours can't change them whatever the tick, so
+	// the step's stochastic rules can't either
+	bool (*tileSettled)(World2D const* world, World2D_StepParams const* params, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+	// rect.width * rect.height texels of WORLD2D_TEXEL_SIZE bytes, row after row
+	void (*packTexels)(World2D const* world, World2D_Rect const& rect, uint8_t* dst);
+};
+
+// nullptr for an unknown type
+World2D_TypeOps const* World2D_TypeOpsFor(WorldType type);
+
+// typed views of a channel, the element type comes from the schema
+template<WorldType Type, uint32_t Channel>
+World2D_ChannelView<typename World2D_SchemaChannel<Type, Channel>::Type const> World2D_Elements(World2D const* world) {
+	ASSERT(world && world->type == Type);
+	return World2D_ElementsAs<typename World2D_SchemaChannel<Type, Channel>::Type>(world, Channel);
+}
+
+// writes through the view must be marked with World2D_MarkDirtyRect
+template<WorldType Type, uint32_t Channel>
+World2D_ChannelView<typename World2D_SchemaChannel<Type, Channel>::Type> World2D_MutableElements(World2D* world) {
+	ASSERT(world && world->type == Type);
+	return World2D_MutableElementsAs<typename World2D_SchemaChannel<Type, Channel>::Type>(world, Channel);
+}
@@ -0,0 +1,300 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_sparse.hpp"
+
+namespace {
+
+size_t AlignUp(size_t v, size_t align) {
+	return (v + align - 1) & ~(align - 1);
+}
+
+int32_t ReadElement(uint8_t const *plane, uint32_t index, uint32_t elementSize) {
+	switch (elementSize) {
+		case 1: return ((uint8_t const *) plane)[index];
+		case 2: return ((int16_t const *) plane)[index];
+		case 4: return ((int32_t const *) plane)[index];
+		default: ASSERT(false);
+			return 0;
+	}
+}
+
+void WriteElement(uint8_t *plane, uint32_t index, uint32_t elementSize, int32_t value) {
+	switch (elementSize) {
+		case 1: ((uint8_t *) plane)[index] = (uint8_t) value;
+			break;
+		case 2: ((int16_t *) plane)[index] = (int16_t) value;
+			break;
+		case 4: ((int32_t *) plane)[index] = value;
+			break;
+		default: ASSERT(false);
+			break;
+	}
+}
+
+// values are compared as stored, so a uint8 default of -1 matches 255
+bool IsDefault(World2D_ChannelDesc const &desc, int32_t value) {
+	switch (desc.elementSize) {
+		case 1: return (uint8_t) value == (uint8_t) desc.defaultValue;
+		case 2: return (int16_t) value == (int16_t) desc.defaultValue;
+		default: return value == desc.defaultValue;
+	}
+}
+
+void *PoolAlloc(World2DSparsePool *pool) {
+	if (!pool->freeList) {
+		if (pool->slabCount == pool->slabCapacity) {
+			uint32_t const newCapacity = pool->slabCapacity ? pool->slabCapacity * 2 : 16;
+			void **slabs = (void **) MEMORY_REALLOC(pool->slabs, newCapacity * sizeof(void *));
+			if (!slabs) return nullptr;
+			pool->slabs = slabs;
+			pool->slabCapacity = newCapacity;
+		}
+
+		uint8_t *slab = (uint8_t *) MEMORY_AALLOC(pool->chunkBytes * WORLD2DSPARSE_CHUNKS_PER_SLAB, WORLD2D_CACHE_LINE_SIZE);
+		if (!slab) return nullptr;
+		pool->slabs[pool->slabCount++] = slab;
+
+		// thread the new chunks onto the free list, first chunk ends up on top
+		for (uint32_t i = WORLD2DSPARSE_CHUNKS_PER_SLAB; i > 0; --i) {
+			void *chunk = slab + (i - 1) * pool->chunkBytes;
+			*(void **) chunk = pool->freeList;
+			pool->freeList = chunk;
+		}
+	}
+
+	void *chunk = pool->freeList;
+	pool->freeList = *(void **) chunk;
+	pool->chunksInUse++;
+	return chunk;
+}
+
+void PoolFree(World2DSparsePool *pool, void *chunk) {
+	*(void **) chunk = pool->freeList;
+	pool->freeList = chunk;
+	pool->chunksInUse--;
+}
+
+World2DSparseChunk *AllocChunk(World2DSparse *world, uint32_t chunkX, uint32_t chunkY) {
+	uint32_t const dirIndex = (chunkY >> WORLD2DSPARSE_PAGE_SHIFT) * world->pagesX + (chunkX >> WORLD2DSPARSE_PAGE_SHIFT);
+	World2DSparsePage *page = world->directory[dirIndex];
+	if (!page) {
+		page = (World2DSparsePage *) MEMORY_CALLOC(1, sizeof(World2DSparsePage));
+		if (!page) return nullptr;
+		world->directory[dirIndex] = page;
+	}
+
+	uint8_t *mem = (uint8_t *) PoolAlloc(&world->pool);
+	if (!mem) {
+		if (page->chunkCount == 0) {
+			MEMORY_FREE(page);
+			world->directory[dirIndex] = nullptr;
+		}
+		return nullptr;
+	}
+
+	World2DSparseChunk *chunk = (World2DSparseChunk *) mem;
+	memset(chunk, 0, sizeof(World2DSparseChunk));
+	chunk->chunkX = chunkX;
+	chunk->chunkY = chunkY;
+
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2D_ChannelDesc const &desc = world->channels[c];
+		uint8_t *plane = mem + world->channelOffsets[c];
+		chunk->planes[c] = plane;
+		if (desc.defaultValue == 0 || desc.elementSize == 1) {
+			memset(plane, (uint8_t) desc.defaultValue, WORLD2DSPARSE_CHUNK_SIZE * WORLD2DSPARSE_CHUNK_SIZE * desc.elementSize);
+		} else {
+			for (uint32_t i = 0; i < WORLD2DSPARSE_CHUNK_SIZE * WORLD2DSPARSE_CHUNK_SIZE; ++i) {
+				WriteElement(plane, i, desc.elementSize, desc.defaultValue);
+			}
+		}
+	}
+
+	page->chunks[((chunkY & WORLD2DSPARSE_PAGE_MASK) << WORLD2DSPARSE_PAGE_SHIFT) + (chunkX & WORLD2DSPARSE_PAGE_MASK)] = chunk;
+	page->chunkCount++;
+	return chunk;
+}
+
+void FreeChunk(World2DSparse *world, World2DSparseChunk *chunk) {
+	uint32_t const dirIndex =
+			(chunk->chunkY >> WORLD2DSPARSE_PAGE_SHIFT) * world->pagesX + (chunk->chunkX >> WORLD2DSPARSE_PAGE_SHIFT);
+	World2DSparsePage *page = world->directory[dirIndex];
+	ASSERT(page);
+
+	page->chunks[((chunk->chunkY & WORLD2DSPARSE_PAGE_MASK) << WORLD2DSPARSE_PAGE_SHIFT)
+			+ (chunk->chunkX & WORLD2DSPARSE_PAGE_MASK)] = nullptr;
+	PoolFree(&world->pool, chunk);
+
+	if (--page->chunkCount == 0) {
+		MEMORY_FREE(page);
+		world->directory[dirIndex] = nullptr;
+	}
+}
+
+uint32_t CountNonDefault(World2DSparse const *world, World2DSparseChunk const *chunk) {
+	uint32_t count = 0;
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2D_ChannelDesc const &desc = world->channels[c];
+		for (uint32_t i = 0; i < WORLD2DSPARSE_CHUNK_SIZE * WORLD2DSPARSE_CHUNK_SIZE; ++i) {
+			if (!IsDefault(desc, ReadElement(chunk->planes[c], i, desc.elementSize))) count++;
+		}
+	}
+	return count;
+}
+
+} // end anon namespace
+
+World2DSparse *World2DSparse_Create(WorldType type, uint32_t width, uint32_t height) {
+	World2DSparse *world = (World2DSparse *) MEMORY_CALLOC(1, sizeof(World2DSparse));
+	if (!world) return nullptr;
+
+	world->type = type;
+	world->width = width;
+	world->height = height;
+
+	uint32_t descCount = 0;
+	World2D_ChannelDesc const *descs = World2D_TypeChannelDescs(type, &descCount);
+	if (descCount == 0 || descCount > WORLD2D_MAX_CHANNELS) {
+		World2DSparse_Destroy(world);
+		return nullptr;
+	}
+
+	// chunk header then each channel plane on its own cache line
+	size_t offset = AlignUp(sizeof(World2DSparseChunk), WORLD2D_CACHE_LINE_SIZE);
+	for (uint32_t c = 0; c < descCount; ++c) {
+		world->channels[c] = descs[c];
+		world->channelOffsets[c] = offset;
+		offset += AlignUp(WORLD2DSPARSE_CHUNK_SIZE * WORLD2DSPARSE_CHUNK_SIZE * descs[c].elementSize, WORLD2D_CACHE_LINE_SIZE);
+	}
+	world->channelCount = descCount;
+	world->pool.chunkBytes = offset;
+
+	world->chunksX = (width + WORLD2DSPARSE_CHUNK_SIZE - 1) >> WORLD2DSPARSE_CHUNK_SHIFT;
+	world->chunksY = (height + WORLD2DSPARSE_CHUNK_SIZE - 1) >> WORLD2DSPARSE_CHUNK_SHIFT;
+	world->pagesX = (world->chunksX + WORLD2DSPARSE_PAGE_SIZE - 1) >> WORLD2DSPARSE_PAGE_SHIFT;
+	world->pagesY = (world->chunksY + WORLD2DSPARSE_PAGE_SIZE - 1) >> WORLD2DSPARSE_PAGE_SHIFT;
+	world->directory = (World2DSparsePage **) MEMORY_CALLOC((size_t) world->pagesX * world->pagesY, sizeof(World2DSparsePage *));
+	if (!world->directory) {
+		World2DSparse_Destroy(world);
+		return nullptr;
+	}
+
+	return world;
+}
+
+void World2DSparse_Destroy(World2DSparse *world) {
+	if (!world) return;
+
+	if (world->directory) {
+		for (uint32_t i = 0; i < world->pagesX * world->pagesY; ++i) {
+			if (world->directory[i]) MEMORY_FREE(world->directory[i]);
+		}
+		MEMORY_FREE(world->directory);
+	}
+
+	for (uint32_t i = 0; i < world->pool.slabCount; ++i) {
+		MEMORY_FREE(world->pool.slabs[i]);
+	}
+	if (world->pool.slabs) MEMORY_FREE(world->pool.slabs);
+
+	MEMORY_FREE(world);
+}
+
+World2DSparseChunk *World2DSparse_MutableChunk(World2DSparse *world, uint32_t chunkX, uint32_t chunkY) {
+	ASSERT(world);
+	World2DSparseChunk *chunk = World2DSparse_FindChunk(world, chunkX, chunkY);
+	if (!chunk) {
+		chunk = AllocChunk(world, chunkX, chunkY);
+		if (!chunk) return nullptr;
+	}
+	chunk->needsRecount = true;
+	return chunk;
+}
+
+void World2DSparse_SetRaw(World2DSparse *world, uint32_t channel, uint32_t x, uint32_t y, int32_t value) {
+	ASSERT(world);
+	ASSERT(channel < world->channelCount);
+	ASSERT(x < world->width && y < world->height);
+
+	World2D_ChannelDesc const &desc = world->channels[channel];
+	uint32_t const chunkX = x >> WORLD2DSPARSE_CHUNK_SHIFT;
+	uint32_t const chunkY = y >> WORLD2DSPARSE_CHUNK_SHIFT;
+	bool const newIsDefault = IsDefault(desc, value);
+
+	World2DSparseChunk *chunk = World2DSparse_FindChunk(world, chunkX, chunkY);
+	if (!chunk) {
+		if (newIsDefault) return;
+		chunk = AllocChunk(world, chunkX, chunkY);
+		if (!chunk) {
+			LOGERROR("World2DSparse out of memory allocating chunk %u, %u", chunkX, chunkY);
+			return;
+		}
+	}
+
+	uint32_t const index = ((y & WORLD2DSPARSE_CHUNK_MASK) << WORLD2DSPARSE_CHUNK_SHIFT) + (x & WORLD2DSPARSE_CHUNK_MASK);
+	bool const oldIsDefault = IsDefault(desc, ReadElement(chunk->planes[channel], index, desc.elementSize));
+	WriteElement(chunk->planes[channel], index, desc.elementSize, value);
+
+	// counts are only trusted once any raw writes have been recounted
+	if (chunk->needsRecount) return;
+
+	if (oldIsDefault && !newIsDefault) {
+		chunk->nonDefaultCount++;
+	} else if (!oldIsDefault && newIsDefault) {
+		if (--chunk->nonDefaultCount == 0) {
+			FreeChunk(world, chunk);
+		}
+	}
+}
+
+uint32_t World2DSparse_Compact(World2DSparse *world) {
+	ASSERT(world);
+	uint32_t freed = 0;
+	for (uint32_t p = 0; p < world->pagesX * world->pagesY; ++p) {
+		World2DSparsePage *page = world->directory[p];
+		if (!page) continue;
+
+		for (World2DSparseChunk *chunk : page->chunks) {
+			if (!chunk) continue;
+			if (chunk->needsRecount) {
+				chunk->nonDefaultCount = CountNonDefault(world, chunk);
+				chunk->needsRecount = false;
+			}
+			if (chunk->nonDefaultCount == 0) {
+				bool const lastInPage = page->chunkCount == 1;
+				FreeChunk(world, chunk);
+				freed++;
+				if (lastInPage) break; // page has been freed
+			}
+		}
+	}
+	return freed;
+}
+
+uint64_t World2DSparse_ChunksInUse(World2DSparse const *world) {
+	return world->pool.chunksInUse;
+}
+
+size_t World2DSparse_BytesReserved(World2DSparse const *world) {
+	size_t bytes = sizeof(World2DSparse);
+	bytes += (size_t) world->pagesX * world->pagesY * sizeof(World2DSparsePage *);
+	for (uint32_t p = 0; p < world->pagesX * world->pagesY; ++p) {
+		if (world->directory[p]) bytes += sizeof(World2DSparsePage);
+	}
+	bytes += (size_t) world->pool.slabCount * WORLD2DSPARSE_CHUNKS_PER_SLAB * world->pool.chunkBytes;
+	return bytes;
+}
+
+void World2DSparse_ForEachChunk(World2DSparse const *world,
+																void (*func)(World2DSparseChunk const *chunk, void *userData),
+																void *userData) {
+	for (uint32_t p = 0; p < world->pagesX * world->pagesY; ++p) {
+		World2DSparsePage const *page = world->directory[p];
+		if (!page) continue;
+		for (World2DSparseChunk const *chunk : page->chunks) {
+			if (chunk) func(chunk, userData);
+		}
+	}
+}
@@ -0,0 +1,122 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d.hpp"
+
+// A sparse version of World2D for very large worlds. The world is split into
+// 64x64 cell chunks that are only allocated when first written, a chunk that
+// isn't allocated reads as the channels default values. Chunks come from a
+// pooled slab allocator and are found through a two level page table
+// (directory -> 32x32 chunk pages -> chunk).
+#define WORLD2DSPARSE_CHUNK_SHIFT 6
+#define WORLD2DSPARSE_CHUNK_SIZE (1 << WORLD2DSPARSE_CHUNK_SHIFT)
+#define WORLD2DSPARSE_CHUNK_MASK (WORLD2DSPARSE_CHUNK_SIZE - 1)
+#define WORLD2DSPARSE_PAGE_SHIFT 5
+#define WORLD2DSPARSE_PAGE_SIZE (1 << WORLD2DSPARSE_PAGE_SHIFT)
+#define WORLD2DSPARSE_PAGE_MASK (WORLD2DSPARSE_PAGE_SIZE - 1)
+#define WORLD2DSPARSE_CHUNKS_PER_SLAB 64
+
+// every channel plane in a chunk is row major with a pitch of WORLD2DSPARSE_CHUNK_SIZE
+struct World2DSparseChunk {
+	// (cell, channel) pairs not at their default value
+	uint32_t nonDefaultCount;
+	// set when the chunk was handed out for raw writes, compact recounts it
+	bool needsRecount;
+	uint32_t chunkX;
+	uint32_t chunkY;
+
+	uint8_t* planes[WORLD2D_MAX_CHANNELS];
+};
+
+struct World2DSparsePage {
+	World2DSparseChunk* chunks[WORLD2DSPARSE_PAGE_SIZE * WORLD2DSPARSE_PAGE_SIZE];
+	uint32_t chunkCount;
+};
+
+struct World2DSparsePool {
+	size_t chunkBytes;
+	uint32_t slabCount;
+	uint32_t slabCapacity;
+	void** slabs;
+	void* freeList;
+	uint64_t chunksInUse;
+};
+
+struct World2DSparse {
+	WorldType type;
+	uint32_t width;
+	uint32_t height;
+
+	uint32_t channelCount;
+	World2D_ChannelDesc channels[WORLD2D_MAX_CHANNELS];
+	size_t channelOffsets[WORLD2D_MAX_CHANNELS];
+
+	uint32_t chunksX;
+	uint32_t chunksY;
+	uint32_t pagesX;
+	uint32_t pagesY;
+	World2DSparsePage** directory;
+
+	World2DSparsePool pool;
+};
+
+World2DSparse* World2DSparse_Create(WorldType type, uint32_t width, uint32_t height);
+void World2DSparse_Destroy(World2DSparse* world);
+
+inline World2DSparseChunk* World2DSparse_FindChunk(World2DSparse const* world, uint32_t chunkX, uint32_t chunkY) {
+	ASSERT(chunkX < world->chunksX && chunkY < world->chunksY);
+	World2DSparsePage const* page =
+			world->directory[(chunkY >> WORLD2DSPARSE_PAGE_SHIFT) * world->pagesX + (chunkX >> WORLD2DSPARSE_PAGE_SHIFT)];
+	if(!page) return nullptr;
+	return page->chunks[((chunkY & WORLD2DSPARSE_PAGE_MASK) << WORLD2DSPARSE_PAGE_SHIFT) + (chunkX & WORLD2DSPARSE_PAGE_MASK)];
+}
+
+// nullptr if the chunk is all default values
+inline World2DSparseChunk const* World2DSparse_GetChunk(World2DSparse const* world, uint32_t chunkX, uint32_t chunkY) {
+	return World2DSparse_FindChunk(world, chunkX, chunkY);
+}
+
+// allocates the chunk if needed. Raw writes through the planes aren't tracked,
+// so the chunk is flagged for World2DSparse_Compact to recount
+World2DSparseChunk* World2DSparse_MutableChunk(World2DSparse* world, uint32_t chunkX, uint32_t chunkY);
+
+// frees chunks that have returned to all default values, returns how many were freed
+uint32_t World2DSparse_Compact(World2DSparse* world);
+
+uint64_t World2DSparse_ChunksInUse(World2DSparse const* world);
+// bytes held by the chunk pool and page table, including free pooled chunks
+size_t World2DSparse_BytesReserved(World2DSparse const* world);
+
+// calls func(chunk, userData) for every allocated chunk
+void World2DSparse_ForEachChunk(World2DSparse const* world, void (*func)(World2DSparseChunk const* chunk, void* userData), void* userData);
+
+template<typename T> T const* World2DSparse_ChunkPlane(World2DSparseChunk const* chunk, uint32_t channel) {
+	return (T const*) chunk->planes[channel];
+}
+
+template<typename T> T* World2DSparse_MutableChunkPlane(World2DSparseChunk* chunk, uint32_t channel) {
+	return (T*) chunk->planes[channel];
+}
+
+template<typename T> T World2DSparse_Get(World2DSparse const* world, uint32_t channel, uint32_t x, uint32_t y) {
+	ASSERT(channel < world->channelCount);
+	ASSERT(sizeof(T) == world->channels[channel].elementSize);
+	ASSERT(x < world->width && y < world->height);
+
+	World2DSparseChunk const* chunk = World2DSparse_FindChunk(world, x >> WORLD2DSPARSE_CHUNK_SHIFT, y >> WORLD2DSPARSE_CHUNK_SHIFT);
+	if(!chunk) return (T) world->channels[channel].defaultValue;
+
+	uint32_t const index = ((y & WORLD2DSPARSE_CHUNK_MASK) << WORLD2DSPARSE_CHUNK_SHIFT) + (x & WORLD2DSPARSE_CHUNK_MASK);
+	return World2DSparse_ChunkPlane<T>(chunk, channel)[index];
+}
+
+// tracks whether the chunk is still needed, allocating on the first non default
+// write and freeing when the last non default value is reset
+void World2DSparse_SetRaw(World2DSparse* world, uint32_t channel, uint32_t x, uint32_t y, int32_t value);
+
+template<typename T> void World2DSparse_Set(World2DSparse* world, uint32_t channel, uint32_t x, uint32_t y, T value) {
+	ASSERT(channel < world->channelCount);
+	ASSERT(sizeof(T) == world->channels[channel].elementSize);
+	World2DSparse_SetRaw(world, channel, x, y, (int32_t) value);
+}
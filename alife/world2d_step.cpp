@@ -0,0 +1,402 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "world2d_step.hpp"
+#include "world2d_rng.hpp"
+#include "world2d_schema.hpp"
+#include <chrono>
+#include <type_traits>
+
+namespace {
+
+struct StepTaskArgs {
+	World2D* world;
+	World2D_StepParams const* params;
+	// task range entries are tiles from here on
+	uint32_t firstTile;
+};
+
+// post ops see the cell coordinates so stochastic ones can key their draws,
+// row() covers count cells starting at x, y
+struct NoPostOp {
+	World2D_Kernels const *kernels;
+	int16_t cell(int16_t v, uint32_t x, uint32_t y) const { return v; }
+	void row(int16_t *out, uint32_t count, uint32_t x, uint32_t y) const {}
+};
+
+struct GrowPostOp {
+	World2D_Kernels const *kernels;
+	int16_t growth;
+	int16_t capacity;
+	// sprouting draws one random per cell keyed by its id in the world
+	uint32_t width;
+	uint64_t seed;
+	uint64_t tick;
+	uint16_t sproutChance;
+	int16_t sprout;
+
+	int16_t cell(int16_t v, uint32_t x, uint32_t y) const {
+		v = World2D_GrowCell(v, growth, capacity);
+		if (sproutChance == 0) return v;
+		uint32_t const random = World2D_Random(seed, tick, WORLD2D_RNG_STREAM_FOOD_SPROUT, y * width + x);
+		return World2D_SproutCell(v, random, sproutChance, sprout, capacity);
+	}
+	void row(int16_t *out, uint32_t count, uint32_t x, uint32_t y) const {
+		kernels->grow(out, count, growth, capacity);
+		if (sproutChance == 0) return;
+		uint32_t randoms[WORLD2D_STEP_TILE_SIZE];
+		ASSERT(count <= WORLD2D_STEP_TILE_SIZE);
+		World2D_RandomBatch(seed, tick, WORLD2D_RNG_STREAM_FOOD_SPROUT, y * width + x, count, randoms);
+		for (uint32_t i = 0; i < count; ++i) {
+			out[i] = World2D_SproutCell(out[i], randoms[i], sproutChance, sprout, capacity);
+		}
+	}
+};
+
+struct DecayPostOp {
+	World2D_Kernels const *kernels;
+	int16_t decay;
+	int16_t cell(int16_t v, uint32_t x, uint32_t y) const { return World2D_DecayCell(v, decay); }
+	void row(int16_t *out, uint32_t count, uint32_t x, uint32_t y) const { kernels->decay(out, count, decay); }
+};
+
+// clamped stencil for a single cell in any layout, used for world edges and non row major planes
+int16_t StencilCell(int16_t const *src, World2D_Layout layout, uint32_t pitch,
+										uint32_t x, uint32_t y, uint32_t lastX, uint32_t lastY,
+										bool nine, uint32_t shift) {
+	uint32_t const ya = (y > 0) ? y - 1 : y;
+	uint32_t const yb = (y < lastY) ? y + 1 : y;
+	uint32_t const xw = (x > 0) ? x - 1 : x;
+	uint32_t const xe = (x < lastX) ? x + 1 : x;
+	int16_t const c = src[World2D_ElementIndex(layout, pitch, x, y)];
+	int16_t const n = src[World2D_ElementIndex(layout, pitch, x, ya)];
+	int16_t const s = src[World2D_ElementIndex(layout, pitch, x, yb)];
+	int16_t const e = src[World2D_ElementIndex(layout, pitch, xe, y)];
+	int16_t const w = src[World2D_ElementIndex(layout, pitch, xw, y)];
+	if (!nine) {
+		return World2D_Diffuse5Cell(c, n, s, e, w, shift);
+	}
+	int16_t const nw = src[World2D_ElementIndex(layout, pitch, xw, ya)];
+	int16_t const ne = src[World2D_ElementIndex(layout, pitch, xe, ya)];
+	int16_t const sw = src[World2D_ElementIndex(layout, pitch, xw, yb)];
+	int16_t const se = src[World2D_ElementIndex(layout, pitch, xe, yb)];
+	return World2D_Diffuse9Cell(c, n, s, e, w, nw, ne, sw, se, shift);
+}
+
+// diffuses a 16 bit channel over a tile then applies op to each cell, edges clamp.
+// Row major planes run the row kernels over the interior columns.
+template<typename PostOp>
+void StepChannelTile(World2D const *world,
+										 World2DChannel const &channel,
+										 uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+										 bool nine,
+										 uint32_t shift,
+										 PostOp const &op) {
+	ASSERT(channel.doubleBuffered);
+	ASSERT(channel.elementSize == sizeof(int16_t));
+
+	int16_t const *src = (int16_t const *) channel.data;
+	int16_t *dst = (int16_t *) channel.back;
+	uint32_t const lastX = world->width - 1;
+	uint32_t const lastY = world->height - 1;
+	uint32_t const pitch = channel.pitch;
+	World2D_Layout const layout = channel.layout;
+
+	if (layout == WL_ROW_MAJOR) {
+		auto const diffuse = nine ? op.kernels->diffuse9 : op.kernels->diffuse5;
+		uint32_t const xb = (x0 > 0) ? x0 : 1;
+		uint32_t const xe = (x1 < lastX) ? x1 : lastX;
+
+		for (uint32_t y = y0; y < y1; ++y) {
+			int16_t const *row = src + (size_t) y * pitch;
+			int16_t const *above = src + (size_t) ((y > 0) ? y - 1 : y) * pitch;
+			int16_t const *below = src + (size_t) ((y < lastY) ? y + 1 : y) * pitch;
+			int16_t *out = dst + (size_t) y * pitch;
+
+			if (xe > xb) {
+				diffuse(out + xb, above + xb, row + xb, below + xb, xe - xb, shift);
+				op.row(out + xb, xe - xb, xb, y);
+			}
+			if (x0 == 0) {
+				out[0] = op.cell(StencilCell(src, layout, pitch, 0, y, lastX, lastY, nine, shift), 0, y);
+			}
+			if (x1 == world->width && lastX != 0) {
+				out[lastX] = op.cell(StencilCell(src, layout, pitch, lastX, y, lastX, lastY, nine, shift), lastX, y);
+			}
+		}
+	} else {
+		for (uint32_t y = y0; y < y1; ++y) {
+			for (uint32_t x = x0; x < x1; ++x) {
+				dst[World2D_ElementIndex(layout, pitch, x, y)] =
+						op.cell(StencilCell(src, layout, pitch, x, y, lastX, lastY, nine, shift), x, y);
+			}
+		}
+	}
+}
+
+bool RegionChanged(World2D const *world, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2DChannel const &channel = world->channels[c];
+		if (!channel.doubleBuffered) continue;
+
+		uint8_t const *front = (uint8_t const *) channel.data;
+		uint8_t const *back = (uint8_t const *) channel.back;
+		uint32_t const es = channel.elementSize;
+
+		if (channel.layout == WL_ROW_MAJOR) {
+			for (uint32_t y = y0; y < y1; ++y) {
+				size_t const offset = ((size_t) y * channel.pitch + x0) * es;
+				if (memcmp(front + offset, back + offset, (x1 - x0) * es) != 0) return true;
+			}
+		} else {
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = x0; x < x1; ++x) {
+					size_t const offset = World2D_ElementIndex(channel.layout, channel.pitch, x, y) * es;
+					if (memcmp(front + offset, back + offset, es) != 0) return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+// records which dirty tiles covered by a stepped rect have new values that
+// differ from the current ones and which settled. The changed ones are marked
+// dirty when the tick ends, so consumers never see a tile dirty before its new
+// values are in the front planes. Only touches its own tiles so never wakes anything
+void UpdateTileActivity(World2D *world, World2D_TypeOps const *ops, World2D_StepParams const *params,
+												uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+	static_assert((WORLD2D_STEP_TILE_SIZE % WORLD2D_DIRTY_TILE_SIZE) == 0,
+								"step tiles must cover whole dirty tiles so tasks never share a dirty byte");
+
+	for (uint32_t ty = y0 >> WORLD2D_DIRTY_TILE_SHIFT; ty <= (y1 - 1) >> WORLD2D_DIRTY_TILE_SHIFT; ++ty) {
+		for (uint32_t tx = x0 >> WORLD2D_DIRTY_TILE_SHIFT; tx <= (x1 - 1) >> WORLD2D_DIRTY_TILE_SHIFT; ++tx) {
+			uint32_t const cx0 = tx << WORLD2D_DIRTY_TILE_SHIFT;
+			uint32_t const cy0 = ty << WORLD2D_DIRTY_TILE_SHIFT;
+			uint32_t const cx1 = (cx0 + WORLD2D_DIRTY_TILE_SIZE < x1) ? cx0 + WORLD2D_DIRTY_TILE_SIZE : x1;
+			uint32_t const cy1 = (cy0 + WORLD2D_DIRTY_TILE_SIZE < y1) ? cy0 + WORLD2D_DIRTY_TILE_SIZE : y1;
+			uint32_t const index = ty * world->dirtyTilesX + tx;
+			if (RegionChanged(world, cx0, cy0, cx1, cy1)) {
+				world->tileActivity[index] = WORLD2D_TILE_CHANGED;
+			} else if (params->tileSleep && ops->tileSettled(world, params, cx0, cy0, cx1, cy1)) {
+				world->tileActivity[index] = WORLD2D_TILE_SETTLED;
+			} else {
+				world->tileActivity[index] = 0;
+			}
+		}
+	}
+}
+
+bool NeighbourChanged(World2D const *world, uint32_t tx, uint32_t ty) {
+	uint32_t const tx0 = (tx > 0) ? tx - 1 : 0;
+	uint32_t const ty0 = (ty > 0) ? ty - 1 : 0;
+	uint32_t const tx1 = (tx + 1 < world->dirtyTilesX) ? tx + 1 : tx;
+	uint32_t const ty1 = (ty + 1 < world->dirtyTilesY) ? ty + 1 : ty;
+	for (uint32_t y = ty0; y <= ty1; ++y) {
+		for (uint32_t x = tx0; x <= tx1; ++x) {
+			if (world->tileActivity[y * world->dirtyTilesX + x] & WORLD2D_TILE_CHANGED) return true;
+		}
+	}
+	return false;
+}
+
+// a tile sleeps next tick if it didn't change and either settled this tick or
+// was already asleep, as long as none of its neighbours (whose cells are its
+// halo) changed either. Changed tiles are marked dirty
+void SleepSettledTiles(World2D *world) {
+	uint8_t const nextAsleep = 0x80;
+	for (uint32_t ty = 0; ty < world->dirtyTilesY; ++ty) {
+		for (uint32_t tx = 0; tx < world->dirtyTilesX; ++tx) {
+			uint8_t &activity = world->tileActivity[ty * world->dirtyTilesX + tx];
+			if ((activity & (WORLD2D_TILE_ASLEEP | WORLD2D_TILE_SETTLED)) && !NeighbourChanged(world, tx, ty)) {
+				activity |= nextAsleep;
+			}
+		}
+	}
+
+	uint32_t const tileCount = world->dirtyTilesX * world->dirtyTilesY;
+	world->tilesAsleep = 0;
+	for (uint32_t t = 0; t < tileCount; ++t) {
+		bool const asleep = (world->tileActivity[t] & nextAsleep) != 0;
+		if (world->tileActivity[t] & WORLD2D_TILE_CHANGED) world->dirtyTiles[t] = 0xFF;
+		world->tileActivity[t] = asleep ? WORLD2D_TILE_ASLEEP : 0;
+		world->tilesAsleep += asleep ? 1 : 0;
+	}
+}
+
+void StepTaskFunc(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	StepTaskArgs const *args = (StepTaskArgs const *) pArgs;
+	for (uint32_t i = start; i < end; ++i) {
+		World2D_StepTile(args->world, args->params, args->firstTile + i);
+	}
+}
+
+void StepTiles(World2D *world, enkiTaskSchedulerHandle scheduler, World2D_StepParams const *params,
+							 uint32_t firstTile, uint32_t count) {
+	if (scheduler && count > 1) {
+		StepTaskArgs args{world, params, firstTile};
+		enkiTaskSetHandle taskSet = enkiCreateTaskSet(scheduler, &StepTaskFunc);
+		enkiAddTaskSetToPipeMinRange(scheduler, taskSet, &args, count, 1);
+		enkiWaitForTaskSet(scheduler, taskSet);
+		enkiDeleteTaskSet(taskSet);
+	} else {
+		for (uint32_t i = 0; i < count; ++i) {
+			World2D_StepTile(world, params, firstTile + i);
+		}
+	}
+}
+
+} // end anon namespace
+
+void World2D_Schema<WT_MOE>::StepTile(World2D *world, World2D_StepParams const *params, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+	static_assert(World2D_MOEFood::doubleBuffered && World2D_MOEMoisture::doubleBuffered && World2D_MOEPheromone::doubleBuffered,
+								"stepped channels must be double buffered");
+	static_assert(std::is_same<World2D_MOEFood::Type, int16_t>::value && std::is_same<World2D_MOEMoisture::Type, int16_t>::value &&
+										std::is_same<World2D_MOEPheromone::Type, int16_t>::value,
+								"stepped channels run the 16 bit kernels");
+	World2D_Kernels const *kernels = params->kernels ? params->kernels : World2D_KernelsScalar();
+
+	GrowPostOp const grow{kernels, params->foodGrowth, params->foodCapacity,
+												world->width, params->seed, world->tick, params->foodSproutChance, params->foodSprout};
+	StepChannelTile(world, world->channels[WMC_FOOD], x0, y0, x1, y1, false, params->foodDiffuseShift, grow);
+
+	NoPostOp const none{kernels};
+	StepChannelTile(world, world->channels[WMC_MOISTURE], x0, y0, x1, y1, true, params->moistureDiffuseShift, none);
+
+	DecayPostOp const decay{kernels, params->pheromoneDecay};
+	StepChannelTile(world, world->channels[WMC_PHEROMONE], x0, y0, x1, y1, false, params->pheromoneDiffuseShift, decay);
+}
+
+bool World2D_Schema<WT_MOE>::TileSettled(World2D const *world, World2D_StepParams const *params,
+																				 uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+	// sprouting is the only rule that depends on the tick
+	if (params->foodSproutChance == 0) return true;
+	auto const food = World2D_Elements<WT_MOE, WMC_FOOD>(world);
+	for (uint32_t y = y0; y < y1; ++y) {
+		for (uint32_t x = x0; x < x1; ++x) {
+			int16_t const v = food.at(x, y);
+			if (World2D_GrowCell(v, params->foodSprout, params->foodCapacity) != v) return false;
+		}
+	}
+	return true;
+}
+
+void World2D_StepParamsDefaults(World2D_StepParams *params) {
+	ASSERT(params);
+	params->foodDiffuseShift = 3;
+	params->foodGrowth = 4;
+	params->foodCapacity = 4096;
+	params->foodSproutChance = 0; // off, 8 is ~1 cell in 8192 per tick
+	params->foodSprout = 512;
+	params->moistureDiffuseShift = 1;
+	params->pheromoneDiffuseShift = 2;
+	params->pheromoneDecay = 655; // ~1% per tick
+	params->seed = 0x5EEDu;
+	params->tileSleep = true;
+	params->kernels = World2D_KernelsBest();
+}
+
+uint32_t World2D_StepTileCountX(World2D const *world) {
+	return (world->width + WORLD2D_STEP_TILE_SIZE - 1) / WORLD2D_STEP_TILE_SIZE;
+}
+
+uint32_t World2D_StepTileCountY(World2D const *world) {
+	return (world->height + WORLD2D_STEP_TILE_SIZE - 1) / WORLD2D_STEP_TILE_SIZE;
+}
+
+void World2D_StepTile(World2D *world, World2D_StepParams const *params, uint32_t tileIndex) {
+	uint32_t const tilesX = World2D_StepTileCountX(world);
+	uint32_t const x0 = (tileIndex % tilesX) * WORLD2D_STEP_TILE_SIZE;
+	uint32_t const y0 = (tileIndex / tilesX) * WORLD2D_STEP_TILE_SIZE;
+	uint32_t const x1 = (x0 + WORLD2D_STEP_TILE_SIZE < world->width) ? x0 + WORLD2D_STEP_TILE_SIZE : world->width;
+	uint32_t const y1 = (y0 + WORLD2D_STEP_TILE_SIZE < world->height) ? y0 + WORLD2D_STEP_TILE_SIZE : world->height;
+
+	World2D_TypeOps const *ops = World2D_TypeOpsFor(world->type);
+	ASSERT(ops);
+
+	// tilesAsleep only changes between ticks so is safe to read here
+	if (world->tilesAsleep == 0 || !params->tileSleep) {
+		ops->stepTile(world, params, x0, y0, x1, y1);
+		UpdateTileActivity(world, ops, params, x0, y0, x1, y1);
+		return;
+	}
+
+	// runs of awake dirty tiles along each dirty tile row
+	uint32_t const txEnd = ((x1 - 1) >> WORLD2D_DIRTY_TILE_SHIFT) + 1;
+	for (uint32_t ty = y0 >> WORLD2D_DIRTY_TILE_SHIFT; ty <= (y1 - 1) >> WORLD2D_DIRTY_TILE_SHIFT; ++ty) {
+		uint8_t const *activity = world->tileActivity + ty * world->dirtyTilesX;
+		uint32_t const ry0 = ty << WORLD2D_DIRTY_TILE_SHIFT;
+		uint32_t const ry1 = (ry0 + WORLD2D_DIRTY_TILE_SIZE < y1) ? ry0 + WORLD2D_DIRTY_TILE_SIZE : y1;
+		uint32_t tx = x0 >> WORLD2D_DIRTY_TILE_SHIFT;
+		while (tx < txEnd) {
+			if (activity[tx] & WORLD2D_TILE_ASLEEP) {
+				++tx;
+				continue;
+			}
+			uint32_t const runStart = tx;
+			while (tx < txEnd && !(activity[tx] & WORLD2D_TILE_ASLEEP)) ++tx;
+
+			uint32_t const rx0 = runStart << WORLD2D_DIRTY_TILE_SHIFT;
+			uint32_t const rx1 = ((tx << WORLD2D_DIRTY_TILE_SHIFT) < x1) ? (tx << WORLD2D_DIRTY_TILE_SHIFT) : x1;
+			ops->stepTile(world, params, rx0, ry0, rx1, ry1);
+			UpdateTileActivity(world, ops, params, rx0, ry0, rx1, ry1);
+		}
+	}
+}
+
+void World2D_StepFinish(World2D *world) {
+	ASSERT(world);
+	SleepSettledTiles(world);
+	World2D_SwapBuffers(world);
+}
+
+void World2D_Step(World2D *world, enkiTaskSchedulerHandle scheduler, World2D_StepParams const *params) {
+	ASSERT(world);
+	ASSERT(params);
+
+	StepTiles(world, scheduler, params, 0, World2D_StepTileCountX(world) * World2D_StepTileCountY(world));
+	World2D_StepFinish(world);
+}
+
+bool World2D_StepSliced(World2D_StepSlice *slice, World2D *world, enkiTaskSchedulerHandle scheduler,
+												World2D_StepParams const *params, double budgetMS) {
+	ASSERT(slice);
+	ASSERT(world);
+	ASSERT(params);
+	auto const start = std::chrono::steady_clock::now();
+
+	if (slice->world != world) {
+		World2D_StepSliceAbort(slice);
+		slice->world = world;
+	}
+	// the whole tick runs with the params it started with
+	if (slice->nextTile == 0) slice->params = *params;
+
+	// a tile per thread between clock checks, always at least one batch so
+	// every call makes progress however small the budget
+	uint32_t const tileCount = World2D_StepTileCountX(world) * World2D_StepTileCountY(world);
+	uint32_t const batch = scheduler ? enkiGetNumTaskThreads(scheduler) : 1;
+	do {
+		uint32_t const count = (slice->nextTile + batch < tileCount) ? batch : tileCount - slice->nextTile;
+		StepTiles(world, scheduler, &slice->params, slice->nextTile, count);
+		slice->nextTile += count;
+	} while (slice->nextTile < tileCount &&
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMS);
+
+	if (slice->nextTile < tileCount) return false;
+	slice->nextTile = 0;
+	World2D_StepFinish(world);
+	return true;
+}
+
+void World2D_StepSliceAbort(World2D_StepSlice *slice) {
+	ASSERT(slice);
+	if (slice->nextTile == 0) return;
+	slice->nextTile = 0;
+
+	// the back planes are just overwritten by the next tick but the stepped
+	// tiles' activity is half a tick's, wake everything rather than trust it
+	World2D *world = slice->world;
+	memset(world->tileActivity, 0, world->dirtyTilesX * world->dirtyTilesY);
+	world->tilesAsleep = 0;
+}
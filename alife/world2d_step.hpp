@@ -0,0 +1,96 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_enki/TaskScheduler_c.h"
+#include "world2d.hpp"
+#include "world2d_kernels.hpp"
+
+// the step splits the world into square tiles, each tile is one enki task
+// range entry. Tiles read their halo from the front planes and only write
+// their own cells in the back planes, so no locks are required.
+//
+// A step is bit identical for any thread count or tile order. Every cell op is
+// integer and depends only on the front planes, and the stochastic rules draw
+// from World2D_Random keyed by (seed, tick, cell id), never a shared generator.
+//
+// Dirty tiles that have settled sleep (see WORLD2D_TILE_ASLEEP) and aren't
+// recomputed, so the cost follows the active area. A sleeping tile's cells
+// are exactly what stepping it would give, so results don't depend on it.
+// Changing the params can unsettle tiles, wake them all when doing so.
+#define WORLD2D_STEP_TILE_SIZE 64
+
+struct World2D_StepParams {
+	// food moves 1/2^shift of the way towards its neighbours average each tick
+	uint32_t foodDiffuseShift;
+	int16_t foodGrowth;
+	int16_t foodCapacity;
+	// each tick a cell sprouts foodSprout extra food with a chance of
+	// foodSproutChance/65536, 0 (the default) turns sprouting off
+	uint16_t foodSproutChance;
+	int16_t foodSprout;
+
+	// moisture uses the 9 point stencil, food and pheromone the 5 point
+	uint32_t moistureDiffuseShift;
+
+	uint32_t pheromoneDiffuseShift;
+	// pheromone loses decay/65536 of its value each tick
+	int16_t pheromoneDecay;
+
+	// keys the stochastic rules, the same seed and starting world replay exactly
+	uint64_t seed;
+
+	// skip tiles that have settled
+	bool tileSleep;
+
+	// row kernels for row major planes, defaults to World2D_KernelsBest
+	World2D_Kernels const* kernels;
+};
+
+void World2D_StepParamsDefaults(World2D_StepParams* params);
+
+uint32_t World2D_StepTileCountX(World2D const* world);
+uint32_t World2D_StepTileCountY(World2D const* world);
+
+// computes one step tile's awake cells into the back planes and notes the
+// dirty tiles whose cells will change when the planes swap. Safe to call
+// concurrently for different tiles
+void World2D_StepTile(World2D* world, World2D_StepParams const* params, uint32_t tileIndex);
+
+// ends a tick stepped tile by tile, marks the changed tiles dirty, puts the
+// tiles that settled to sleep and swaps the planes
+void World2D_StepFinish(World2D* world);
+
+// a full tick, tiles are dispatched across the task scheduler and the
+// front/back planes swapped when every tile is done
+void World2D_Step(World2D* world, enkiTaskSchedulerHandle scheduler, World2D_StepParams const* params);
+
+// A tick spread over several calls, for callers with a frame to keep. Each call
+// steps tiles until its time budget is spent and carries on from there next
+// call. Tiles only write the back planes so the front planes stay the last
+// whole tick until the final tile is done and the planes swap.
+//
+// Nothing may write the world's front planes while a tick is in progress, the
+// tiles still to step would see the writes and the ones already stepped not.
+// Write between ticks or abort the tick first. Zero initialise.
+struct World2D_StepSlice {
+	World2D* world;
+	// the params the tick in progress started with
+	World2D_StepParams params;
+	// next tile to step, 0 between ticks
+	uint32_t nextTile;
+};
+
+// steps tiles of world's current tick for about budgetMS, always at least one
+// per thread. Returns true when the tick completed and the planes swapped.
+// params are picked up at the start of each tick, a different world aborts
+// the tick in progress
+bool World2D_StepSliced(World2D_StepSlice* slice, World2D* world, enkiTaskSchedulerHandle scheduler,
+												World2D_StepParams const* params, double budgetMS);
+
+// throws away the tick in progress, the front planes are untouched and the
+// next call starts a fresh tick with every tile awake
+void World2D_StepSliceAbort(World2D_StepSlice* slice);
+
+inline bool World2D_StepSliceInProgress(World2D_StepSlice const* slice) {
+	return slice->nextTile > 0;
+}
@@ -0,0 +1,229 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "world2d_texstream.hpp"
+#include <string.h>
+
+namespace {
+
+// cells of a run of tiles on one tile row, clipped to the world
+World2D_Rect TileRunRect(World2D const* world, uint32_t tileY, uint32_t tileX0, uint32_t tileX1) {
+	uint32_t const x = tileX0 << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const y = tileY << WORLD2D_DIRTY_TILE_SHIFT;
+	uint32_t const x1 = (tileX1 << WORLD2D_DIRTY_TILE_SHIFT) < world->width ? (tileX1 << WORLD2D_DIRTY_TILE_SHIFT) : world->width;
+	uint32_t const y1 = y + WORLD2D_DIRTY_TILE_SIZE < world->height ? y + WORLD2D_DIRTY_TILE_SIZE : world->height;
+	return {x, y, x1 - x, y1 - y};
+}
+
+// the texels of mip level covering rect of level 0 cells
+World2D_Rect MipRect(World2D_TexStreamMip const& mip, World2D_Rect const& rect, uint32_t level) {
+	uint32_t const x = rect.x >> level;
+	uint32_t const y = rect.y >> level;
+	uint32_t const x1 = (rect.x + rect.width + (1u << level) - 1) >> level;
+	uint32_t const y1 = (rect.y + rect.height + (1u << level) - 1) >> level;
+	return {x, y, (x1 < mip.width ? x1 : mip.width) - x, (y1 < mip.height ? y1 : mip.height) - y};
+}
+
+uint64_t RunBytes(World2D_TexStream const* stream, World2D_Rect const& rect) {
+	uint64_t bytes = 0;
+	for (uint32_t level = 0; level < stream->mipCount; ++level) {
+		World2D_Rect const r = MipRect(stream->mips[level], rect, level);
+		bytes += (uint64_t) r.width * r.height * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+	}
+	return bytes;
+}
+
+uint8_t AverageOf4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+	return (uint8_t) ((a + b + c + d + 2) >> 2);
+}
+
+// box filters rect (in level texels) of mip level from the level below,
+// edge texels of odd sized levels repeat the last source texel
+void FilterMip(World2D_TexStream* stream, uint32_t level, World2D_Rect const& rect) {
+	World2D_TexStreamMip& mip = stream->mips[level];
+	World2D_TexStreamMip const& src = stream->mips[level - 1];
+	uint32_t const srcMaxX = src.width - 1;
+	uint32_t const srcMaxY = src.height - 1;
+
+	// level 0 isn't kept, its two source rows are packed from the world into
+	// scratch instead, starting at srcX rather than 0
+	uint32_t const srcX = rect.x * 2;
+	uint32_t const srcEndX = (srcX + rect.width * 2 < src.width) ? srcX + rect.width * 2 : src.width;
+	uint32_t const rowBase = (level == 1) ? srcX : 0;
+
+	for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+		uint32_t const y0 = y * 2;
+		uint32_t const y1 = (y0 + 1 < srcMaxY) ? y0 + 1 : srcMaxY;
+		uint8_t const* row0;
+		uint8_t const* row1;
+		if (level == 1) {
+			uint8_t* const packed0 = stream->rowScratch;
+			uint8_t* const packed1 = packed0 + (size_t) src.width * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+			stream->typeOps->packTexels(stream->world, {srcX, y0, srcEndX - srcX, 1}, packed0);
+			stream->typeOps->packTexels(stream->world, {srcX, y1, srcEndX - srcX, 1}, packed1);
+			row0 = packed0;
+			row1 = packed1;
+		} else {
+			row0 = src.texels + (size_t) y0 * src.width * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+			row1 = src.texels + (size_t) y1 * src.width * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+		}
+		uint8_t* dst = mip.texels + ((size_t) y * mip.width + rect.x) * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+		for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+			uint32_t const x0 = (x * 2 - rowBase) * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+			uint32_t const x1 = (((x * 2 + 1 < srcMaxX) ? x * 2 + 1 : srcMaxX) - rowBase) * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+			for (uint32_t c = 0; c < WORLD2D_TEXSTREAM_TEXEL_SIZE; ++c) {
+				dst[c] = AverageOf4(row0[x0 + c], row0[x1 + c], row1[x0 + c], row1[x1 + c]);
+			}
+			dst += WORLD2D_TEXSTREAM_TEXEL_SIZE;
+		}
+	}
+}
+
+void PackMipRect(World2D_TexStreamMip const& mip, World2D_Rect const& rect, uint8_t* dst) {
+	size_t const rowBytes = (size_t) rect.width * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+	for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+		memcpy(dst, mip.texels + ((size_t) y * mip.width + rect.x) * WORLD2D_TEXSTREAM_TEXEL_SIZE, rowBytes);
+		dst += rowBytes;
+	}
+}
+
+World2D_TexStreamRegion& AddRegion(World2D_TexStream* stream, World2D_TexStreamMip const& mip, World2D_Rect const& rect) {
+	World2D_TexStreamRegion& region = stream->regions[stream->regionCount++];
+	region.stagingOffset = stream->bytesThisFrame;
+	region.x = mip.x + rect.x;
+	region.y = mip.y + rect.y;
+	region.width = rect.width;
+	region.height = rect.height;
+	stream->bytesThisFrame += (uint64_t) rect.width * rect.height * WORLD2D_TEXSTREAM_TEXEL_SIZE;
+	return region;
+}
+
+} // end anon namespace
+
+World2D_TexStream* World2D_TexStreamCreate(World2D* world, uint64_t frameBudget, uint32_t mipCount) {
+	ASSERT(world);
+	World2D_TypeOps const* typeOps = World2D_TypeOpsFor(world->type);
+	if (!typeOps || !typeOps->packTexels) {
+		LOGERROR("World2D texture streaming needs a world type that packs texels");
+		return nullptr;
+	}
+
+	World2D_TexStream* stream = (World2D_TexStream*) MEMORY_CALLOC(1, sizeof(World2D_TexStream));
+	if (!stream) return nullptr;
+	stream->world = world;
+	stream->typeOps = typeOps;
+	stream->consumer = WORLD2D_INVALID_DIRTY_CONSUMER;
+
+	// level 0 at the origin, the rest down a column to its right
+	stream->mipCount = 1;
+	stream->mips[0] = {0, 0, world->width, world->height, nullptr};
+	stream->atlasWidth = world->width;
+	stream->atlasHeight = world->height;
+	if (mipCount > WORLD2D_TEXSTREAM_MAX_MIPS) mipCount = WORLD2D_TEXSTREAM_MAX_MIPS;
+	uint32_t columnY = 0;
+	while (stream->mipCount < mipCount) {
+		World2D_TexStreamMip const& prev = stream->mips[stream->mipCount - 1];
+		if (prev.width == 1 && prev.height == 1) break;
+		World2D_TexStreamMip& mip = stream->mips[stream->mipCount++];
+		mip.width = (prev.width + 1) / 2;
+		mip.height = (prev.height + 1) / 2;
+		mip.x = world->width;
+		mip.y = columnY;
+		columnY += mip.height;
+		if (mip.x + mip.width > stream->atlasWidth) stream->atlasWidth = mip.x + mip.width;
+		if (columnY > stream->atlasHeight) stream->atlasHeight = columnY;
+		mip.texels = (uint8_t*) MEMORY_CALLOC((size_t) mip.width * mip.height, WORLD2D_TEXSTREAM_TEXEL_SIZE);
+		if (!mip.texels) goto Fail;
+	}
+
+	{
+		World2D_Rect const tile{0, 0, WORLD2D_DIRTY_TILE_SIZE, WORLD2D_DIRTY_TILE_SIZE};
+		uint64_t const tileBytes = RunBytes(stream, tile);
+		stream->frameBudget = (frameBudget < tileBytes) ? tileBytes : frameBudget;
+	}
+	// one region per tile and level is the most a frame can produce
+	stream->regionCapacity = world->dirtyTilesX * world->dirtyTilesY * stream->mipCount;
+
+	stream->ring = (uint8_t*) MEMORY_MALLOC(stream->frameBudget * WORLD2D_TEXSTREAM_FRAMES);
+	stream->regions = (World2D_TexStreamRegion*) MEMORY_MALLOC(sizeof(World2D_TexStreamRegion) * stream->regionCapacity);
+	stream->rowScratch = (uint8_t*) MEMORY_MALLOC((size_t) world->width * 2 * WORLD2D_TEXSTREAM_TEXEL_SIZE);
+	if (!stream->ring || !stream->regions || !stream->rowScratch) goto Fail;
+
+	// new consumers start all dirty, so the first frames fill the whole texture
+	stream->consumer = World2D_DirtyConsumerRegister(world);
+	if (stream->consumer == WORLD2D_INVALID_DIRTY_CONSUMER) goto Fail;
+
+	return stream;
+Fail:
+	World2D_TexStreamDestroy(stream);
+	return nullptr;
+}
+
+void World2D_TexStreamDestroy(World2D_TexStream* stream) {
+	if (!stream) return;
+	if (stream->consumer != WORLD2D_INVALID_DIRTY_CONSUMER) {
+		World2D_DirtyConsumerUnregister(stream->world, stream->consumer);
+	}
+	for (uint32_t i = 1; i < stream->mipCount; ++i) {
+		if (stream->mips[i].texels) MEMORY_FREE(stream->mips[i].texels);
+	}
+	if (stream->rowScratch) MEMORY_FREE(stream->rowScratch);
+	if (stream->regions) MEMORY_FREE(stream->regions);
+	if (stream->ring) MEMORY_FREE(stream->ring);
+	MEMORY_FREE(stream);
+}
+
+uint32_t World2D_TexStreamBeginFrame(World2D_TexStream* stream) {
+	ASSERT(stream);
+	World2D* world = stream->world;
+	stream->frame = (stream->frame + 1) % WORLD2D_TEXSTREAM_FRAMES;
+	stream->regionCount = 0;
+	stream->bytesThisFrame = 0;
+	if (!World2D_IsAnyDirty(world, stream->consumer)) return 0;
+
+	uint8_t* staging = stream->ring + (uint64_t) stream->frame * stream->frameBudget;
+
+	bool full = false;
+	uint32_t row = 0;
+	for (; row < world->dirtyTilesY && !full; ++row) {
+		uint32_t const ty = (stream->nextTileRow + row) % world->dirtyTilesY;
+		uint32_t tx = 0;
+		while (tx < world->dirtyTilesX) {
+			if (!World2D_IsTileDirty(world, stream->consumer, tx, ty)) {
+				++tx;
+				continue;
+			}
+
+			// extend the run while it's dirty and it and its mips fit what's left of the budget
+			uint32_t const runStart = tx;
+			uint64_t const left = stream->frameBudget - stream->bytesThisFrame;
+			while (tx < world->dirtyTilesX && World2D_IsTileDirty(world, stream->consumer, tx, ty) &&
+					RunBytes(stream, TileRunRect(world, ty, runStart, tx + 1)) <= left) {
+				++tx;
+			}
+			if (tx == runStart) {
+				full = true;
+				break;
+			}
+
+			World2D_Rect const rect = TileRunRect(world, ty, runStart, tx);
+			World2D_TexStreamRegion const& region = AddRegion(stream, stream->mips[0], rect);
+			stream->typeOps->packTexels(world, rect, staging + region.stagingOffset);
+			for (uint32_t level = 1; level < stream->mipCount; ++level) {
+				World2D_Rect const mipRect = MipRect(stream->mips[level], rect, level);
+				FilterMip(stream, level, mipRect);
+				World2D_TexStreamRegion const& mipRegion = AddRegion(stream, stream->mips[level], mipRect);
+				PackMipRect(stream->mips[level], mipRect, staging + mipRegion.stagingOffset);
+			}
+
+			for (uint32_t x = runStart; x < tx; ++x) {
+				World2D_ClearDirtyTile(world, stream->consumer, x, ty);
+			}
+		}
+	}
+	// a full frame resumes on the row it ran out in
+	stream->nextTileRow = full ? (stream->nextTileRow + row - 1) % world->dirtyTilesY : 0;
+
+	return stream->regionCount;
+}
@@ -0,0 +1,82 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "world2d.hpp"
+#include "world2d_schema.hpp"
+
+// Streams the changed parts of a world into a persistent RGBA8 texture, texels
+// as the world type's schema packs them. Each frame packs the renderer's
+// dirty tiles into that frame's slice of a staging ring and returns the
+// regions to copy, so the copy cost follows the area that changed rather
+// than the world size. Tiles that don't fit the frame budget stay dirty and
+// go next frame.
+//
+// The texture is an atlas holding a mip pyramid, level 0 (the cells) at the
+// origin and each coarser level stacked down the column to its right, so the
+// atlas is about 1.5x the world wide. Coarser levels are box filtered on the
+// CPU from the level below and streamed with the level 0 tiles they cover.
+#define WORLD2D_TEXSTREAM_FRAMES 3
+#define WORLD2D_TEXSTREAM_TEXEL_SIZE WORLD2D_TEXEL_SIZE
+#define WORLD2D_TEXSTREAM_MAX_MIPS 12
+
+struct World2D_TexStreamMip {
+	// where the level sits in the atlas
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+	// CPU copy the next level is filtered from, nullptr for level 0 which comes
+	// straight from the world
+	uint8_t* texels;
+};
+
+struct World2D_TexStreamRegion {
+	// into the frame's staging, rows are width * WORLD2D_TEXSTREAM_TEXEL_SIZE bytes
+	uint64_t stagingOffset;
+	// atlas texels
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct World2D_TexStream {
+	World2D* world;
+	World2D_TypeOps const* typeOps;
+	uint32_t consumer;
+
+	// WORLD2D_TEXSTREAM_FRAMES slices, the GPU may still be reading the last ones
+	uint8_t* ring;
+	uint64_t frameBudget;
+	uint32_t frame;
+	// tile row the next frame starts at, so a small budget can't starve the bottom
+	uint32_t nextTileRow;
+
+	uint32_t atlasWidth;
+	uint32_t atlasHeight;
+	uint32_t mipCount;
+	World2D_TexStreamMip mips[WORLD2D_TEXSTREAM_MAX_MIPS];
+
+	uint32_t regionCapacity;
+	uint32_t regionCount;
+	World2D_TexStreamRegion* regions;
+	uint64_t bytesThisFrame;
+
+	// two packed world rows, level 1 is filtered from them
+	uint8_t* rowScratch;
+};
+
+// frameBudget is the staging bytes per frame, rounded up to at least one tile
+// and its mips. mipCount is clamped to what the world size allows
+World2D_TexStream* World2D_TexStreamCreate(World2D* world, uint64_t frameBudget, uint32_t mipCount = 1);
+void World2D_TexStreamDestroy(World2D_TexStream* stream);
+
+// packs dirty tiles into the next staging slice and returns the region count,
+// the regions and their data stay valid until WORLD2D_TEXSTREAM_FRAMES more
+// frames have begun
+uint32_t World2D_TexStreamBeginFrame(World2D_TexStream* stream);
+
+inline uint8_t const* World2D_TexStreamFrameStaging(World2D_TexStream const* stream) {
+	return stream->ring + (uint64_t) stream->frame * stream->frameBudget;
+}
@@ -21,6 +21,12 @@
 #include "synthwaveviztests.h"
 #include "meshmodrendertests.hpp"
 #include "alife/alifetests.hpp"
+#include "simclock.hpp"
+
+// the simulation steps at a fixed 60Hz whatever the frame rate, catching up at
+// most this many steps in one frame
+#define SIM_STEP_MS (1000.0 / 60.0)
+#define SIM_MAX_STEPS_PER_FRAME 4
 
 extern void VisualDebugTests();
 
@@ -48,6 +54,15 @@ InputBasic_MouseHandle mouse;
 
 enkiTaskSchedulerHandle taskScheduler;
 
+SimClock simClock;
+
+struct SimTaskArgs {
+	uint32_t steps;
+	double stepMS;
+	MeshModRenderTests* meshModRenderTests;
+	ALifeTests* alifeTests;
+};
+
 enum AppKey {
 	AppKey_Quit,
 	AppKey_GPUCapture,
@@ -68,6 +83,20 @@ enum class GpuCaptureState {
 
 GpuCaptureState gpuCaptureState = GpuCaptureState::NotCapturing;
 
+// the frame's fixed steps, run on a worker while the main thread does input
+// and the UI, which touch none of the simulation state
+static void SimTask(uint32_t start, uint32_t end, uint32_t threadnum, void *pArgs) {
+	SimTaskArgs const* args = (SimTaskArgs const*) pArgs;
+	for(uint32_t i = 0; i < args->steps; ++i) {
+		if(args->meshModRenderTests) {
+			args->meshModRenderTests->simulate(args->stepMS);
+		}
+		if(args->alifeTests) {
+			args->alifeTests->simulate(args->stepMS, args->steps);
+		}
+	}
+}
+
 static void *EnkiAlloc(void *userData, size_t size) {
 	return MEMORY_ALLOCATOR_MALLOC((Memory_Allocator *) userData, size);
 }
@@ -155,6 +184,8 @@ static bool Init() {
 	}
 
 	taskScheduler = enkiNewTaskScheduler(&EnkiAlloc, &EnkiFree, &Memory_GlobalAllocator);
+	enkiInitTaskScheduler(taskScheduler);
+	SimClock_Init(&simClock, SIM_STEP_MS, SIM_MAX_STEPS_PER_FRAME);
 
 	GameAppShell_WindowDesc windowDesc;
 	GameAppShell_WindowGetCurrentDesc(&windowDesc);
@@ -299,10 +330,6 @@ static void Update(double deltaMS) {
 			}
 			meshModRenderTests->setStyle(meshModRenderStyle);
 		}
-
-		if(meshModRenderTests) {
-			meshModRenderTests->update(deltaMS, view);
-		}
 	} else {
 		if(meshModRenderTests) {
 			MeshModRenderTests::Destroy(meshModRenderTests);
@@ -314,16 +341,12 @@ static void Update(double deltaMS) {
 		if(!alifeTests) {
 			Render_ROPLayout ropLayout;
 			Render_FrameBufferDescribeROPLayout(frameBuffer, &ropLayout);
-			alifeTests = ALifeTests::Create(renderer, &ropLayout);
+			alifeTests = ALifeTests::Create(renderer, &ropLayout, taskScheduler);
 			if(!alifeTests) {
 				LOGERROR("ALifeTest::Create failed");
 				bDoALifeTests = false;
 			}
 		}
-
-		if(alifeTests) {
-			alifeTests->update(deltaMS, view);
-		}
 	} else {
 		if(alifeTests) {
 			ALifeTests::Destroy(alifeTests);
@@ -331,6 +354,14 @@ static void Update(double deltaMS) {
 		}
 	}
 
+	// simulation objects are only created and destroyed above, never while the task runs
+	SimTaskArgs simArgs{SimClock_Advance(&simClock, deltaMS), simClock.stepMS, meshModRenderTests, alifeTests};
+	enkiTaskSetHandle simTask = nullptr;
+	if(simArgs.steps > 0) {
+		simTask = enkiCreateTaskSet(taskScheduler, &SimTask);
+		enkiAddTaskSetToPipe(taskScheduler, simTask, &simArgs, 1);
+	}
+
 	ImGui::NewFrame();
 	auto const imguiIO = ImGui::GetIO();
 	if(!imguiIO.WantCaptureKeyboard) {
@@ -382,6 +413,19 @@ static void Update(double deltaMS) {
 	CameraInfoWindow();
 
 	ImGui::Render();
+
+	if(simTask) {
+		enkiWaitForTaskSet(taskScheduler, simTask);
+		enkiDeleteTaskSet(simTask);
+	}
+
+	// draw between the last two simulation states
+	if(meshModRenderTests) {
+		meshModRenderTests->update(SimClock_Alpha(&simClock), view);
+	}
+	if(alifeTests) {
+		alifeTests->update(view);
+	}
 }
 
 static void Draw(double deltaMS) {
@@ -111,7 +111,15 @@ void MeshModRenderTests::Destroy(MeshModRenderTests* mmrt) {
 	MEMORY_FREE(mmrt);
 }
 
-void MeshModRenderTests::update(double deltaMS, Render_View const& view) {
+void MeshModRenderTests::simulate(double stepMS) {
+	for (uint32_t i = 0u; i < meshVector->size(); ++i) {
+		auto& mesh = meshVector->at(i);
+		mesh.prevEulerRots = mesh.eulerRots;
+		mesh.eulerRots.y += 0.005f * (float)stepMS;
+	}
+}
+
+void MeshModRenderTests::update(float alpha, Render_View const& view) {
 	gpuView.worldToViewMatrix =	Math_LookAtMat4F(view.position, view.lookAt, view.upVector);
 
 	float const f = 1.0f / tanf(view.perspectiveFOV / 2.0f);
@@ -127,15 +135,16 @@ void MeshModRenderTests::update(double deltaMS, Render_View const& view) {
 	for (uint32_t i = 0u; i < meshVector->size(); ++i) {
 		auto& mesh = meshVector->at(i);
 
+		Math::Vec3F const eulerRots = mesh.prevEulerRots + (mesh.eulerRots - mesh.prevEulerRots) * alpha;
 		Math_Mat4F translateMatrix = Math_TranslationMat4F(mesh.pos);
-		Math_Mat4F rotateMatrix = Math_RotateEulerXYZMat4F(mesh.eulerRots);
+		Math_Mat4F rotateMatrix = Math_RotateEulerXYZMat4F(eulerRots);
 		Math_Mat4F scaleMatrix = Math_ScaleMat4F(mesh.scale);
 
 		Math_Mat4F matrix = Math_MultiplyMat4F(translateMatrix, rotateMatrix);
 		mesh.matrix = Math_MultiplyMat4F(matrix, scaleMatrix);
 
 		Math_Mat4F inverseTranslateMatrix = Math_TranslationMat4F(Math_SubVec3F({0}, mesh.pos));
-		Math_Mat4F inverseRotateMatrix = Math_RotateEulerXYZMat4F(Math_SubVec3F({0}, mesh.eulerRots));
+		Math_Mat4F inverseRotateMatrix = Math_RotateEulerXYZMat4F(Math_SubVec3F({0}, eulerRots));
 //		Math_Mat4F inverseScaleMatrix = Math_ScaleMat4F(mesh.scale);
 //		inverseScaleMatrix.v[0] = 1.0f / inverseScaleMatrix.v[0];
 //		inverseScaleMatrix.v[5] = 1.0f / inverseScaleMatrix.v[5];
@@ -143,8 +152,6 @@ void MeshModRenderTests::update(double deltaMS, Render_View const& view) {
 
 		Math_Mat4F inverseMatrix = Math_MultiplyMat4F(inverseTranslateMatrix, inverseRotateMatrix);
 		mesh.inverseMatrix = inverseMatrix;//Math_MultiplyMat4F(inverseMatrix, inverseScaleMatrix);
-
-		mesh.eulerRots.y += 0.005f * (float)deltaMS;
 	}
 }
 
@@ -13,6 +13,8 @@ struct MeshModRenderMesh {
 	Math::Vec3F pos;
 	Math::Vec3F scale;
 	Math::Vec3F eulerRots;
+	// eulerRots before the last simulation step
+	Math::Vec3F prevEulerRots;
 
 	MeshModRender_MeshHandle renderableMesh;
 	Math_Mat4F matrix;
@@ -24,7 +26,10 @@ public:
 	static MeshModRenderTests* Create(Render_RendererHandle renderer, Render_ROPLayout const * targetLayout);
 	static void Destroy(MeshModRenderTests* mmrt);
 
-	void update(double deltaMS, Render_View const& view);
+	// one fixed simulation step
+	void simulate(double stepMS);
+	// alpha is how far between the last two simulation steps to draw
+	void update(float alpha, Render_View const& view);
 	void render(Render_GraphicsEncoderHandle encoder);
 
 	void setStyle(MeshModRender_RenderStyle style);
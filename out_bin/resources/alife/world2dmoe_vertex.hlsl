@@ -1,32 +1,91 @@
+#define PATCH_QUADS 32
+#define CLIPMAP_LEVELS 10
+#define MAX_PATCHES (CLIPMAP_LEVELS * 16)
+
 cbuffer View : register(b0, space1)
 {
     float4x4 worldToViewMatrix;
     float4x4 viewToNDCMatrix;
     float4x4 worldToNDCMatrix;
+
+    // Grid, see World2DRenderGrid
+    uint worldWidth;
+    uint worldHeight;
+    uint patchQuads;
+    uint levelCount;
+    int4 levels[CLIPMAP_LEVELS];       // origin in cells, mip position in the atlas
+    uint4 levelMips[CLIPMAP_LEVELS];   // mip size
+    int4 patches[MAX_PATCHES];         // origin in cells, level
 };
 
-//Texture2D foodTexture : register(t0, space1);
+// r pheromone, g food, b moisture streamed from the world each frame, a mip
+// pyramid down the column to the right of the cells
+Texture2D<float4> foodTexture : register(t0, space1);
 
-struct VSInput
-{
-    float4 Position : POSITION;
-    float2 uv : TEXCOORD0;
-};
+// matches WORLD2D_RENDER_HEIGHT_SCALE, the patch bounds used for culling assume it
+static const float heightScale = 8.0;
 
 struct VSOutput {
     float4 Position : SV_POSITION;
     float4 Colour   : COLOR;
 };
 
-VSOutput VS_main(VSInput input)
+// two triangles per quad
+static const int2 quadCorners[6] = {
+    int2(0, 0), int2(0, 1), int2(1, 0),
+    int2(1, 0), int2(0, 1), int2(1, 1)
+};
+
+VSOutput VS_main(uint drawVertexId : SV_VertexID)
 {
     VSOutput result;
 
-    float fi = 0;//foodTexture.SampleLevel(pointSampler, input.uv, 0);
-    float4 pos = input.Position;
-    pos.y += fi;
+    // one plain draw covers every patch, patchQuads^2 quads each
+    uint patchVertices = patchQuads * patchQuads * 6;
+    uint vertexId = drawVertexId % patchVertices;
+    int4 patch = patches[drawVertexId / patchVertices];
+    uint level = (uint)patch.z;
+    int spacing = 1 << level;
+    uint quad = vertexId / 6;
+    int2 quadCell = patch.xy + int2(quad % patchQuads, quad / patchQuads) * spacing;
+
+    // quads the finer level already draws collapse to a point
+    if (level > 0) {
+        int2 inner = levels[level - 1].xy;
+        int innerExtent = 2 * patchQuads * spacing;
+        if (all(quadCell >= inner) && all(quadCell + spacing <= inner + innerExtent)) {
+            result.Position = float4(0, 0, 0, 1);
+            result.Colour = float4(0, 0, 0, 1);
+            return result;
+        }
+    }
+
+    int2 cell = quadCell + quadCorners[vertexId % 6] * spacing;
+
+    // odd vertices on a level's outer edge move onto the coarser level's
+    // vertices and take its height, so the levels meet without cracks
+    uint mipLevel = level;
+    if (level + 1 < levelCount) {
+        int2 origin = levels[level].xy;
+        int extent = 4 * patchQuads * spacing;
+        bool onX = cell.x == origin.x || cell.x == origin.x + extent;
+        bool onY = cell.y == origin.y || cell.y == origin.y + extent;
+        if (onX || onY) {
+            mipLevel = level + 1;
+            if (onX && (((cell.y - origin.y) / spacing) & 1)) cell.y -= spacing;
+            if (onY && (((cell.x - origin.x) / spacing) & 1)) cell.x -= spacing;
+        }
+    }
+
+    // quads past the world edge clamp to zero area and aren't rasterised
+    cell = clamp(cell, int2(0, 0), int2(worldWidth - 1, worldHeight - 1));
+
+    // one texel per cell (or per 2^level cells in the mips), so load directly
+    int2 mipTexel = min(cell >> mipLevel, int2(levelMips[mipLevel].xy) - 1);
+    float4 cellState = foodTexture.Load(int3(levels[mipLevel].zw + mipTexel, 0));
+    float4 pos = float4((float)cell.x - (float)(worldWidth / 2), cellState.g * heightScale, (float)cell.y, 1.0);
 
     result.Position = mul(worldToNDCMatrix, pos);
-    result.Colour = float4(fi, 0.3, 0.3, 1.0);
+    result.Colour = float4(0.2 + 0.8 * cellState.r, 0.2 + 0.8 * cellState.g, 0.3 + 0.7 * cellState.b, 1.0);
     return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,36 @@
+// License Summary: MIT see LICENSE file
+
+#include "al2o3_platform/platform.h"
+#include "simclock.hpp"
+#include <cmath>
+
+void SimClock_Init(SimClock* clock, double stepMS, uint32_t maxStepsPerFrame) {
+	ASSERT(clock);
+	ASSERT(stepMS > 0.0);
+	ASSERT(maxStepsPerFrame > 0);
+	clock->stepMS = stepMS;
+	clock->maxStepsPerFrame = maxStepsPerFrame;
+	clock->accumulatorMS = 0.0;
+	clock->stepCount = 0;
+	clock->droppedMS = 0.0;
+}
+
+uint32_t SimClock_Advance(SimClock* clock, double deltaMS) {
+	ASSERT(clock);
+	if (deltaMS > 0.0) clock->accumulatorMS += deltaMS;
+
+	// drop whole steps past the cap, the fraction stays so interpolation doesn't jump
+	double const behindMS = clock->accumulatorMS - clock->stepMS * clock->maxStepsPerFrame;
+	if (behindMS >= clock->stepMS) {
+		double const dropMS = std::floor(behindMS / clock->stepMS) * clock->stepMS;
+		clock->accumulatorMS -= dropMS;
+		clock->droppedMS += dropMS;
+	}
+
+	uint32_t steps = (uint32_t) (clock->accumulatorMS / clock->stepMS);
+	if (steps > clock->maxStepsPerFrame) steps = clock->maxStepsPerFrame;
+	clock->accumulatorMS -= steps * clock->stepMS;
+	if (clock->accumulatorMS < 0.0) clock->accumulatorMS = 0.0;
+	clock->stepCount += steps;
+	return steps;
+}
@@ -0,0 +1,34 @@
+// License Summary: MIT see LICENSE file
+#pragma once
+
+#include "al2o3_platform/platform.h"
+
+// Fixed timestep clock. Frame time goes into an accumulator and comes out as
+// whole simulation steps of stepMS, so the simulation sees the same step
+// whatever the frame rate. The remainder carries to the next frame and is what
+// the renderer interpolates the last two simulation states by.
+//
+// After a long frame (a hitch, a debugger break) the simulation would need
+// more steps to catch up than it can run in a frame, each of which makes the
+// next frame longer still. Anything past maxStepsPerFrame is dropped, the
+// simulation runs slower than real time rather than spiralling.
+struct SimClock {
+	double stepMS;
+	uint32_t maxStepsPerFrame;
+
+	double accumulatorMS;
+	// steps handed out and time dropped by the catch up cap since init
+	uint64_t stepCount;
+	double droppedMS;
+};
+
+void SimClock_Init(SimClock* clock, double stepMS, uint32_t maxStepsPerFrame);
+
+// adds a frame's time, returns how many steps to run for it
+uint32_t SimClock_Advance(SimClock* clock, double deltaMS);
+
+// how far between the last two steps the current time is, 0 to 1
+inline float SimClock_Alpha(SimClock const* clock) {
+	float const alpha = (float) (clock->accumulatorMS / clock->stepMS);
+	return (alpha < 1.0f) ? alpha : 1.0f;
+}
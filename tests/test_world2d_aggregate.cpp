@@ -0,0 +1,89 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_catch2/catch2.hpp"
+#include "../alife/world2d_aggregate.hpp"
+#include <random>
+
+namespace {
+
+World2D_AggregateStats BruteForce(World2D const* world, uint32_t channel, World2D_Rect const& rect) {
+	auto const food = World2D_ElementsAs<int16_t>(world, channel);
+	World2D_AggregateStats stats{INT32_MAX, INT32_MIN, 0};
+	for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+		for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+			int32_t const v = food.at(x, y);
+			stats.min = (v < stats.min) ? v : stats.min;
+			stats.max = (v > stats.max) ? v : stats.max;
+			stats.sum += v;
+		}
+	}
+	return stats;
+}
+
+World2D_Rect RandomRect(std::mt19937& rng, World2D const* world) {
+	World2D_Rect rect;
+	rect.x = rng() % world->width;
+	rect.y = rng() % world->height;
+	rect.width = 1 + rng() % (world->width - rect.x);
+	rect.height = 1 + rng() % (world->height - rect.y);
+	return rect;
+}
+
+void CheckRects(std::mt19937& rng, World2D_Aggregates const* agg, uint32_t channel) {
+	World2D const* world = agg->world;
+	// the whole world, one cell and a tile aligned rect beside the random ones
+	World2D_Rect rects[64] = {
+			{0, 0, world->width, world->height},
+			{world->width - 1, world->height - 1, 1, 1},
+			{WORLD2D_AGGREGATE_TILE_SIZE, 0, WORLD2D_AGGREGATE_TILE_SIZE * 2, WORLD2D_AGGREGATE_TILE_SIZE},
+	};
+	for (uint32_t i = 3; i < 64; ++i) rects[i] = RandomRect(rng, world);
+
+	for (World2D_Rect const& rect : rects) {
+		INFO("rect " << rect.x << "," << rect.y << " " << rect.width << "x" << rect.height);
+		World2D_AggregateStats const expected = BruteForce(world, channel, rect);
+		REQUIRE(World2D_AggregateSum(agg, channel, rect) == expected.sum);
+		World2D_AggregateStats const bounds = World2D_AggregateBounds(agg, channel, rect);
+		REQUIRE(bounds.min == expected.min);
+		REQUIRE(bounds.max == expected.max);
+		REQUIRE(bounds.sum == expected.sum);
+	}
+}
+
+} // end anon namespace
+
+TEST_CASE("Aggregates match a brute force scan", "[World2D aggregate]") {
+	std::mt19937 rng(0xa99);
+	// not a multiple of the tile size in either direction
+	World2D* world = World2D_Create(WT_MOE, 300, 213);
+	REQUIRE(world);
+	auto food = World2D_MutableElementsAs<int16_t>(world, WMC_FOOD);
+	for (uint32_t y = 0; y < world->height; ++y) {
+		for (uint32_t x = 0; x < world->width; ++x) {
+			food.at(x, y) = (int16_t) rng();
+		}
+	}
+	World2D_MarkDirtyRect(world, 0, 0, world->width, world->height);
+
+	World2D_Aggregates* agg = World2D_AggregatesCreate(world, 1u << WMC_FOOD);
+	REQUIRE(agg);
+	World2D_AggregatesUpdate(agg, nullptr);
+	CheckRects(rng, agg, WMC_FOOD);
+
+	// incremental updates only rebuild what was dirtied
+	for (uint32_t round = 0; round < 8; ++round) {
+		World2D_Rect const rect = RandomRect(rng, world);
+		uint32_t const width = (rect.width < 40) ? rect.width : 40;
+		uint32_t const height = (rect.height < 40) ? rect.height : 40;
+		for (uint32_t y = rect.y; y < rect.y + height; ++y) {
+			for (uint32_t x = rect.x; x < rect.x + width; ++x) {
+				food.at(x, y) = (int16_t) rng();
+			}
+		}
+		World2D_MarkDirtyRect(world, rect.x, rect.y, width, height);
+		World2D_AggregatesUpdate(agg, nullptr);
+		CheckRects(rng, agg, WMC_FOOD);
+	}
+
+	World2D_AggregatesDestroy(agg);
+	World2D_Destroy(world);
+}
@@ -0,0 +1,107 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_catch2/catch2.hpp"
+#include "../alife/world2d_checkpoint.hpp"
+#include "../alife/world2d_step.hpp"
+#include <cstdio>
+#include <random>
+
+namespace {
+
+char const* const CheckpointFile = "test_world2d_checkpoint.w2dc";
+
+bool SameFrontPlanes(World2D const* a, World2D const* b) {
+	if (a->type != b->type || a->width != b->width || a->height != b->height) return false;
+	if (a->channelCount != b->channelCount || a->tick != b->tick) return false;
+	for (uint32_t c = 0; c < a->channelCount; ++c) {
+		World2DChannel const& ca = a->channels[c];
+		World2DChannel const& cb = b->channels[c];
+		if (ca.elementSize != cb.elementSize) return false;
+		for (uint32_t y = 0; y < a->height; ++y) {
+			for (uint32_t x = 0; x < a->width; ++x) {
+				uint8_t const* va = (uint8_t const*) ca.data + World2D_ElementIndex(ca.layout, ca.pitch, x, y) * ca.elementSize;
+				uint8_t const* vb = (uint8_t const*) cb.data + World2D_ElementIndex(cb.layout, cb.pitch, x, y) * cb.elementSize;
+				if (memcmp(va, vb, ca.elementSize) != 0) return false;
+			}
+		}
+	}
+	return true;
+}
+
+World2D* CreateSteppedWorld() {
+	World2D* world = World2D_Create(WT_MOE, 130, 70);
+	if (!world) return nullptr;
+	std::mt19937 rng(0xc4ec);
+	auto food = World2D_MutableElementsAs<int16_t>(world, WMC_FOOD);
+	auto occupancy = World2D_MutableElementsAs<uint8_t>(world, WMC_OCCUPANCY);
+	for (uint32_t y = 0; y < world->height; ++y) {
+		for (uint32_t x = 0; x < world->width; ++x) {
+			food.at(x, y) = (int16_t) (rng() & 0xFFF);
+			occupancy.at(x, y) = (uint8_t) (rng() & 0x3);
+		}
+	}
+	World2D_MarkDirtyRect(world, 0, 0, world->width, world->height);
+
+	World2D_StepParams params;
+	World2D_StepParamsDefaults(&params);
+	for (uint32_t i = 0; i < 5; ++i) World2D_Step(world, nullptr, &params);
+	return world;
+}
+
+} // end anon namespace
+
+TEST_CASE("Checkpoint round trips", "[World2D checkpoint]") {
+	World2D* world = CreateSteppedWorld();
+	REQUIRE(world);
+	REQUIRE(World2D_CheckpointSave(world, CheckpointFile));
+
+	SECTION("load") {
+		World2D* loaded = World2D_CheckpointLoad(CheckpointFile, true);
+		REQUIRE(loaded);
+		REQUIRE(SameFrontPlanes(world, loaded));
+		World2D_Destroy(loaded);
+	}
+
+	SECTION("map, promote and step") {
+		World2D_Checkpoint* checkpoint = World2D_CheckpointOpen(CheckpointFile, true);
+		REQUIRE(checkpoint);
+		REQUIRE(SameFrontPlanes(world, World2D_CheckpointWorld(checkpoint)));
+
+		World2D* promoted = World2D_CheckpointPromote(checkpoint);
+		REQUIRE(promoted);
+		World2D_StepParams params;
+		World2D_StepParamsDefaults(&params);
+		World2D_Step(world, nullptr, &params);
+		World2D_Step(promoted, nullptr, &params);
+		REQUIRE(SameFrontPlanes(world, promoted));
+		World2D_CheckpointClose(checkpoint);
+
+		// stepping the promoted world never reaches the file
+		World2D* reloaded = World2D_CheckpointLoad(CheckpointFile, true);
+		REQUIRE(reloaded);
+		REQUIRE(reloaded->tick + 1 == world->tick);
+		World2D_Destroy(reloaded);
+	}
+
+	World2D_Destroy(world);
+	remove(CheckpointFile);
+}
+
+TEST_CASE("Checkpoint rejects a corrupt header", "[World2D checkpoint]") {
+	World2D* world = CreateSteppedWorld();
+	REQUIRE(world);
+	REQUIRE(World2D_CheckpointSave(world, CheckpointFile));
+
+	FILE* fp = fopen(CheckpointFile, "r+b");
+	REQUIRE(fp);
+	// the width
+	REQUIRE(fseek(fp, offsetof(World2D_CheckpointHeader, width), SEEK_SET) == 0);
+	uint32_t const width = world->width + 1;
+	REQUIRE(fwrite(&width, sizeof(width), 1, fp) == 1);
+	fclose(fp);
+
+	REQUIRE(World2D_CheckpointLoad(CheckpointFile, false) == nullptr);
+	REQUIRE(World2D_CheckpointOpen(CheckpointFile, false) == nullptr);
+
+	World2D_Destroy(world);
+	remove(CheckpointFile);
+}
@@ -0,0 +1,104 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_catch2/catch2.hpp"
+#include "../alife/world2d_kernels.hpp"
+#include <random>
+#include <vector>
+
+namespace {
+
+// every width up to a few vectors of the widest ISA hits each tail length,
+// then some odd sized long rows
+std::vector<uint32_t> TestCounts() {
+	std::vector<uint32_t> counts;
+	for (uint32_t count = 0; count <= 80; ++count) counts.push_back(count);
+	counts.push_back(127);
+	counts.push_back(203);
+	counts.push_back(1021);
+	return counts;
+}
+
+void RandomRow(std::mt19937& rng, std::vector<int16_t>& row, bool fullRange) {
+	for (int16_t& v : row) {
+		uint32_t const r = rng();
+		v = fullRange ? (int16_t) r : (int16_t) (r & 0x1FFF);
+	}
+}
+
+void CheckAgainstScalar(World2D_Kernels const* kernels) {
+	World2D_Kernels const* ref = World2D_KernelsScalar();
+	std::mt19937 rng(0x5eed);
+
+	for (uint32_t count : TestCounts()) {
+		// 1 cell halo either side plus a couple spare so the row start isn't aligned
+		std::vector<int16_t> above(count + 5), row(count + 5), below(count + 5);
+		std::vector<int16_t> expected(count + 3), result(count + 3);
+
+		for (uint32_t pass = 0; pass < 4; ++pass) {
+			bool const fullRange = (pass & 1) == 0;
+			RandomRow(rng, above, fullRange);
+			RandomRow(rng, row, fullRange);
+			RandomRow(rng, below, fullRange);
+			uint32_t const offset = 1 + pass % 3;
+			uint32_t const shift = rng() & 0x7;
+			INFO(kernels->name << " count " << count << " offset " << offset << " shift " << shift);
+
+			ref->diffuse5(expected.data(), &above[offset], &row[offset], &below[offset], count, shift);
+			kernels->diffuse5(result.data(), &above[offset], &row[offset], &below[offset], count, shift);
+			REQUIRE(memcmp(expected.data(), result.data(), count * sizeof(int16_t)) == 0);
+
+			ref->diffuse9(expected.data(), &above[offset], &row[offset], &below[offset], count, shift);
+			kernels->diffuse9(result.data(), &above[offset], &row[offset], &below[offset], count, shift);
+			REQUIRE(memcmp(expected.data(), result.data(), count * sizeof(int16_t)) == 0);
+
+			int16_t const decay = (int16_t) (rng() & 0x7FFF);
+			memcpy(expected.data(), &row[offset], count * sizeof(int16_t));
+			memcpy(result.data(), &row[offset], count * sizeof(int16_t));
+			ref->decay(expected.data(), count, decay);
+			kernels->decay(result.data(), count, decay);
+			REQUIRE(memcmp(expected.data(), result.data(), count * sizeof(int16_t)) == 0);
+
+			int16_t const growth = (int16_t) (rng() & 0x3FFF);
+			int16_t const capacity = (int16_t) (rng() & 0x7FFF);
+			memcpy(expected.data(), &row[offset], count * sizeof(int16_t));
+			memcpy(result.data(), &row[offset], count * sizeof(int16_t));
+			ref->grow(expected.data(), count, growth, capacity);
+			kernels->grow(result.data(), count, growth, capacity);
+			REQUIRE(memcmp(expected.data(), result.data(), count * sizeof(int16_t)) == 0);
+		}
+	}
+}
+
+} // end anon namespace
+
+TEST_CASE("SSE2 kernels match scalar", "[World2D kernels]") {
+	World2D_Kernels const* kernels = World2D_KernelsSSE2();
+	if (!kernels || !World2D_KernelsSupported(kernels)) {
+		WARN("SSE2 kernels not available");
+		return;
+	}
+	CheckAgainstScalar(kernels);
+}
+
+TEST_CASE("AVX2 kernels match scalar", "[World2D kernels]") {
+	World2D_Kernels const* kernels = World2D_KernelsAVX2();
+	if (!kernels || !World2D_KernelsSupported(kernels)) {
+		WARN("AVX2 kernels not available");
+		return;
+	}
+	CheckAgainstScalar(kernels);
+}
+
+TEST_CASE("AVX-512 kernels match scalar", "[World2D kernels]") {
+	World2D_Kernels const* kernels = World2D_KernelsAVX512();
+	if (!kernels || !World2D_KernelsSupported(kernels)) {
+		WARN("AVX-512 kernels not available");
+		return;
+	}
+	CheckAgainstScalar(kernels);
+}
+
+TEST_CASE("Best kernels pass their self test", "[World2D kernels]") {
+	World2D_Kernels const* best = World2D_KernelsBest();
+	REQUIRE(best);
+	REQUIRE(World2D_KernelsVerify(best));
+}
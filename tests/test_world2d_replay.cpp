@@ -0,0 +1,84 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_catch2/catch2.hpp"
+#include "../alife/world2d_replay.hpp"
+#include "../alife/world2d_step.hpp"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+char const* const ReplayFile = "test_world2d_replay.w2dr";
+
+// the front planes as seen through the layout, so worlds with different pitches compare
+std::vector<uint8_t> Snapshot(World2D const* world) {
+	std::vector<uint8_t> snapshot;
+	for (uint32_t c = 0; c < world->channelCount; ++c) {
+		World2DChannel const& channel = world->channels[c];
+		for (uint32_t y = 0; y < world->height; ++y) {
+			for (uint32_t x = 0; x < world->width; ++x) {
+				uint8_t const* v = (uint8_t const*) channel.data + World2D_ElementIndex(channel.layout, channel.pitch, x, y) * channel.elementSize;
+				snapshot.insert(snapshot.end(), v, v + channel.elementSize);
+			}
+		}
+	}
+	return snapshot;
+}
+
+} // end anon namespace
+
+TEST_CASE("Replay round trips", "[World2D replay]") {
+	uint32_t const frameCount = 40;
+	World2D* world = World2D_Create(WT_MOE, 150, 90);
+	REQUIRE(world);
+	auto food = World2D_MutableElementsAs<int16_t>(world, WMC_FOOD);
+	auto occupancy = World2D_MutableElementsAs<uint8_t>(world, WMC_OCCUPANCY);
+	for (uint32_t i = 0; i < 40; ++i) food.at(i * 3, i * 2) = 3000;
+	World2D_MarkDirtyRect(world, 0, 0, world->width, world->height);
+
+	World2D_StepParams params;
+	World2D_StepParamsDefaults(&params);
+
+	// a deep queue so nothing is dropped, keyframe every 8 frames
+	World2D_ReplayRecorder* recorder = World2D_ReplayRecorderCreate(world, ReplayFile, 8, frameCount);
+	REQUIRE(recorder);
+	std::vector<std::vector<uint8_t>> expected;
+	uint64_t const firstTick = world->tick + 1;
+	for (uint32_t i = 0; i < frameCount; ++i) {
+		World2D_Step(world, nullptr, &params);
+		// a write outside the step between keyframes
+		if (i == 13) {
+			occupancy.at(100, 50) = 9;
+			World2D_MarkDirtyRect(world, 100, 50, 1, 1);
+		}
+		REQUIRE(World2D_ReplayRecorderCapture(recorder));
+		expected.push_back(Snapshot(world));
+	}
+	World2D_ReplayStats stats;
+	World2D_ReplayRecorderStats(recorder, &stats);
+	REQUIRE(stats.framesDropped == 0);
+	World2D_ReplayRecorderDestroy(recorder);
+
+	World2D_ReplayPlayer* player = World2D_ReplayPlayerOpen(ReplayFile);
+	REQUIRE(player);
+	REQUIRE(World2D_ReplayPlayerFrameCount(player) == frameCount);
+	REQUIRE(World2D_ReplayPlayerFirstTick(player) == firstTick);
+	REQUIRE(World2D_ReplayPlayerLastTick(player) == firstTick + frameCount - 1);
+
+	// forwards, backwards and across keyframes
+	uint32_t const order[] = {0, 5, 39, 7, 8, 9, 16, 15, 14, 13, 12, 2, 31, 32, 33, 1};
+	for (uint32_t frame : order) {
+		INFO("frame " << frame);
+		REQUIRE(World2D_ReplayPlayerSeek(player, firstTick + frame));
+		REQUIRE(Snapshot(World2D_ReplayPlayerWorld(player)) == expected[frame]);
+	}
+	for (uint32_t frame = 0; frame < frameCount; ++frame) {
+		INFO("frame " << frame);
+		REQUIRE(World2D_ReplayPlayerSeek(player, firstTick + frame));
+		REQUIRE(Snapshot(World2D_ReplayPlayerWorld(player)) == expected[frame]);
+	}
+	REQUIRE_FALSE(World2D_ReplayPlayerSeek(player, firstTick + frameCount));
+
+	World2D_ReplayPlayerClose(player);
+	World2D_Destroy(world);
+	remove(ReplayFile);
+}